@@ -25,6 +25,7 @@
 #include <linux/hardirq.h>
 
 #include <asm/fpsimd.h>
+#include <asm/neon.h>
 #include <asm/cputype.h>
 
 #define FPEXC_IOF	(1 << 0)
@@ -90,9 +91,10 @@ void fpsimd_flush_thread(void)
 #ifdef CONFIG_KERNEL_MODE_NEON
 
 /*
- * Kernel-side NEON support functions
+ * Kernel-side NEON support functions.  The whole register file is saved
+ * whatever @num_regs asks for.
  */
-void kernel_neon_begin(void)
+void kernel_neon_begin_partial(u32 num_regs)
 {
 	/* Avoid using the NEON in interrupt context */
 	BUG_ON(in_interrupt());
@@ -101,7 +103,7 @@ void kernel_neon_begin(void)
 	if (current->mm)
 		fpsimd_save_state(&current->thread.fpsimd_state);
 }
-EXPORT_SYMBOL(kernel_neon_begin);
+EXPORT_SYMBOL(kernel_neon_begin_partial);
 
 void kernel_neon_end(void)
 {
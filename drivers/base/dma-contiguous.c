@@ -33,14 +33,42 @@
 #include <linux/swap.h>
 #include <linux/mm_types.h>
 #include <linux/dma-contiguous.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+
+/*
+ * The area is indexed in chunks of CMA_INDEX_PAGES pages by the estimated
+ * cost of emptying them, so that an allocation can pick the window that
+ * needs the least migration instead of the first free one.
+ */
+#define CMA_INDEX_ORDER		4
+#define CMA_INDEX_PAGES		(1UL << CMA_INDEX_ORDER)
+#define CMA_MAX_WINDOWS		8
+
+#define CMA_COST_CLEAN		1	/* Clean page cache, just dropped */
+#define CMA_COST_MIGRATE	4	/* Mapped, anonymous or dirty, copied */
+#define CMA_COST_PINNED		64	/* Off the LRU, likely to be busy */
+
+/* Allocation latency in log2 microsecond buckets, the last one open */
+#define CMA_LATENCY_BUCKETS	20
+
+struct cma_stats {
+	unsigned long	allocs;
+	unsigned long	fails;
+	unsigned long	busy;		/* Windows that returned -EBUSY */
+	unsigned long	latency[CMA_LATENCY_BUCKETS];
+};
 
 struct cma {
 	unsigned long	base_pfn;
 	unsigned long	count;
 	unsigned long	free_count;
 	unsigned long	*bitmap;
+	unsigned int	*cost;		/* Prefix sums of the chunk costs */
 	unsigned long	carved_out_count;
 	bool isolated;
+	struct cma_stats stats;
 };
 
 struct cma *dma_contiguous_default_area;
@@ -235,6 +263,10 @@ static int __init cma_activate_area(struct cma *cma)
 	if (!cma->bitmap)
 		return -ENOMEM;
 
+	/* Without the index allocations are just first fit */
+	cma->cost = kzalloc((DIV_ROUND_UP(cma->count, CMA_INDEX_PAGES) + 1) *
+			    sizeof(*cma->cost), GFP_KERNEL);
+
 	WARN_ON_ONCE(!pfn_valid(pfn));
 	zone = page_zone(pfn_to_page(pfn));
 
@@ -325,6 +357,152 @@ int __init dma_contiguous_reserve_area(phys_addr_t size, phys_addr_t base,
 }
 #endif
 
+#ifndef CMA_NO_MIGRATION
+/*
+ * Read without any lock, so the result is only an estimate. Pages on the
+ * per-cpu lists have no reference and count as free.
+ */
+static unsigned int cma_page_cost(struct page *page, unsigned long *nr)
+{
+	*nr = 1;
+
+	if (PageBuddy(page)) {
+		unsigned long order = page_private(page);
+
+		if (order < MAX_ORDER)
+			*nr = 1UL << order;
+		return 0;
+	}
+
+	if (!page_count(page))
+		return 0;
+	if (!PageLRU(page))
+		return CMA_COST_PINNED;
+	if (PageAnon(page) || page_mapped(page) || PageDirty(page) ||
+	    PageWriteback(page))
+		return CMA_COST_MIGRATE;
+
+	return CMA_COST_CLEAN;
+}
+
+static void cma_update_cost(struct cma *cma)
+{
+	unsigned long chunk, nr_chunks = DIV_ROUND_UP(cma->count,
+						      CMA_INDEX_PAGES);
+
+	for (chunk = 0; chunk < nr_chunks; chunk++) {
+		unsigned long pageno = chunk << CMA_INDEX_ORDER;
+		unsigned long end = min(pageno + CMA_INDEX_PAGES, cma->count);
+		unsigned long nr;
+		unsigned int cost = 0;
+
+		/* Pages we handed out never end up in a candidate window */
+		for (; pageno < end; pageno += nr) {
+			nr = 1;
+			if (test_bit(pageno, cma->bitmap))
+				continue;
+			cost += cma_page_cost(pfn_to_page(cma->base_pfn + pageno),
+					      &nr);
+		}
+		cma->cost[chunk + 1] = cma->cost[chunk] + cost;
+	}
+}
+
+struct cma_window {
+	unsigned long	pageno;
+	unsigned int	cost;
+};
+
+/* Collect the CMA_MAX_WINDOWS cheapest free windows, cheapest first */
+static int cma_find_windows(struct cma *cma, int count, unsigned long mask,
+			    struct cma_window *win)
+{
+	unsigned long pageno, start = 0;
+	unsigned long step = max(mask + 1, CMA_INDEX_PAGES);
+	int i, nr = 0;
+
+	for (;;) {
+		unsigned int cost;
+
+		pageno = bitmap_find_next_zero_area(cma->bitmap, cma->count,
+						    start, count, mask);
+		if (pageno >= cma->count)
+			break;
+
+		cost = cma->cost[DIV_ROUND_UP(pageno + count, CMA_INDEX_PAGES)] -
+		       cma->cost[pageno >> CMA_INDEX_ORDER];
+
+		for (i = nr; i > 0 && win[i - 1].cost > cost; i--)
+			if (i < CMA_MAX_WINDOWS)
+				win[i] = win[i - 1];
+		if (i < CMA_MAX_WINDOWS) {
+			win[i].pageno = pageno;
+			win[i].cost = cost;
+			nr = min(nr + 1, CMA_MAX_WINDOWS);
+		}
+
+		/* Nothing beats a window that is already free */
+		if (!cost)
+			break;
+
+		start = pageno + step;
+	}
+
+	return nr;
+}
+
+/*
+ * Returns -EBUSY when none of the cheapest windows could be emptied, so
+ * that the caller falls back to trying every window in address order.
+ */
+static int cma_alloc_cheapest(struct cma *cma, int count, unsigned long mask,
+			      unsigned long *pageno)
+{
+	struct cma_window win[CMA_MAX_WINDOWS];
+	unsigned long pfn;
+	int i, nr, ret;
+
+	if (!cma->cost)
+		return -EBUSY;
+
+	cma_update_cost(cma);
+	nr = cma_find_windows(cma, count, mask, win);
+
+	for (i = 0; i < nr; i++) {
+		pfn = cma->base_pfn + win[i].pageno;
+		ret = alloc_contig_range(pfn, pfn + count, MIGRATE_CMA);
+		if (ret == 0)
+			*pageno = win[i].pageno;
+		if (ret != -EBUSY)
+			return ret;
+
+		cma->stats.busy++;
+		pr_debug("%s(): window at %p (cost %u) is busy\n",
+			 __func__, pfn_to_page(pfn), win[i].cost);
+	}
+
+	return -EBUSY;
+}
+#else
+static int cma_alloc_cheapest(struct cma *cma, int count, unsigned long mask,
+			      unsigned long *pageno)
+{
+	return -EBUSY;
+}
+#endif /* CMA_NO_MIGRATION */
+
+static void cma_account_alloc(struct cma *cma, bool success, ktime_t start)
+{
+	u64 us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	if (success)
+		cma->stats.allocs++;
+	else
+		cma->stats.fails++;
+
+	cma->stats.latency[min(fls64(us), CMA_LATENCY_BUCKETS - 1)]++;
+}
+
 /**
  * dma_alloc_from_contiguous() - allocate pages from contiguous area
  * @dev:   Pointer to device for which the allocation is performed.
@@ -342,7 +520,8 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 	unsigned long mask, pfn, pageno, start = 0;
 	struct cma *cma = dev_get_cma_area(dev);
 	struct page *page = NULL;
-	int ret;
+	ktime_t start_time;
+	int ret = -EBUSY;
 
 	if (!cma || !cma->count)
 		return NULL;
@@ -358,9 +537,13 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 
 	mask = (1 << align) - 1;
 
+	start_time = ktime_get();
 	mutex_lock(&cma_mutex);
 
-	for (;;) {
+	if (!cma->isolated)
+		ret = cma_alloc_cheapest(cma, count, mask, &pageno);
+
+	while (ret == -EBUSY) {
 		pageno = bitmap_find_next_zero_area(cma->bitmap, cma->count,
 						    start, count, mask);
 		if (pageno >= cma->count)
@@ -369,20 +552,23 @@ struct page *dma_alloc_from_contiguous(struct device *dev, int count,
 		pfn = cma->base_pfn + pageno;
 		ret = cma->isolated ?
 			0 : alloc_contig_range(pfn, pfn + count, MIGRATE_CMA);
-		if (ret == 0) {
-			bitmap_set(cma->bitmap, pageno, count);
-			page = pfn_to_page(pfn);
-			cma->free_count -= count;
-			break;
-		} else if (ret != -EBUSY) {
+		if (ret != -EBUSY)
 			break;
-		}
+
+		cma->stats.busy++;
 		pr_debug("%s(): memory range at %p is busy, retrying\n",
 			 __func__, pfn_to_page(pfn));
 		/* try again with a bit different memory target */
 		start = pageno + mask + 1;
 	}
 
+	if (ret == 0) {
+		bitmap_set(cma->bitmap, pageno, count);
+		page = pfn_to_page(cma->base_pfn + pageno);
+		cma->free_count -= count;
+	}
+	cma_account_alloc(cma, page != NULL, start_time);
+
 	mutex_unlock(&cma_mutex);
 	pr_debug("%s(): returned %p\n", __func__, page);
 	return page;
@@ -555,3 +741,58 @@ int dma_contiguous_isolate(struct device *dev)
 	return 0;
 }
 #endif /* CMA_NO_MIGRATION */
+
+#ifdef CONFIG_DEBUG_FS
+static int cma_debugfs_show(struct seq_file *m, void *v)
+{
+	struct cma *cma = m->private;
+	int i;
+
+	seq_printf(m, "base_pfn:   %#lx\n", cma->base_pfn);
+	seq_printf(m, "count:      %lu\n", cma->count);
+	seq_printf(m, "free:       %lu\n", cma->free_count);
+	seq_printf(m, "allocs:     %lu\n", cma->stats.allocs);
+	seq_printf(m, "fails:      %lu\n", cma->stats.fails);
+	seq_printf(m, "busy:       %lu\n", cma->stats.busy);
+	seq_puts(m, "latency_us:\n");
+	for (i = 0; i < CMA_LATENCY_BUCKETS - 1; i++)
+		seq_printf(m, "  < %-8lu %lu\n", 1UL << i,
+			   cma->stats.latency[i]);
+	seq_printf(m, "  >=%-8lu %lu\n", 1UL << (i - 1),
+		   cma->stats.latency[i]);
+
+	return 0;
+}
+
+static int cma_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_debugfs_show, inode->i_private);
+}
+
+static const struct file_operations cma_debugfs_fops = {
+	.open		= cma_debugfs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init cma_debugfs_init(void)
+{
+	struct dentry *root;
+	char name[16];
+	int i;
+
+	root = debugfs_create_dir("cma", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	for (i = 0; i < cma_area_count; i++) {
+		snprintf(name, sizeof(name), "area%d", i);
+		debugfs_create_file(name, S_IRUGO, root, &cma_areas[i],
+				    &cma_debugfs_fops);
+	}
+
+	return 0;
+}
+late_initcall(cma_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
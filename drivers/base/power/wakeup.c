@@ -15,6 +15,8 @@
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
 #include <linux/moduleparam.h>
+#include <linux/vmalloc.h>
+#include <linux/wakeup_stats.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -141,6 +143,7 @@ void wakeup_source_add(struct wakeup_source *ws)
 	spin_lock_init(&ws->lock);
 	setup_timer(&ws->timer, pm_wakeup_timer_fn, (unsigned long)ws);
 	ws->active = false;
+	ws->fts_tp = ws->name && !strcmp(ws->name, "fts_tp");
 	ws->last_time = ktime_get();
 
 	spin_lock_irqsave(&events_lock, flags);
@@ -210,7 +213,7 @@ static int device_wakeup_attach(struct device *dev, struct wakeup_source *ws)
 		spin_unlock_irq(&dev->power.lock);
 		return -EEXIST;
 	}
-	dev->power.wakeup = ws;
+	rcu_assign_pointer(dev->power.wakeup, ws);
 	spin_unlock_irq(&dev->power.lock);
 	return 0;
 }
@@ -388,6 +391,11 @@ static bool wakeup_source_not_registered(struct wakeup_source *ws)
  * It is valid to call pm_relax() after pm_wakeup_event(), in which case the
  * "no suspend" period will be ended either by the pm_relax(), or by the timer
  * function executed when the timer expires, whichever comes first.
+ *
+ * All of them only take the lock of the wakeup source in question.  The device
+ * variants find it under rcu_read_lock() rather than dev->power.lock, which
+ * is fine because wakeup_source_remove() waits for a grace period before the
+ * object can go away.
  */
 
 /**
@@ -406,9 +414,8 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 			"unregistered wakeup source\n"))
 		return;
 
-        if (!fts_tp_wl && !strcmp(ws->name, "fts_tp")) {
-                return;
-        }
+	if (ws->fts_tp && !fts_tp_wl)
+		return;
 
 	/*
 	 * active wakeup source should bring the system
@@ -459,8 +466,10 @@ void __pm_stay_awake(struct wakeup_source *ws)
 	spin_lock_irqsave(&ws->lock, flags);
 
 	wakeup_source_report_event(ws);
-	del_timer(&ws->timer);
-	ws->timer_expires = 0;
+	if (ws->timer_expires) {
+		del_timer(&ws->timer);
+		ws->timer_expires = 0;
+	}
 
 	spin_unlock_irqrestore(&ws->lock, flags);
 }
@@ -479,14 +488,12 @@ EXPORT_SYMBOL_GPL(__pm_stay_awake);
  */
 void pm_stay_awake(struct device *dev)
 {
-	unsigned long flags;
-
 	if (!dev)
 		return;
 
-	spin_lock_irqsave(&dev->power.lock, flags);
-	__pm_stay_awake(dev->power.wakeup);
-	spin_unlock_irqrestore(&dev->power.lock, flags);
+	rcu_read_lock();
+	__pm_stay_awake(rcu_dereference(dev->power.wakeup));
+	rcu_read_unlock();
 }
 EXPORT_SYMBOL_GPL(pm_stay_awake);
 
@@ -539,8 +546,10 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 		ws->max_time = duration;
 
 	ws->last_time = now;
-	del_timer(&ws->timer);
-	ws->timer_expires = 0;
+	if (ws->timer_expires) {
+		del_timer(&ws->timer);
+		ws->timer_expires = 0;
+	}
 
 	if (ws->autosleep_enabled)
 		update_prevent_sleep_time(ws, now);
@@ -570,7 +579,12 @@ void __pm_relax(struct wakeup_source *ws)
 {
 	unsigned long flags;
 
-	if (!ws)
+	/*
+	 * Drivers tend to call this unconditionally at the end of every event,
+	 * so don't bother taking the lock if there's nothing to deactivate.  A
+	 * racing activation is indistinguishable from one that came after us.
+	 */
+	if (!ws || !ACCESS_ONCE(ws->active))
 		return;
 
 	spin_lock_irqsave(&ws->lock, flags);
@@ -588,14 +602,12 @@ EXPORT_SYMBOL_GPL(__pm_relax);
  */
 void pm_relax(struct device *dev)
 {
-	unsigned long flags;
-
 	if (!dev)
 		return;
 
-	spin_lock_irqsave(&dev->power.lock, flags);
-	__pm_relax(dev->power.wakeup);
-	spin_unlock_irqrestore(&dev->power.lock, flags);
+	rcu_read_lock();
+	__pm_relax(rcu_dereference(dev->power.wakeup));
+	rcu_read_unlock();
 }
 EXPORT_SYMBOL_GPL(pm_relax);
 
@@ -605,7 +617,8 @@ EXPORT_SYMBOL_GPL(pm_relax);
  *
  * Call wakeup_source_deactivate() for the wakeup source whose address is stored
  * in @data if it is currently active and its timer has not been canceled and
- * the expiration time of the timer is not in future.
+ * the expiration time of the timer is not in future.  If the timeout has been
+ * extended by __pm_wakeup_event() in the meantime, rearm the timer instead.
  */
 static void pm_wakeup_timer_fn(unsigned long data)
 {
@@ -614,15 +627,52 @@ static void pm_wakeup_timer_fn(unsigned long data)
 
 	spin_lock_irqsave(&ws->lock, flags);
 
-	if (ws->active && ws->timer_expires
-	    && time_after_eq(jiffies, ws->timer_expires)) {
-		wakeup_source_deactivate(ws);
-		ws->expire_count++;
+	if (ws->active && ws->timer_expires) {
+		if (time_after_eq(jiffies, ws->timer_expires)) {
+			wakeup_source_deactivate(ws);
+			ws->expire_count++;
+		} else {
+			mod_timer(&ws->timer, ws->timer_expires);
+		}
 	}
 
 	spin_unlock_irqrestore(&ws->lock, flags);
 }
 
+/**
+ * wakeup_source_instant_event - Report a zero-length event for an idle source.
+ * @ws: Wakeup source to report the event for.
+ *
+ * Equivalent to activating @ws and deactivating it right away, but reads the
+ * clock once and updates the combined counter with a single atomic operation,
+ * as the number of events in progress doesn't change.
+ */
+static void wakeup_source_instant_event(struct wakeup_source *ws)
+{
+	unsigned int cec;
+
+	ws->event_count++;
+	if (events_check_enabled)
+		ws->wakeup_count++;
+
+	if (WARN(wakeup_source_not_registered(ws),
+			"unregistered wakeup source\n"))
+		return;
+
+	if (ws->fts_tp && !fts_tp_wl)
+		return;
+
+	freeze_wake();
+
+	ws->active_count++;
+	ws->relax_count++;
+	ws->last_time = ktime_get();
+
+	cec = atomic_add_return(1 << IN_PROGRESS_BITS, &combined_event_count);
+	trace_wakeup_source_activate(ws->name, cec);
+	trace_wakeup_source_deactivate(ws->name, cec);
+}
+
 /**
  * __pm_wakeup_event - Notify the PM core of a wakeup event.
  * @ws: Wakeup source object associated with the event source.
@@ -633,6 +683,11 @@ static void pm_wakeup_timer_fn(unsigned long data)
  * not active, activate it.  If @msec is nonzero, set up the @ws' timer to
  * execute pm_wakeup_timer_fn() in future.
  *
+ * Extending a pending timeout only moves ws->timer_expires forward, the timer
+ * function rearms itself when it finds it has fired early.  Sources reporting
+ * a stream of events with a timeout, like network and sensor drivers, thus
+ * touch the timer once per timeout period rather than once per event.
+ *
  * It is safe to call this function from interrupt context.
  */
 void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec)
@@ -645,20 +700,27 @@ void __pm_wakeup_event(struct wakeup_source *ws, unsigned int msec)
 
 	spin_lock_irqsave(&ws->lock, flags);
 
-	wakeup_source_report_event(ws);
-
 	if (!msec) {
-		wakeup_source_deactivate(ws);
+		if (ws->active) {
+			wakeup_source_report_event(ws);
+			wakeup_source_deactivate(ws);
+		} else {
+			wakeup_source_instant_event(ws);
+		}
 		goto unlock;
 	}
 
+	wakeup_source_report_event(ws);
+
 	expires = jiffies + msecs_to_jiffies(msec);
 	if (!expires)
 		expires = 1;
 
-	if (!ws->timer_expires || time_after(expires, ws->timer_expires)) {
+	if (!ws->timer_expires) {
 		mod_timer(&ws->timer, expires);
 		ws->timer_expires = expires;
+	} else if (time_after(expires, ws->timer_expires)) {
+		ws->timer_expires = expires;
 	}
 
  unlock:
@@ -676,14 +738,12 @@ EXPORT_SYMBOL_GPL(__pm_wakeup_event);
  */
 void pm_wakeup_event(struct device *dev, unsigned int msec)
 {
-	unsigned long flags;
-
 	if (!dev)
 		return;
 
-	spin_lock_irqsave(&dev->power.lock, flags);
-	__pm_wakeup_event(dev->power.wakeup, msec);
-	spin_unlock_irqrestore(&dev->power.lock, flags);
+	rcu_read_lock();
+	__pm_wakeup_event(rcu_dereference(dev->power.wakeup), msec);
+	rcu_read_unlock();
 }
 EXPORT_SYMBOL_GPL(pm_wakeup_event);
 
@@ -863,32 +923,32 @@ void pm_wakep_autosleep_enabled(bool set)
 #endif /* CONFIG_PM_AUTOSLEEP */
 
 static struct dentry *wakeup_sources_stats_dentry;
+static struct dentry *wakeup_sources_snapshot_dentry;
 
 /**
- * print_wakeup_source_stats - Print wakeup source statistics information.
- * @m: seq_file to print the statistics into.
- * @ws: Wakeup source object to print the statistics for.
+ * wakeup_source_get_stats - Take a consistent copy of wakeup source statistics.
+ * @ws: Wakeup source object to read the statistics of.
+ * @rec: Record to fill in, times are in nanoseconds.
+ * @now: Current time, used to account for an active source.
+ *
+ * The times of an active source are only folded into its totals when it is
+ * deactivated, so add the time elapsed since its activation here.
  */
-static int print_wakeup_source_stats(struct seq_file *m,
-				     struct wakeup_source *ws)
+static void wakeup_source_get_stats(struct wakeup_source *ws,
+				    struct wakeup_stats_record *rec, ktime_t now)
 {
 	unsigned long flags;
 	ktime_t total_time;
 	ktime_t max_time;
-	unsigned long active_count;
 	ktime_t active_time;
 	ktime_t prevent_sleep_time;
-	int ret;
 
 	spin_lock_irqsave(&ws->lock, flags);
 
 	total_time = ws->total_time;
 	max_time = ws->max_time;
 	prevent_sleep_time = ws->prevent_sleep_time;
-	active_count = ws->active_count;
 	if (ws->active) {
-		ktime_t now = ktime_get();
-
 		active_time = ktime_sub(now, ws->last_time);
 		total_time = ktime_add(total_time, active_time);
 		if (active_time.tv64 > max_time.tv64)
@@ -901,17 +961,41 @@ static int print_wakeup_source_stats(struct seq_file *m,
 		active_time = ktime_set(0, 0);
 	}
 
-	ret = seq_printf(m, "%-28s\t%lu\t\t%lu\t\t%lu\t\t%lu\t\t"
-			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
-			ws->name, active_count, ws->event_count,
-			ws->wakeup_count, ws->expire_count,
-			ktime_to_ms(active_time), ktime_to_ms(total_time),
-			ktime_to_ms(max_time), ktime_to_ms(ws->last_time),
-			ktime_to_ms(prevent_sleep_time));
+	rec->active_count = ws->active_count;
+	rec->event_count = ws->event_count;
+	rec->wakeup_count = ws->wakeup_count;
+	rec->expire_count = ws->expire_count;
+	rec->active_time_ns = ktime_to_ns(active_time);
+	rec->total_time_ns = ktime_to_ns(total_time);
+	rec->max_time_ns = ktime_to_ns(max_time);
+	rec->last_change_ns = ktime_to_ns(ws->last_time);
+	rec->prevent_sleep_time_ns = ktime_to_ns(prevent_sleep_time);
+	rec->active = ws->active;
 
 	spin_unlock_irqrestore(&ws->lock, flags);
+}
 
-	return ret;
+/**
+ * print_wakeup_source_stats - Print wakeup source statistics information.
+ * @m: seq_file to print the statistics into.
+ * @ws: Wakeup source object to print the statistics for.
+ */
+static int print_wakeup_source_stats(struct seq_file *m,
+				     struct wakeup_source *ws)
+{
+	struct wakeup_stats_record rec;
+
+	wakeup_source_get_stats(ws, &rec, ktime_get());
+
+	return seq_printf(m, "%-28s\t%llu\t\t%llu\t\t%llu\t\t%llu\t\t"
+			"%lld\t\t%lld\t\t%lld\t\t%lld\t\t%lld\n",
+			ws->name, rec.active_count, rec.event_count,
+			rec.wakeup_count, rec.expire_count,
+			div_s64(rec.active_time_ns, NSEC_PER_MSEC),
+			div_s64(rec.total_time_ns, NSEC_PER_MSEC),
+			div_s64(rec.max_time_ns, NSEC_PER_MSEC),
+			div_s64(rec.last_change_ns, NSEC_PER_MSEC),
+			div_s64(rec.prevent_sleep_time_ns, NSEC_PER_MSEC));
 }
 
 /**
@@ -947,10 +1031,95 @@ static const struct file_operations wakeup_sources_stats_fops = {
 	.release = single_release,
 };
 
+struct wakeup_sources_snapshot {
+	size_t size;
+	struct wakeup_stats_header hdr;
+	struct wakeup_stats_record recs[];
+};
+
+/**
+ * wakeup_sources_snapshot_open - Take a binary snapshot of all wakeup sources.
+ *
+ * The snapshot is taken once at open time, so a reader gets all of the
+ * sources at the same instant however small its reads are.  Sources added
+ * after the buffer has been sized are left out of it.
+ */
+static int wakeup_sources_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct wakeup_sources_snapshot *snap;
+	struct wakeup_source *ws;
+	unsigned int nr = 0, i = 0;
+	ktime_t now;
+
+	/* The header and the records are handed out as one buffer. */
+	BUILD_BUG_ON(offsetof(struct wakeup_sources_snapshot, recs) !=
+		     offsetof(struct wakeup_sources_snapshot, hdr) +
+		     sizeof(struct wakeup_stats_header));
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry)
+		nr++;
+	rcu_read_unlock();
+
+	snap = vzalloc(sizeof(*snap) + nr * sizeof(snap->recs[0]));
+	if (!snap)
+		return -ENOMEM;
+
+	now = ktime_get();
+	rcu_read_lock();
+	list_for_each_entry_rcu(ws, &wakeup_sources, entry) {
+		if (i == nr)
+			break;
+		if (ws->name)
+			strlcpy(snap->recs[i].name, ws->name,
+				sizeof(snap->recs[i].name));
+		wakeup_source_get_stats(ws, &snap->recs[i], now);
+		i++;
+	}
+	rcu_read_unlock();
+
+	snap->hdr.magic = WAKEUP_STATS_MAGIC;
+	snap->hdr.version = WAKEUP_STATS_VERSION;
+	snap->hdr.record_size = sizeof(snap->recs[0]);
+	snap->hdr.nr_records = i;
+	snap->hdr.timestamp_ns = ktime_to_ns(now);
+	snap->size = sizeof(snap->hdr) + i * sizeof(snap->recs[0]);
+
+	file->private_data = snap;
+	return nonseekable_open(inode, file);
+}
+
+static ssize_t wakeup_sources_snapshot_read(struct file *file, char __user *buf,
+					    size_t count, loff_t *ppos)
+{
+	struct wakeup_sources_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, &snap->hdr,
+				       snap->size);
+}
+
+static int wakeup_sources_snapshot_release(struct inode *inode,
+					   struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations wakeup_sources_snapshot_fops = {
+	.owner = THIS_MODULE,
+	.open = wakeup_sources_snapshot_open,
+	.read = wakeup_sources_snapshot_read,
+	.llseek = no_llseek,
+	.release = wakeup_sources_snapshot_release,
+};
+
 static int __init wakeup_sources_debugfs_init(void)
 {
 	wakeup_sources_stats_dentry = debugfs_create_file("wakeup_sources",
 			S_IRUGO, NULL, NULL, &wakeup_sources_stats_fops);
+	wakeup_sources_snapshot_dentry = debugfs_create_file(
+			"wakeup_sources_snapshot", S_IRUGO, NULL, NULL,
+			&wakeup_sources_snapshot_fops);
 	return 0;
 }
 
@@ -198,6 +198,16 @@ void cpuidle_profile_finish(int cpu, int early_wakeup)
 	spin_unlock(&substate_lock);
 }
 
+static DEFINE_PER_CPU(unsigned int [NUM_PREDICT_RESULT], predict_result);
+
+void cpuidle_profile_prediction(int cpu, int result)
+{
+	if (!profile_ongoing)
+		return;
+
+	per_cpu(predict_result, cpu)[result]++;
+}
+
 #define MAX_NUM_BLOCKER		2
 
 static int lpa_blocker[MAX_NUM_BLOCKER];
@@ -326,6 +336,39 @@ static void show_lpm_result(void)
 
 }
 
+static int calculate_ratio(unsigned int count, unsigned int total)
+{
+	if (!total)
+		return 0;
+
+	return count * 100 / total;
+}
+
+static void show_prediction_result(void)
+{
+		int cpu;
+		unsigned int *res, total;
+
+		pr_info("[Prediction] - idle governor misprediction\n");
+		pr_info("#cpu   #total    #hit   #deep   #shallow   #miss\n");
+		for_each_possible_cpu(cpu) {
+				res = per_cpu(predict_result, cpu);
+				total = res[PREDICT_HIT] + res[PREDICT_TOO_DEEP] +
+					res[PREDICT_TOO_SHALLOW];
+				if (!total)
+					continue;
+
+				pr_info("cpu%d   %6u  %6u  %6u     %6u    %3u%%\n", cpu,
+						total, res[PREDICT_HIT],
+						res[PREDICT_TOO_DEEP],
+						res[PREDICT_TOO_SHALLOW],
+						calculate_ratio(total - res[PREDICT_HIT],
+								total));
+		}
+
+		pr_info("\n");
+}
+
 static void show_result(void)
 {
 	int i, state_limit;
@@ -354,6 +397,8 @@ static void show_result(void)
 			break;
 	}
 
+	show_prediction_result();
+
 	pr_info("#######################################################################\n");
 }
 
@@ -396,6 +441,10 @@ static void clear_time(void)
 
 	for (i = 0; i < MAX_NUM_BLOCKER; i++)
 		lpa_blocker[i] = 0;
+
+	for_each_possible_cpu(i)
+		memset(per_cpu(predict_result, i), 0,
+		       sizeof(per_cpu(predict_result, i)));
 }
 
 static void call_cpu_start_profile(void *p) {};
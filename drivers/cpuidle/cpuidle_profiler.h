@@ -12,8 +12,6 @@
 #include <linux/ktime.h>
 #include <linux/cpuidle.h>
 
-#include <asm/cputype.h>
-
 struct cpuidle_profile_state_usage {
 	unsigned int entry_count;
 	unsigned int early_wakeup_count;
@@ -31,6 +29,20 @@ extern void cpuidle_profile_start(int cpu, int state);
 extern void cpuidle_profile_finish(int cpuid, int early_wakeup);
 extern void cpuidle_profile_state_init(struct cpuidle_driver *drv);
 
+/* Outcome of a governor's idle duration prediction */
+enum {
+	PREDICT_HIT,
+	PREDICT_TOO_DEEP,
+	PREDICT_TOO_SHALLOW,
+	NUM_PREDICT_RESULT,
+};
+
+#if defined(CONFIG_CPU_IDLE_EXYNOS) && !defined(CONFIG_SOC_EXYNOS7580)
+extern void cpuidle_profile_prediction(int cpu, int result);
+#else
+static inline void cpuidle_profile_prediction(int cpu, int result) {}
+#endif
+
 #define NUM_CLUSTER	2
 
 #endif /* CPUIDLE_PROFILE_H */
@@ -0,0 +1,418 @@
+/*
+ * predict.c - the predictive idle governor
+ *
+ * This code is licenced under the GPL version 2 as described
+ * in the COPYING file that acompanies the Linux Kernel.
+ */
+
+#include <linux/kernel.h>
+#include <linux/cpuidle.h>
+#include <linux/pm_qos.h>
+#include <linux/time.h>
+#include <linux/ktime.h>
+#include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+
+#include "../cpuidle_profiler.h"
+
+/*
+ * The menu governor scales the next timer event by a correction factor
+ * learnt per order of magnitude.  That works for random wakeups, but the
+ * short periodic ones coming from display vsync or audio DMA land in the
+ * same buckets as everything else, so the factor ends up too optimistic
+ * and the CPU keeps going into cluster power down just before the next
+ * frame.
+ *
+ * This governor instead predicts the next wakeup as the earliest of
+ *
+ * 1) the next timer event,
+ * 2) the next interrupt of any IRQ that has been arriving at a regular
+ *    rate on this CPU, extrapolated from its inter-arrival times, and
+ * 3) the typical recent idle duration of this CPU, when the last few
+ *    durations are close to each other.
+ *
+ * and picks the deepest state whose target residency fits in it.
+ *
+ * IRQ inter-arrival times are tracked per CPU in a small two-way table,
+ * updated from handle_irq_event_percpu() through cpuidle_predict_irq().
+ * Each entry keeps an exponentially weighted average of the interval and
+ * of its deviation from the average.  An IRQ is only used for prediction
+ * once it has been seen PREDICT_IRQ_MIN_HITS times with a deviation of at
+ * most a quarter of the average, and the prediction is pulled in by that
+ * deviation so that jitter errs towards shallower states.
+ *
+ * After each wakeup the prediction is checked against the measured idle
+ * time and counted as a hit, as too deep (the state's target residency was
+ * not reached) or as too shallow (an allowed deeper state would have paid
+ * off), which the cpuidle profiler reports as misprediction rates.
+ */
+
+#define PREDICT_HISTORY		8
+#define PREDICT_IRQ_SLOTS	16
+#define PREDICT_IRQ_MIN_HITS	4
+#define PREDICT_IRQ_MAX_US	(USEC_PER_SEC / 2)
+#define PREDICT_EWMA_SHIFT	3
+
+#define U64_MAX			((u64)~0ULL)
+
+struct predict_irq {
+	unsigned int	irq;
+	unsigned int	hits;
+	u64		last_ns;
+	int		avg_us;
+	int		dev_us;
+};
+
+struct predict_device {
+	int		last_state_idx;
+	int		needs_update;
+	int		latency_req;
+
+	unsigned int	next_timer_us;
+	unsigned int	predicted_us;
+	unsigned int	history[PREDICT_HISTORY];
+	int		history_ptr;
+
+	struct predict_irq irqs[PREDICT_IRQ_SLOTS];
+};
+
+static DEFINE_PER_CPU(struct predict_device, predict_devices);
+
+/* Number of CPUs using this governor, IRQs aren't tracked while it's zero */
+static atomic_t predict_users = ATOMIC_INIT(0);
+
+static void predict_update(struct cpuidle_driver *drv,
+			   struct cpuidle_device *dev);
+
+static struct predict_irq *predict_irq_slot(struct predict_device *data,
+					    unsigned int irq)
+{
+	struct predict_irq *a = &data->irqs[irq % PREDICT_IRQ_SLOTS];
+	struct predict_irq *b = &data->irqs[(irq % PREDICT_IRQ_SLOTS) ^ 1];
+
+	if (a->irq == irq && a->last_ns)
+		return a;
+	if (b->irq == irq && b->last_ns)
+		return b;
+
+	/* Evict the entry that has been quiet for longer */
+	if (b->last_ns < a->last_ns)
+		a = b;
+
+	a->irq = irq;
+	a->hits = 0;
+	a->last_ns = 0;
+	return a;
+}
+
+/**
+ * cpuidle_predict_irq - record the arrival of an interrupt
+ * @irq: the interrupt number
+ *
+ * Called with interrupts disabled on the CPU handling @irq, which is also
+ * the only CPU that looks at its table, so no locking is needed.
+ */
+void cpuidle_predict_irq(unsigned int irq)
+{
+	struct predict_device *data;
+	struct predict_irq *slot;
+	unsigned int interval;
+	int diff;
+	u64 now;
+
+	if (!atomic_read(&predict_users))
+		return;
+
+	data = this_cpu_ptr(&predict_devices);
+	slot = predict_irq_slot(data, irq);
+	now = local_clock();
+
+	if (!slot->last_ns) {
+		slot->last_ns = now;
+		return;
+	}
+
+	interval = div_u64(now - slot->last_ns, NSEC_PER_USEC);
+	slot->last_ns = now;
+
+	if (interval > PREDICT_IRQ_MAX_US) {
+		slot->hits = 0;
+		return;
+	}
+
+	if (!slot->hits) {
+		slot->avg_us = interval;
+		slot->dev_us = interval / 2;
+		slot->hits = 1;
+		return;
+	}
+
+	diff = (int)interval - slot->avg_us;
+	slot->avg_us += diff / (1 << PREDICT_EWMA_SHIFT);
+	slot->dev_us += (abs(diff) - slot->dev_us) / (1 << PREDICT_EWMA_SHIFT);
+	if (slot->hits < PREDICT_IRQ_MIN_HITS)
+		slot->hits++;
+}
+
+/*
+ * Return the time in us until the earliest expected interrupt among the
+ * regular ones, or UINT_MAX if there is none.  An interrupt that is already
+ * due is assumed to have been missed once; one that is overdue by more than
+ * that has stopped and is ignored.
+ */
+static unsigned int predict_next_irq(struct predict_device *data, u64 now)
+{
+	unsigned int next_us = UINT_MAX;
+	int i;
+
+	for (i = 0; i < PREDICT_IRQ_SLOTS; i++) {
+		struct predict_irq *slot = &data->irqs[i];
+		unsigned int period, remaining;
+		u64 since;
+
+		if (!slot->last_ns || slot->hits < PREDICT_IRQ_MIN_HITS ||
+		    slot->avg_us <= 0 || slot->dev_us * 4 > slot->avg_us)
+			continue;
+
+		if (now <= slot->last_ns)
+			since = 0;
+		else
+			since = div_u64(now - slot->last_ns, NSEC_PER_USEC);
+
+		period = slot->avg_us;
+		if (since >= 2 * period)
+			continue;
+		if (since >= period)
+			period *= 2;
+
+		remaining = period - since;
+		if (remaining > slot->dev_us)
+			remaining -= slot->dev_us;
+		else
+			remaining = 0;
+
+		next_us = min(next_us, remaining);
+	}
+
+	return next_us;
+}
+
+/*
+ * Return the average of the recent idle durations if they are close to each
+ * other (standard deviation under 20 us or under a sixth of the average),
+ * UINT_MAX otherwise.  The longest sample is dropped and the check repeated
+ * while at least 3/4 of the samples remain, like menu does.
+ */
+static unsigned int predict_typical_interval(struct predict_device *data)
+{
+	unsigned int max, thresh = UINT_MAX, avg;
+	u64 sum, variance;
+	int i, divisor;
+
+	for (;;) {
+		max = 0;
+		sum = 0;
+		divisor = 0;
+		for (i = 0; i < PREDICT_HISTORY; i++) {
+			unsigned int value = data->history[i];
+
+			if (value <= thresh) {
+				sum += value;
+				divisor++;
+				if (value > max)
+					max = value;
+			}
+		}
+		avg = div_u64(sum, divisor);
+
+		variance = 0;
+		for (i = 0; i < PREDICT_HISTORY; i++) {
+			unsigned int value = data->history[i];
+
+			if (value <= thresh) {
+				s64 diff = (s64)value - avg;
+
+				variance += diff * diff;
+			}
+		}
+		variance = div_u64(variance, divisor);
+
+		if (variance <= 400 ||
+		    (variance <= U64_MAX / 36 && (u64)avg * avg > variance * 36))
+			return avg;
+
+		if (divisor * 4 <= PREDICT_HISTORY * 3)
+			return UINT_MAX;
+
+		thresh = max - 1;
+	}
+}
+
+/**
+ * predict_select - selects the next idle state to enter
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static int predict_select(struct cpuidle_driver *drv,
+			  struct cpuidle_device *dev)
+{
+	struct predict_device *data = this_cpu_ptr(&predict_devices);
+	int latency_req = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	unsigned int irq_us, typical_us;
+	int i;
+
+	if (data->needs_update) {
+		predict_update(drv, dev);
+		data->needs_update = 0;
+	}
+
+	data->last_state_idx = CPUIDLE_DRIVER_STATE_START;
+	data->latency_req = latency_req;
+
+	/* Special case when user has set very strict latency requirement */
+	if (unlikely(latency_req == 0)) {
+		data->last_state_idx = 0;
+		return 0;
+	}
+
+	data->next_timer_us = ktime_to_us(tick_nohz_get_sleep_length());
+	irq_us = predict_next_irq(data, local_clock());
+	typical_us = predict_typical_interval(data);
+
+	data->predicted_us = min3(data->next_timer_us, irq_us, typical_us);
+
+	for (i = CPUIDLE_DRIVER_STATE_START; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+		struct cpuidle_state_usage *su = &dev->states_usage[i];
+
+		if (s->disabled || su->disable)
+			continue;
+		if (s->target_residency > data->predicted_us)
+			continue;
+		if (s->exit_latency > latency_req)
+			continue;
+
+		data->last_state_idx = i;
+	}
+
+	return data->last_state_idx;
+}
+
+/**
+ * predict_reflect - records that data structures need update
+ * @dev: the CPU
+ * @index: the index of actual entered state
+ *
+ * As with menu, the bookkeeping is left to the next predict_select() to
+ * keep the exit path short.
+ */
+static void predict_reflect(struct cpuidle_device *dev, int index)
+{
+	struct predict_device *data = this_cpu_ptr(&predict_devices);
+
+	data->last_state_idx = index;
+	data->needs_update = 1;
+}
+
+/*
+ * Classify the last prediction: too deep if the residency of the entered
+ * state was not reached, too shallow if a deeper state that was allowed at
+ * the time would have been reached.
+ */
+static int predict_result(struct cpuidle_driver *drv,
+			  struct cpuidle_device *dev,
+			  struct predict_device *data, unsigned int measured_us)
+{
+	int last_idx = data->last_state_idx;
+	int i;
+
+	if (last_idx > CPUIDLE_DRIVER_STATE_START &&
+	    measured_us < drv->states[last_idx].target_residency)
+		return PREDICT_TOO_DEEP;
+
+	for (i = last_idx + 1; i < drv->state_count; i++) {
+		struct cpuidle_state *s = &drv->states[i];
+
+		if (s->disabled || dev->states_usage[i].disable ||
+		    s->exit_latency > data->latency_req)
+			continue;
+		if (s->target_residency <= measured_us)
+			return PREDICT_TOO_SHALLOW;
+	}
+
+	return PREDICT_HIT;
+}
+
+/**
+ * predict_update - records the outcome of the last prediction
+ * @drv: cpuidle driver containing state data
+ * @dev: the CPU
+ */
+static void predict_update(struct cpuidle_driver *drv,
+			   struct cpuidle_device *dev)
+{
+	struct predict_device *data = this_cpu_ptr(&predict_devices);
+	struct cpuidle_state *target = &drv->states[data->last_state_idx];
+	unsigned int measured_us = cpuidle_get_last_residency(dev);
+
+	/*
+	 * The measured time includes the exit latency, which we aren't
+	 * interested in; if it is shorter than that, assume the state was
+	 * never really reached.
+	 */
+	if (measured_us > 2 * target->exit_latency)
+		measured_us -= target->exit_latency;
+	else
+		measured_us /= 2;
+
+	cpuidle_profile_prediction(dev->cpu,
+			predict_result(drv, dev, data, measured_us));
+
+	data->history[data->history_ptr++] = measured_us;
+	if (data->history_ptr >= PREDICT_HISTORY)
+		data->history_ptr = 0;
+}
+
+/**
+ * predict_enable_device - scans a CPU's states and does setup
+ * @drv: cpuidle driver
+ * @dev: the CPU
+ */
+static int predict_enable_device(struct cpuidle_driver *drv,
+				 struct cpuidle_device *dev)
+{
+	struct predict_device *data = &per_cpu(predict_devices, dev->cpu);
+
+	memset(data, 0, sizeof(struct predict_device));
+	atomic_inc(&predict_users);
+
+	return 0;
+}
+
+static void predict_disable_device(struct cpuidle_driver *drv,
+				   struct cpuidle_device *dev)
+{
+	atomic_dec(&predict_users);
+}
+
+static struct cpuidle_governor predict_governor = {
+	.name =		"predict",
+	.rating =	30,
+	.enable =	predict_enable_device,
+	.disable =	predict_disable_device,
+	.select =	predict_select,
+	.reflect =	predict_reflect,
+	.owner =	THIS_MODULE,
+};
+
+/**
+ * init_predict - initializes the governor
+ */
+static int __init init_predict(void)
+{
+	return cpuidle_register_governor(&predict_governor);
+}
+
+postcore_initcall(init_predict);
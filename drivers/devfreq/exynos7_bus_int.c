@@ -51,12 +51,27 @@ static int exynos7420_mif_table_for_int[] = {
 	0,			/* INT_LV11 */
 };
 
+#if IS_ENABLED(CONFIG_DEVFREQ_GOV_BUS_HINT)
+static struct devfreq_bus_hint_data exynos7_devfreq_int_hint_data = {
+	.pm_qos_class		= PM_QOS_DEVICE_THROUGHPUT,
+	.upthreshold		= 70,
+	.downdifferential	= 20,
+	.cpu_scale_max		= 150,
+	.boost_freq		= 400000,
+	.cal_qos_max		= 560000,
+};
+#define DEVFREQ_INT_GOVERNOR		"bus_hint"
+#define DEVFREQ_INT_GOVERNOR_DATA	(&exynos7_devfreq_int_hint_data)
+#else
 static struct devfreq_simple_ondemand_data exynos7_devfreq_int_governor_data = {
 	.pm_qos_class		= PM_QOS_DEVICE_THROUGHPUT,
 	.upthreshold		= 70,
 	.downdifferential	= 20,
 	.cal_qos_max		= 560000,
 };
+#define DEVFREQ_INT_GOVERNOR		"simple_ondemand"
+#define DEVFREQ_INT_GOVERNOR_DATA	(&exynos7_devfreq_int_governor_data)
+#endif
 
 static struct exynos_devfreq_platdata exynos7420_qos_int = {
 	.default_qos		= 100000,
@@ -311,8 +326,8 @@ static int exynos7_devfreq_int_probe(struct platform_device *pdev)
 		data->old_volt = regulator_get_voltage(data->vdd_int);
 	data->devfreq = devfreq_add_device(data->dev,
 						&exynos7_devfreq_int_profile,
-						"simple_ondemand",
-						&exynos7_devfreq_int_governor_data);
+						DEVFREQ_INT_GOVERNOR,
+						DEVFREQ_INT_GOVERNOR_DATA);
 
 	devfreq_nb = kzalloc(sizeof(struct devfreq_notifier_block), GFP_KERNEL);
 	if (devfreq_nb == NULL) {
@@ -50,6 +50,23 @@ static struct devfreq_simple_exynos_data exynos7_devfreq_mif_governor_data = {
 	.cal_qos_max		= (3104000/2),
 };
 
+#if IS_ENABLED(CONFIG_DEVFREQ_GOV_BUS_HINT)
+static struct devfreq_bus_hint_data exynos7_devfreq_mif_hint_data = {
+	.pm_qos_class		= PM_QOS_BUS_THROUGHPUT,
+	.pm_qos_class_max	= PM_QOS_BUS_THROUGHPUT_MAX,
+	.upthreshold		= 70,
+	.downdifferential	= 15,
+	.cpu_scale_max		= 200,
+	.boost_freq		= (1656000/2),
+	.cal_qos_max		= (3104000/2),
+};
+#define DEVFREQ_MIF_GOVERNOR		"bus_hint"
+#define DEVFREQ_MIF_GOVERNOR_DATA	(&exynos7_devfreq_mif_hint_data)
+#else
+#define DEVFREQ_MIF_GOVERNOR		"simple_exynos"
+#define DEVFREQ_MIF_GOVERNOR_DATA	(&exynos7_devfreq_mif_governor_data)
+#endif
+
 static struct exynos_devfreq_platdata exynos7420_qos_mif = {
 	.default_qos		= 552000/2,
 };
@@ -423,8 +440,8 @@ static int exynos7_devfreq_mif_probe(struct platform_device *pdev)
 
 	data->devfreq = devfreq_add_device(data->dev,
 						&exynos7_devfreq_mif_profile,
-						"simple_exynos",
-						&exynos7_devfreq_mif_governor_data);
+						DEVFREQ_MIF_GOVERNOR,
+						DEVFREQ_MIF_GOVERNOR_DATA);
 
 	exynos7_devfreq_init_thermal();
 
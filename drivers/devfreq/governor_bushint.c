@@ -0,0 +1,363 @@
+/*
+ *  linux/drivers/devfreq/governor_bushint.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/devfreq.h>
+#include <linux/math64.h>
+#include <linux/pm_qos.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "governor.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/devfreq.h>
+
+/*
+ * The bus devices are re-evaluated when the PPMU monitor publishes a new
+ * window of counters, which happens every 100ms.  A CPU that ramps up for
+ * a memory bound burst would wait for up to a full window before MIF and
+ * INT follow it, so besides the PPMU busy ratio and the PM QoS limits this
+ * governor also reacts to
+ *
+ * - CPU frequency increases: the busy ratio of the last window is scaled
+ *   by how much faster the fastest CPU now runs than it did during that
+ *   window, and the devices are re-evaluated right away;
+ * - frame deadlines: devfreq_bus_hint_boost() holds every device at no
+ *   less than its boost_freq until the given deadline.
+ *
+ * Every decision is recorded by the devfreq_bus_hint trace event.
+ */
+
+/* Default constants for DevFreq-Bus-Hint (DFBH) */
+#define DFBH_UPTHRESHOLD	(70)
+#define DFBH_DOWNDIFFERENTIAL	(15)
+
+static struct workqueue_struct *bus_hint_wq;
+static DEFINE_SPINLOCK(bus_hint_lock);
+static LIST_HEAD(bus_hint_list);
+static ktime_t bus_hint_boost_until;
+
+static DEFINE_PER_CPU(unsigned int, bus_hint_cpu_cur);
+static unsigned int bus_hint_cpu_freq;
+
+static void bus_hint_kick(bool cpu_scaled_only)
+{
+	struct devfreq_bus_hint_data *data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bus_hint_lock, flags);
+	list_for_each_entry(data, &bus_hint_list, node) {
+		if (!cpu_scaled_only || data->cpu_scale_max)
+			queue_work(bus_hint_wq, &data->work);
+	}
+	spin_unlock_irqrestore(&bus_hint_lock, flags);
+}
+
+static bool bus_hint_boosted(void)
+{
+	unsigned long flags;
+	bool ret;
+
+	spin_lock_irqsave(&bus_hint_lock, flags);
+	ret = ktime_compare(bus_hint_boost_until, ktime_get()) > 0;
+	spin_unlock_irqrestore(&bus_hint_lock, flags);
+
+	return ret;
+}
+
+static void bus_hint_boost_end(struct work_struct *work)
+{
+	bus_hint_kick(false);
+}
+
+static DECLARE_DELAYED_WORK(bus_hint_boost_work, bus_hint_boost_end);
+
+/**
+ * devfreq_bus_hint_boost() - Keep the buses fast until a frame deadline
+ * @deadline:	ktime_get() based time until which to boost.
+ *
+ * Raise every device using the bus_hint governor to at least its
+ * boost_freq until @deadline.  Extending a pending boost is cheap, so
+ * this may be called for every frame.  It is safe to call it from atomic
+ * context.
+ */
+void devfreq_bus_hint_boost(ktime_t deadline)
+{
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	bool was_boosted;
+
+	if (ktime_compare(deadline, now) <= 0)
+		return;
+
+	spin_lock_irqsave(&bus_hint_lock, flags);
+	if (ktime_compare(deadline, bus_hint_boost_until) <= 0) {
+		spin_unlock_irqrestore(&bus_hint_lock, flags);
+		return;
+	}
+	was_boosted = ktime_compare(bus_hint_boost_until, now) > 0;
+	bus_hint_boost_until = deadline;
+	spin_unlock_irqrestore(&bus_hint_lock, flags);
+
+	mod_delayed_work(bus_hint_wq, &bus_hint_boost_work,
+			 usecs_to_jiffies(ktime_us_delta(deadline, now)) + 1);
+
+	if (!was_boosted)
+		bus_hint_kick(false);
+}
+EXPORT_SYMBOL_GPL(devfreq_bus_hint_boost);
+
+static int bus_hint_cpufreq_notifier(struct notifier_block *nb,
+				     unsigned long val, void *v)
+{
+	struct cpufreq_freqs *freqs = v;
+	unsigned int fastest = 0, old = bus_hint_cpu_freq;
+	int cpu;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return NOTIFY_DONE;
+
+	per_cpu(bus_hint_cpu_cur, freqs->cpu) = freqs->new;
+	for_each_online_cpu(cpu)
+		fastest = max(fastest, per_cpu(bus_hint_cpu_cur, cpu));
+	bus_hint_cpu_freq = fastest;
+
+	/* Slowing down is left to the next PPMU window */
+	if (fastest > old)
+		bus_hint_kick(true);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block bus_hint_cpufreq_nb = {
+	.notifier_call = bus_hint_cpufreq_notifier,
+};
+
+static int devfreq_bus_hint_func(struct devfreq *df, unsigned long *freq)
+{
+	struct devfreq_bus_hint_data *data = df->data;
+	struct devfreq_dev_status stat;
+	unsigned int upthreshold = DFBH_UPTHRESHOLD;
+	unsigned int downdifferential = DFBH_DOWNDIFFERENTIAL;
+	unsigned long max_freq = (df->max_freq) ? df->max_freq : UINT_MAX;
+	unsigned long pm_qos_min, pm_qos_max = 0;
+	unsigned long load_freq, boost_freq = 0;
+	unsigned int cpu_freq, busy = 100, cpu_scale = 100;
+	int err;
+
+	if (!data)
+		return -EINVAL;
+
+	pm_qos_min = pm_qos_request(data->pm_qos_class);
+#ifdef CONFIG_HYBRID_INVOKING
+	df->locked_min_freq = pm_qos_min;
+#endif
+	if (data->pm_qos_class_max)
+		pm_qos_max = pm_qos_request(data->pm_qos_class_max);
+
+	if (data->upthreshold)
+		upthreshold = data->upthreshold;
+	if (data->downdifferential)
+		downdifferential = data->downdifferential;
+	if (upthreshold > 100 || upthreshold < downdifferential)
+		return -EINVAL;
+
+	if (data->cal_qos_max)
+		max_freq = data->cal_qos_max;
+
+	err = df->profile->get_dev_status(df->dev.parent, &stat);
+	if (err)
+		return err;
+
+	/* Remember how fast the CPUs were when a new PPMU window shows up */
+	cpu_freq = ACCESS_ONCE(bus_hint_cpu_freq);
+	if (stat.busy_time != data->last_busy ||
+	    stat.total_time != data->last_total) {
+		data->last_busy = stat.busy_time;
+		data->last_total = stat.total_time;
+		data->window_cpu_freq = cpu_freq;
+	}
+
+	/* Assume MAX if we can't tell the load or the initial frequency */
+	if (stat.total_time == 0 || stat.current_frequency == 0) {
+		load_freq = max_freq;
+		goto out;
+	}
+
+	busy = div64_u64(stat.busy_time * 100, stat.total_time);
+	if (data->cpu_scale_max && data->window_cpu_freq &&
+	    cpu_freq > data->window_cpu_freq) {
+		cpu_scale = min(cpu_freq * 100 / data->window_cpu_freq,
+				data->cpu_scale_max);
+		busy = busy * cpu_scale / 100;
+	}
+
+	if (busy > upthreshold)
+		load_freq = max_freq;
+	else if (busy > upthreshold - downdifferential)
+		load_freq = stat.current_frequency;
+	else
+		load_freq = div_u64((u64)stat.current_frequency * busy,
+				    upthreshold - downdifferential / 2);
+
+out:
+	if (data->boost_freq && bus_hint_boosted())
+		boost_freq = data->boost_freq;
+
+	*freq = min(max(load_freq, boost_freq), max_freq);
+	*freq = max(*freq, pm_qos_min);
+	if (pm_qos_max)
+		*freq = min(*freq, pm_qos_max);
+
+	trace_devfreq_bus_hint(dev_name(df->dev.parent), busy, cpu_scale,
+			       load_freq, boost_freq, pm_qos_min, pm_qos_max,
+			       stat.current_frequency, *freq);
+
+	return 0;
+}
+
+static void devfreq_bus_hint_work(struct work_struct *work)
+{
+	struct devfreq_bus_hint_data *data =
+		container_of(work, struct devfreq_bus_hint_data, work);
+	struct devfreq *df = data->nb.df;
+
+	mutex_lock(&df->lock);
+	update_devfreq(df);
+	mutex_unlock(&df->lock);
+}
+
+static int devfreq_bus_hint_notifier(struct notifier_block *nb,
+				     unsigned long val, void *v)
+{
+	struct devfreq_notifier_block *devfreq_nb;
+
+	devfreq_nb = container_of(nb, struct devfreq_notifier_block, nb);
+
+	mutex_lock(&devfreq_nb->df->lock);
+	update_devfreq(devfreq_nb->df);
+	mutex_unlock(&devfreq_nb->df->lock);
+
+	return NOTIFY_OK;
+}
+
+static int devfreq_bus_hint_start(struct devfreq *df)
+{
+	struct devfreq_bus_hint_data *data = df->data;
+	unsigned long flags;
+	int ret;
+
+	if (!data)
+		return -EINVAL;
+
+	data->nb.df = df;
+	data->nb.nb.notifier_call = devfreq_bus_hint_notifier;
+	INIT_WORK(&data->work, devfreq_bus_hint_work);
+
+	ret = pm_qos_add_notifier(data->pm_qos_class, &data->nb.nb);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irqsave(&bus_hint_lock, flags);
+	list_add_tail(&data->node, &bus_hint_list);
+	spin_unlock_irqrestore(&bus_hint_lock, flags);
+
+	return 0;
+}
+
+static int devfreq_bus_hint_stop(struct devfreq *df)
+{
+	struct devfreq_bus_hint_data *data = df->data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&bus_hint_lock, flags);
+	list_del(&data->node);
+	spin_unlock_irqrestore(&bus_hint_lock, flags);
+
+	cancel_work_sync(&data->work);
+
+	return pm_qos_remove_notifier(data->pm_qos_class, &data->nb.nb);
+}
+
+static int devfreq_bus_hint_handler(struct devfreq *devfreq,
+				unsigned int event, void *data)
+{
+	int ret;
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		ret = devfreq_bus_hint_start(devfreq);
+		if (ret)
+			return ret;
+		devfreq_monitor_start(devfreq);
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		devfreq_monitor_stop(devfreq);
+		ret = devfreq_bus_hint_stop(devfreq);
+		if (ret)
+			return ret;
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		devfreq_interval_update(devfreq, (unsigned int *)data);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		devfreq_monitor_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		devfreq_monitor_resume(devfreq);
+		break;
+
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static struct devfreq_governor devfreq_bus_hint = {
+	.name = "bus_hint",
+	.get_target_freq = devfreq_bus_hint_func,
+	.event_handler = devfreq_bus_hint_handler,
+};
+
+static int __init devfreq_bus_hint_init(void)
+{
+	int ret;
+
+	bus_hint_wq = alloc_workqueue("devfreq_bus_hint",
+				      WQ_FREEZABLE | WQ_HIGHPRI, 0);
+	if (!bus_hint_wq)
+		return -ENOMEM;
+
+	ret = cpufreq_register_notifier(&bus_hint_cpufreq_nb,
+					CPUFREQ_TRANSITION_NOTIFIER);
+	if (ret)
+		goto err_wq;
+
+	ret = devfreq_add_governor(&devfreq_bus_hint);
+	if (ret)
+		goto err_nb;
+
+	return 0;
+
+err_nb:
+	cpufreq_unregister_notifier(&bus_hint_cpufreq_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+err_wq:
+	destroy_workqueue(bus_hint_wq);
+	return ret;
+}
+subsys_initcall(devfreq_bus_hint_init);
@@ -31,6 +31,11 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/shmem_fs.h>
+#include <linux/spinlock.h>
+#include <linux/percpu.h>
+#include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include "ashmem.h"
 
 #define ASHMEM_NAME_PREFIX "dev/ashmem/"
@@ -40,7 +45,7 @@
 /*
  * ashmem_area - anonymous shared memory area
  * Lifecycle: From our parent file's open() until its release()
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its own `mutex'
  * Big Note: Mappings do NOT pin this structure; it dies on close()
  */
 struct ashmem_area {
@@ -49,12 +54,15 @@ struct ashmem_area {
 	struct file *file;		 /* the shmem-based backing file */
 	size_t size;			 /* size of the mapping, in bytes */
 	unsigned long prot_mask;	 /* allowed prot bits, as vm_flags */
+	struct mutex mutex;		 /* protects all of the above */
+	atomic_t purging;		 /* ranges the shrinker is punching */
 };
 
 /*
  * ashmem_range - represents an interval of unpinned (evictable) pages
  * Lifecycle: From unpin to pin
- * Locking: Protected by `ashmem_mutex'
+ * Locking: Protected by its area's mutex; `lru' by the lock of the LRU
+ * list given by `lru_cpu'
  */
 struct ashmem_range {
 	struct list_head lru;		/* entry in LRU list */
@@ -63,20 +71,67 @@ struct ashmem_range {
 	size_t pgstart;			/* starting page, inclusive */
 	size_t pgend;			/* ending page, inclusive */
 	unsigned int purged;		/* ASHMEM_NOT or ASHMEM_WAS_PURGED */
+	int lru_cpu;			/* batch it sits in, or LRU_GLOBAL */
 };
 
-/* LRU list of unpinned pages, protected by ashmem_mutex */
-static LIST_HEAD(ashmem_lru_list);
+/*
+ * Freshly unpinned ranges are first put on a per-CPU batch and only
+ * spliced onto the global LRU list once ASHMEM_LRU_BATCH of them have
+ * piled up, or when the shrinker needs them.  A range that is pinned
+ * again shortly after being unpinned, which is the common case, never
+ * touches the global lock.
+ */
+#define ASHMEM_LRU_BATCH	16
+#define LRU_GLOBAL		(-1)
+
+struct ashmem_lru_batch {
+	spinlock_t lock;
+	struct list_head list;
+	unsigned int nr;
+};
 
-/* Count of pages on our LRU list, protected by ashmem_mutex */
-static unsigned long lru_count;
+static DEFINE_PER_CPU(struct ashmem_lru_batch, ashmem_lru_batch);
 
 /*
- * ashmem_mutex - protects the list of and each individual ashmem_area
+ * ashmem_lru_lock - protects the global LRU list of unpinned ranges
  *
- * Lock Ordering: ashmex_mutex -> i_mutex -> i_alloc_sem
+ * Lock Ordering: asma->mutex -> batch lock -> ashmem_lru_lock
+ * The shrinker only ever trylocks an area's mutex under ashmem_lru_lock.
  */
-static DEFINE_MUTEX(ashmem_mutex);
+static DEFINE_SPINLOCK(ashmem_lru_lock);
+static LIST_HEAD(ashmem_lru_list);
+
+/* Count of pages on the global LRU list and all batches */
+static atomic_long_t lru_count = ATOMIC_LONG_INIT(0);
+
+/* Woken when an area's last in-flight purge has finished */
+static DECLARE_WAIT_QUEUE_HEAD(ashmem_purge_wait);
+
+enum ashmem_stat_item {
+	ASHMEM_STAT_PIN,
+	ASHMEM_STAT_UNPIN,
+	ASHMEM_STAT_CONTENDED,		/* area mutex was already held */
+	ASHMEM_STAT_PURGE_WAIT,		/* pin waited for the shrinker */
+	ASHMEM_STAT_SHRINK_BUSY,	/* shrinker skipped a locked area */
+	ASHMEM_STAT_LRU_DRAIN,
+	ASHMEM_STAT_PURGED,		/* pages */
+	NR_ASHMEM_STATS
+};
+
+static const char * const ashmem_stat_names[NR_ASHMEM_STATS] = {
+	"pin",
+	"unpin",
+	"contended",
+	"purge_wait",
+	"shrink_busy",
+	"lru_drain",
+	"purged",
+};
+
+static DEFINE_PER_CPU(unsigned long [NR_ASHMEM_STATS], ashmem_stats);
+
+#define ashmem_stat_add(item, n)	this_cpu_add(ashmem_stats[item], n)
+#define ashmem_stat_inc(item)		ashmem_stat_add(item, 1)
 
 static struct kmem_cache *ashmem_area_cachep __read_mostly;
 static struct kmem_cache *ashmem_range_cachep __read_mostly;
@@ -105,16 +160,96 @@ static struct kmem_cache *ashmem_range_cachep __read_mostly;
 
 #define PROT_MASK		(PROT_EXEC | PROT_READ | PROT_WRITE)
 
-static inline void lru_add(struct ashmem_range *range)
+/*
+ * lru_drain_batch - move a CPU's batch to the tail of the global LRU list
+ *
+ * Caller must hold the batch lock.
+ */
+static void lru_drain_batch(struct ashmem_lru_batch *batch)
 {
-	list_add_tail(&range->lru, &ashmem_lru_list);
-	lru_count += range_size(range);
+	struct ashmem_range *range;
+
+	if (!batch->nr)
+		return;
+
+	spin_lock(&ashmem_lru_lock);
+	list_for_each_entry(range, &batch->list, lru)
+		range->lru_cpu = LRU_GLOBAL;
+	list_splice_tail_init(&batch->list, &ashmem_lru_list);
+	spin_unlock(&ashmem_lru_lock);
+
+	batch->nr = 0;
+	ashmem_stat_inc(ASHMEM_STAT_LRU_DRAIN);
 }
 
-static inline void lru_del(struct ashmem_range *range)
+static void lru_drain_all(void)
 {
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ashmem_lru_batch *batch = &per_cpu(ashmem_lru_batch, cpu);
+
+		spin_lock(&batch->lock);
+		lru_drain_batch(batch);
+		spin_unlock(&batch->lock);
+	}
+}
+
+static void lru_add(struct ashmem_range *range)
+{
+	struct ashmem_lru_batch *batch;
+	int cpu;
+
+	cpu = get_cpu();
+	batch = &per_cpu(ashmem_lru_batch, cpu);
+	spin_lock(&batch->lock);
+	range->lru_cpu = cpu;
+	list_add_tail(&range->lru, &batch->list);
+	if (++batch->nr >= ASHMEM_LRU_BATCH)
+		lru_drain_batch(batch);
+	spin_unlock(&batch->lock);
+	put_cpu();
+
+	atomic_long_add(range_size(range), &lru_count);
+}
+
+/*
+ * lru_del - take a range off whichever LRU list it is on
+ *
+ * A range only ever moves from a batch to the global list, so it is found
+ * by locking the list `lru_cpu' names and checking it did not move.
+ */
+static void lru_del(struct ashmem_range *range)
+{
+	struct ashmem_lru_batch *batch;
+	spinlock_t *lock;
+	int cpu;
+
+	for (;;) {
+		cpu = ACCESS_ONCE(range->lru_cpu);
+		batch = cpu == LRU_GLOBAL ? NULL : &per_cpu(ashmem_lru_batch, cpu);
+		lock = batch ? &batch->lock : &ashmem_lru_lock;
+
+		spin_lock(lock);
+		if (likely(range->lru_cpu == cpu))
+			break;
+		spin_unlock(lock);
+	}
+
 	list_del(&range->lru);
-	lru_count -= range_size(range);
+	if (batch)
+		batch->nr--;
+	spin_unlock(lock);
+
+	atomic_long_sub(range_size(range), &lru_count);
+}
+
+static void ashmem_lock_area(struct ashmem_area *asma)
+{
+	if (!mutex_trylock(&asma->mutex)) {
+		ashmem_stat_inc(ASHMEM_STAT_CONTENDED);
+		mutex_lock(&asma->mutex);
+	}
 }
 
 /*
@@ -126,7 +261,7 @@ static inline void lru_del(struct ashmem_range *range)
  * 'start' - starting page, inclusive
  * 'end' - ending page, inclusive
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int range_alloc(struct ashmem_area *asma,
 		       struct ashmem_range *prev_range, unsigned int purged,
@@ -162,7 +297,7 @@ static void range_del(struct ashmem_range *range)
 /*
  * range_shrink - shrinks a range
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static inline void range_shrink(struct ashmem_range *range,
 				size_t start, size_t end)
@@ -173,7 +308,7 @@ static inline void range_shrink(struct ashmem_range *range,
 	range->pgend = end;
 
 	if (range_on_lru(range))
-		lru_count -= pre - range_size(range);
+		atomic_long_sub(pre - range_size(range), &lru_count);
 }
 
 static int ashmem_open(struct inode *inode, struct file *file)
@@ -190,6 +325,8 @@ static int ashmem_open(struct inode *inode, struct file *file)
 		return -ENOMEM;
 
 	INIT_LIST_HEAD(&asma->unpinned_list);
+	mutex_init(&asma->mutex);
+	atomic_set(&asma->purging, 0);
 	memcpy(asma->name, ASHMEM_NAME_PREFIX, ASHMEM_NAME_PREFIX_LEN);
 	asma->prot_mask = PROT_MASK;
 	file->private_data = asma;
@@ -202,10 +339,13 @@ static int ashmem_release(struct inode *ignored, struct file *file)
 	struct ashmem_area *asma = file->private_data;
 	struct ashmem_range *range, *next;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	list_for_each_entry_safe(range, next, &asma->unpinned_list, unpinned)
 		range_del(range);
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
+
+	/* the shrinker may still be punching a range it took off the LRU */
+	wait_event(ashmem_purge_wait, !atomic_read(&asma->purging));
 
 	if (asma->file)
 		fput(asma->file);
@@ -220,7 +360,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* If size is not set, or set to 0, always return EOF. */
 	if (asma->size == 0)
@@ -231,7 +371,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 		goto out_unlock;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	/*
 	 * asma and asma->file are used outside the lock here.  We assume
@@ -247,7 +387,7 @@ static ssize_t ashmem_read(struct file *file, char __user *buf,
 	return ret;
 
 out_unlock:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -256,7 +396,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	struct ashmem_area *asma = file->private_data;
 	int ret;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	if (asma->size == 0) {
 		ret = -EINVAL;
@@ -276,7 +416,7 @@ static loff_t ashmem_llseek(struct file *file, loff_t offset, int origin)
 	file->f_pos = asma->file->f_pos;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -292,7 +432,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	struct ashmem_area *asma = file->private_data;
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* user needs to SET_SIZE before mapping */
 	if (unlikely(!asma->size)) {
@@ -334,7 +474,7 @@ static int ashmem_mmap(struct file *file, struct vm_area_struct *vma)
 	}
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -352,37 +492,71 @@ out:
  * We approximate LRU via least-recently-unpinned, jettisoning unpinned partial
  * chunks of ashmem regions LRU-wise one-at-a-time until we hit 'nr_to_scan'
  * pages freed.
+ *
+ * No lock is held while punching the hole, and areas whose mutex is busy
+ * are skipped, so pin and unpin never wait for a purge of another area.
+ * A pin of the area being purged waits in ashmem_pin_unpin() instead, so
+ * that it cannot hand pages back before the hole has been punched.
  */
 static int ashmem_shrink(struct shrinker *s, struct shrink_control *sc)
 {
-	struct ashmem_range *range, *next;
+	long nr_to_scan = sc->nr_to_scan;
+	LIST_HEAD(busy);
 
 	/* We might recurse into filesystem code, so bail out if necessary */
-	if (sc->nr_to_scan && !(sc->gfp_mask & __GFP_FS))
+	if (nr_to_scan && !(sc->gfp_mask & __GFP_FS))
 		return -1;
-	if (!sc->nr_to_scan)
-		return lru_count;
+	if (!nr_to_scan)
+		return atomic_long_read(&lru_count);
+
+	lru_drain_all();
+
+	spin_lock(&ashmem_lru_lock);
+	while (nr_to_scan > 0 && !list_empty(&ashmem_lru_list)) {
+		struct ashmem_range *range;
+		struct ashmem_area *asma;
+		struct file *file;
+		loff_t start, end;
+
+		range = list_first_entry(&ashmem_lru_list, struct ashmem_range,
+					 lru);
+		asma = range->asma;
+
+		if (!mutex_trylock(&asma->mutex)) {
+			/* still on the global LRU as far as lru_del() cares */
+			list_move_tail(&range->lru, &busy);
+			ashmem_stat_inc(ASHMEM_STAT_SHRINK_BUSY);
+			continue;
+		}
 
-	if (!mutex_trylock(&ashmem_mutex))
-		return -1;
+		start = range->pgstart * PAGE_SIZE;
+		end = (range->pgend + 1) * PAGE_SIZE;
+		range->purged = ASHMEM_WAS_PURGED;
+		list_del(&range->lru);
+		atomic_long_sub(range_size(range), &lru_count);
+		nr_to_scan -= range_size(range);
+		ashmem_stat_add(ASHMEM_STAT_PURGED, range_size(range));
 
-	list_for_each_entry_safe(range, next, &ashmem_lru_list, lru) {
-		loff_t start = range->pgstart * PAGE_SIZE;
-		loff_t end = (range->pgend + 1) * PAGE_SIZE;
+		file = get_file(asma->file);
+		atomic_inc(&asma->purging);
+		mutex_unlock(&asma->mutex);
+		spin_unlock(&ashmem_lru_lock);
 
-		do_fallocate(range->asma->file,
-				FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
-				start, end - start);
-		range->purged = ASHMEM_WAS_PURGED;
-		lru_del(range);
+		do_fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			     start, end - start);
 
-		sc->nr_to_scan -= range_size(range);
-		if (sc->nr_to_scan <= 0)
-			break;
+		/* asma may be freed as soon as purging drops to zero */
+		if (atomic_dec_and_test(&asma->purging))
+			wake_up_all(&ashmem_purge_wait);
+		fput(file);
+
+		spin_lock(&ashmem_lru_lock);
 	}
-	mutex_unlock(&ashmem_mutex);
+	/* busy areas keep their place at the cold end */
+	list_splice(&busy, &ashmem_lru_list);
+	spin_unlock(&ashmem_lru_lock);
 
-	return lru_count;
+	return atomic_long_read(&lru_count);
 }
 
 static struct shrinker ashmem_shrinker = {
@@ -394,7 +568,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 {
 	int ret = 0;
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 
 	/* the user can only remove, not add, protection bits */
 	if (unlikely((asma->prot_mask & prot) != prot)) {
@@ -409,7 +583,7 @@ static int set_prot_mask(struct ashmem_area *asma, unsigned long prot)
 	asma->prot_mask = prot;
 
 out:
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -420,10 +594,10 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 	char local_name[ASHMEM_NAME_LEN];
 
 	/*
-	 * Holding the ashmem_mutex while doing a copy_from_user might cause
+	 * Holding asma->mutex while doing a copy_from_user might cause
 	 * an data abort which would try to access mmap_sem. If another
 	 * thread has invoked ashmem_mmap then it will be holding the
-	 * semaphore and will be waiting for ashmem_mutex, there by leading to
+	 * semaphore and will be waiting for asma->mutex, there by leading to
 	 * deadlock. We'll release the mutex  and take the name to a local
 	 * variable that does not need protection and later copy the local
 	 * variable to the structure member with lock held.
@@ -433,14 +607,14 @@ static int set_name(struct ashmem_area *asma, void __user *name)
 		return len;
 	if (len == ASHMEM_NAME_LEN)
 		local_name[ASHMEM_NAME_LEN - 1] = '\0';
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	/* cannot change an existing mapping's name */
 	if (unlikely(asma->file))
 		ret = -EINVAL;
 	else
 		strcpy(asma->name + ASHMEM_NAME_PREFIX_LEN, local_name);
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 	return ret;
 }
 
@@ -456,7 +630,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 	 */
 	char local_name[ASHMEM_NAME_LEN];
 
-	mutex_lock(&ashmem_mutex);
+	mutex_lock(&asma->mutex);
 	if (asma->name[ASHMEM_NAME_PREFIX_LEN] != '\0') {
 
 		/*
@@ -469,7 +643,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
 		len = sizeof(ASHMEM_NAME_DEF);
 		memcpy(local_name, ASHMEM_NAME_DEF, len);
 	}
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	/*
 	 * Now we are just copying from the stack variable to userland
@@ -484,7 +658,7 @@ static int get_name(struct ashmem_area *asma, void __user *name)
  * ashmem_pin - pin the given ashmem region, returning whether it was
  * previously purged (ASHMEM_WAS_PURGED) or not (ASHMEM_NOT_PURGED).
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -550,7 +724,7 @@ static int ashmem_pin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 /*
  * ashmem_unpin - unpin the given range of pages. Returns zero on success.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_unpin(struct ashmem_area *asma, size_t pgstart, size_t pgend)
 {
@@ -585,7 +759,7 @@ restart:
  * ashmem_get_pin_status - Returns ASHMEM_IS_UNPINNED if _any_ pages in the
  * given interval are unpinned and ASHMEM_IS_PINNED otherwise.
  *
- * Caller must hold ashmem_mutex.
+ * Caller must hold asma->mutex.
  */
 static int ashmem_get_pin_status(struct ashmem_area *asma, size_t pgstart,
 				 size_t pgend)
@@ -634,13 +808,23 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 	pgstart = pin.offset / PAGE_SIZE;
 	pgend = pgstart + (pin.len / PAGE_SIZE) - 1;
 
-	mutex_lock(&ashmem_mutex);
+	ashmem_lock_area(asma);
 
 	switch (cmd) {
 	case ASHMEM_PIN:
+		/* pinned pages must not lose a hole punched after the pin */
+		while (unlikely(atomic_read(&asma->purging))) {
+			mutex_unlock(&asma->mutex);
+			ashmem_stat_inc(ASHMEM_STAT_PURGE_WAIT);
+			wait_event(ashmem_purge_wait,
+				   !atomic_read(&asma->purging));
+			mutex_lock(&asma->mutex);
+		}
+		ashmem_stat_inc(ASHMEM_STAT_PIN);
 		ret = ashmem_pin(asma, pgstart, pgend);
 		break;
 	case ASHMEM_UNPIN:
+		ashmem_stat_inc(ASHMEM_STAT_UNPIN);
 		ret = ashmem_unpin(asma, pgstart, pgend);
 		break;
 	case ASHMEM_GET_PIN_STATUS:
@@ -648,7 +832,7 @@ static int ashmem_pin_unpin(struct ashmem_area *asma, unsigned long cmd,
 		break;
 	}
 
-	mutex_unlock(&ashmem_mutex);
+	mutex_unlock(&asma->mutex);
 
 	return ret;
 }
@@ -667,10 +851,12 @@ static long ashmem_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		break;
 	case ASHMEM_SET_SIZE:
 		ret = -EINVAL;
+		mutex_lock(&asma->mutex);
 		if (!asma->file) {
 			ret = 0;
 			asma->size = (size_t) arg;
 		}
+		mutex_unlock(&asma->mutex);
 		break;
 	case ASHMEM_GET_SIZE:
 		ret = asma->size;
@@ -733,6 +919,37 @@ static const struct file_operations ashmem_fops = {
 #endif
 };
 
+static int ashmem_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned long sum;
+	int i, cpu;
+
+	for (i = 0; i < NR_ASHMEM_STATS; i++) {
+		sum = 0;
+		for_each_possible_cpu(cpu)
+			sum += per_cpu(ashmem_stats, cpu)[i];
+		seq_printf(m, "%-12s %lu\n", ashmem_stat_names[i], sum);
+	}
+	seq_printf(m, "%-12s %ld\n", "lru_pages",
+		   atomic_long_read(&lru_count));
+
+	return 0;
+}
+
+static int ashmem_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ashmem_stats_show, NULL);
+}
+
+static const struct file_operations ashmem_stats_fops = {
+	.open = ashmem_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *ashmem_debugfs_root;
+
 static struct miscdevice ashmem_misc = {
 	.minor = MISC_DYNAMIC_MINOR,
 	.name = "ashmem",
@@ -741,7 +958,14 @@ static struct miscdevice ashmem_misc = {
 
 static int __init ashmem_init(void)
 {
-	int ret;
+	int ret, cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ashmem_lru_batch *batch = &per_cpu(ashmem_lru_batch, cpu);
+
+		spin_lock_init(&batch->lock);
+		INIT_LIST_HEAD(&batch->list);
+	}
 
 	ashmem_area_cachep = kmem_cache_create("ashmem_area_cache",
 					  sizeof(struct ashmem_area),
@@ -767,6 +991,11 @@ static int __init ashmem_init(void)
 
 	register_shrinker(&ashmem_shrinker);
 
+	ashmem_debugfs_root = debugfs_create_dir("ashmem", NULL);
+	if (ashmem_debugfs_root)
+		debugfs_create_file("stats", S_IRUGO, ashmem_debugfs_root,
+				    NULL, &ashmem_stats_fops);
+
 	pr_info("initialized\n");
 
 	return 0;
@@ -776,6 +1005,7 @@ static void __exit ashmem_exit(void)
 {
 	int ret;
 
+	debugfs_remove_recursive(ashmem_debugfs_root);
 	unregister_shrinker(&ashmem_shrinker);
 
 	ret = misc_deregister(&ashmem_misc);
@@ -32,6 +32,7 @@
 #include "trace/sync.h"
 
 static void sync_fence_signal_pt(struct sync_pt *pt);
+static void sync_fence_signal(struct sync_fence *fence, int status);
 static int _sync_pt_has_signaled(struct sync_pt *pt);
 static void sync_fence_free(struct kref *kref);
 static void sync_dump(void);
@@ -141,15 +142,21 @@ void sync_timeline_signal(struct sync_timeline *obj)
 
 	spin_lock_irqsave(&obj->active_list_lock, flags);
 
+	/*
+	 * The active list is kept in signaling order, so the first pt that
+	 * is still active ends the walk: only the pts that fired are looked
+	 * at.  A destroyed timeline errors out every pt.
+	 */
 	list_for_each_safe(pos, n, &obj->active_list_head) {
 		struct sync_pt *pt =
 			container_of(pos, struct sync_pt, active_list);
 
-		if (_sync_pt_has_signaled(pt)) {
-			list_del_init(pos);
-			list_add(&pt->signaled_list, &signaled_pts);
-			kref_get(&pt->fence->kref);
-		}
+		if (!_sync_pt_has_signaled(pt))
+			break;
+
+		list_del_init(pos);
+		list_add_tail(&pt->signaled_list, &signaled_pts);
+		kref_get(&pt->fence->kref);
 	}
 
 	spin_unlock_irqrestore(&obj->active_list_lock, flags);
@@ -219,10 +226,15 @@ static struct sync_pt *sync_pt_dup(struct sync_pt *pt)
 	return pt->parent->ops->dup(pt);
 }
 
-/* Adds a sync pt to the active queue.  Called when added to a fence */
-static void sync_pt_activate(struct sync_pt *pt)
+/*
+ * Adds a sync pt to the active queue, behind every pt that signals no
+ * later than it does.  Called when added to a fence.  Returns the status
+ * of the pt; if it has already signaled the caller must signal its fence.
+ */
+static int sync_pt_activate(struct sync_pt *pt)
 {
 	struct sync_timeline *obj = pt->parent;
+	struct sync_pt *pos;
 	unsigned long flags;
 	int err;
 
@@ -232,10 +244,17 @@ static void sync_pt_activate(struct sync_pt *pt)
 	if (err != 0)
 		goto out;
 
-	list_add_tail(&pt->active_list, &obj->active_list_head);
+	/* new pts normally signal last, so search from the tail */
+	list_for_each_entry_reverse(pos, &obj->active_list_head, active_list) {
+		if (obj->ops->compare(pt, pos) >= 0)
+			break;
+	}
+	list_add(&pt->active_list, &pos->active_list);
 
 out:
 	spin_unlock_irqrestore(&obj->active_list_lock, flags);
+
+	return err;
 }
 
 static int sync_fence_release(struct inode *inode, struct file *file);
@@ -267,6 +286,7 @@ static struct sync_fence *sync_fence_alloc(const char *name)
 
 	kref_init(&fence->kref);
 	strlcpy(fence->name, name, sizeof(fence->name));
+	fence->create_time = ktime_get();
 
 	INIT_LIST_HEAD(&fence->pt_list_head);
 	INIT_LIST_HEAD(&fence->waiter_list_head);
@@ -299,13 +319,12 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt)
 
 	pt->fence = fence;
 	list_add(&pt->pt_list, &fence->pt_list_head);
-	sync_pt_activate(pt);
+	atomic_set(&fence->pending, 1);
+	trace_sync_fence_create(fence);
 
-	/*
-	 * signal the fence in case pt was activated before
-	 * sync_pt_activate(pt) was called
-	 */
-	sync_fence_signal_pt(pt);
+	/* signal the fence in case pt signaled before it was activated */
+	if (sync_pt_activate(pt))
+		sync_fence_signal_pt(pt);
 
 	return fence;
 }
@@ -428,32 +447,12 @@ void sync_fence_install(struct sync_fence *fence, int fd)
 }
 EXPORT_SYMBOL(sync_fence_install);
 
-static int sync_fence_get_status(struct sync_fence *fence)
-{
-	struct list_head *pos;
-	int status = 1;
-
-	list_for_each(pos, &fence->pt_list_head) {
-		struct sync_pt *pt = container_of(pos, struct sync_pt, pt_list);
-		int pt_status = pt->status;
-
-		if (pt_status < 0) {
-			status = pt_status;
-			break;
-		} else if (status == 1) {
-			status = pt_status;
-		}
-	}
-
-	return status;
-}
-
 struct sync_fence *sync_fence_merge(const char *name,
 				    struct sync_fence *a, struct sync_fence *b)
 {
 	struct sync_fence *fence;
-	struct list_head *pos;
-	int err;
+	struct sync_pt *pt;
+	int err, count = 0;
 
 	fence = sync_fence_alloc(name);
 	if (fence == NULL)
@@ -467,20 +466,18 @@ struct sync_fence *sync_fence_merge(const char *name,
 	if (err < 0)
 		goto err;
 
-	list_for_each(pos, &fence->pt_list_head) {
-		struct sync_pt *pt =
-			container_of(pos, struct sync_pt, pt_list);
-		sync_pt_activate(pt);
+	/* every pt must be counted before the first one can signal */
+	list_for_each_entry(pt, &fence->pt_list_head, pt_list)
+		count++;
+	atomic_set(&fence->pending, count);
+	trace_sync_fence_create(fence);
+
+	/* signal the fence for pts that signaled before they were activated */
+	list_for_each_entry(pt, &fence->pt_list_head, pt_list) {
+		if (sync_pt_activate(pt))
+			sync_fence_signal_pt(pt);
 	}
 
-	/*
-	 * signal the fence in case one of it's pts were activated before
-	 * they were activated
-	 */
-	sync_fence_signal_pt(list_first_entry(&fence->pt_list_head,
-					      struct sync_pt,
-					      pt_list));
-
 	return fence;
 err:
 	sync_fence_free_pts(fence);
@@ -489,43 +486,47 @@ err:
 }
 EXPORT_SYMBOL(sync_fence_merge);
 
+/*
+ * Called exactly once for every pt of a fence, by whoever saw the pt
+ * signal.  The fence signals on the first error or once its last pt has
+ * signaled; until then nothing but an atomic counter is touched.
+ */
 static void sync_fence_signal_pt(struct sync_pt *pt)
 {
-	LIST_HEAD(signaled_waiters);
 	struct sync_fence *fence = pt->fence;
-	struct list_head *pos;
-	struct list_head *n;
+	int status = pt->status;
+
+	if (status > 0 && !atomic_dec_and_test(&fence->pending))
+		return;
+
+	sync_fence_signal(fence, status);
+}
+
+static void sync_fence_signal(struct sync_fence *fence, int status)
+{
+	LIST_HEAD(signaled_waiters);
+	struct sync_fence_waiter *waiter, *n;
 	unsigned long flags;
-	int status;
 
-	status = sync_fence_get_status(fence);
+	/* only one caller gets to move the fence out of the active state */
+	if (cmpxchg(&fence->status, 0, status) != 0)
+		return;
+
+	trace_sync_fence_signaled(fence);
 
-	spin_lock_irqsave(&fence->waiter_list_lock, flags);
 	/*
-	 * this should protect against two threads racing on the signaled
-	 * false -> true transition
+	 * sync_fence_wait_async() checks status under the lock, so any
+	 * waiter it did not turn away is on the list by now.
 	 */
-	if (status && !fence->status) {
-		list_for_each_safe(pos, n, &fence->waiter_list_head)
-			list_move(pos, &signaled_waiters);
-
-		fence->status = status;
-	} else {
-		status = 0;
-	}
+	spin_lock_irqsave(&fence->waiter_list_lock, flags);
+	list_splice_init(&fence->waiter_list_head, &signaled_waiters);
 	spin_unlock_irqrestore(&fence->waiter_list_lock, flags);
 
-	if (status) {
-		list_for_each_safe(pos, n, &signaled_waiters) {
-			struct sync_fence_waiter *waiter =
-				container_of(pos, struct sync_fence_waiter,
-					     waiter_list);
-
-			list_del(pos);
-			waiter->callback(fence, waiter);
-		}
-		wake_up(&fence->wq);
+	list_for_each_entry_safe(waiter, n, &signaled_waiters, waiter_list) {
+		list_del(&waiter->waiter_list);
+		waiter->callback(fence, waiter);
 	}
+	wake_up(&fence->wq);
 }
 
 int sync_fence_wait_async(struct sync_fence *fence,
@@ -630,6 +631,130 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 }
 EXPORT_SYMBOL(sync_fence_wait);
 
+struct sync_multi_wait;
+
+struct sync_multi_waiter {
+	struct sync_fence_waiter	waiter;
+	struct sync_multi_wait		*wait;
+	bool				armed;
+};
+
+/*
+ * A waiter callback may still be running after sync_fence_cancel_async()
+ * failed to find it, so each armed waiter holds a reference.
+ */
+struct sync_multi_wait {
+	struct kref			kref;
+	wait_queue_head_t		wq;
+	struct sync_multi_waiter	waiters[0];
+};
+
+static void sync_multi_wait_free(struct kref *kref)
+{
+	kfree(container_of(kref, struct sync_multi_wait, kref));
+}
+
+static void sync_multi_wait_callback(struct sync_fence *fence,
+				     struct sync_fence_waiter *waiter)
+{
+	struct sync_multi_wait *wait =
+		container_of(waiter, struct sync_multi_waiter, waiter)->wait;
+
+	wake_up(&wait->wq);
+	kref_put(&wait->kref, sync_multi_wait_free);
+}
+
+static bool sync_multi_wait_done(struct sync_fence **fences, int count,
+				 bool any, int *index, int *status)
+{
+	bool all = true;
+	int i;
+
+	/* pairs with the status update in sync_fence_signal() */
+	smp_rmb();
+
+	for (i = 0; i < count; i++) {
+		int fence_status = fences[i]->status;
+
+		if (fence_status < 0 || (fence_status > 0 && any)) {
+			*index = i;
+			*status = fence_status;
+			return true;
+		}
+		if (!fence_status)
+			all = false;
+	}
+
+	if (all) {
+		*index = -1;
+		*status = 1;
+	}
+	return all;
+}
+
+int sync_fence_wait_multi(struct sync_fence **fences, int count, bool any,
+			  long timeout, int *index)
+{
+	struct sync_multi_wait *wait;
+	int i, status = 0;
+	long err = 0;
+
+	*index = -1;
+	if (sync_multi_wait_done(fences, count, any, index, &status))
+		goto out;
+	if (!timeout)
+		return -ETIME;
+
+	wait = kzalloc(sizeof(*wait) + count * sizeof(wait->waiters[0]),
+		       GFP_KERNEL);
+	if (wait == NULL)
+		return -ENOMEM;
+
+	kref_init(&wait->kref);
+	init_waitqueue_head(&wait->wq);
+
+	for (i = 0; i < count; i++) {
+		struct sync_multi_waiter *w = &wait->waiters[i];
+
+		w->wait = wait;
+		sync_fence_waiter_init(&w->waiter, sync_multi_wait_callback);
+
+		kref_get(&wait->kref);
+		if (sync_fence_wait_async(fences[i], &w->waiter))
+			kref_put(&wait->kref, sync_multi_wait_free);
+		else
+			w->armed = true;
+	}
+
+	if (timeout > 0)
+		err = wait_event_interruptible_timeout(wait->wq,
+			sync_multi_wait_done(fences, count, any, index,
+					     &status),
+			msecs_to_jiffies(timeout));
+	else
+		err = wait_event_interruptible(wait->wq,
+			sync_multi_wait_done(fences, count, any, index,
+					     &status));
+
+	for (i = 0; i < count; i++) {
+		struct sync_multi_waiter *w = &wait->waiters[i];
+
+		if (w->armed && !sync_fence_cancel_async(fences[i], &w->waiter))
+			kref_put(&wait->kref, sync_multi_wait_free);
+	}
+	kref_put(&wait->kref, sync_multi_wait_free);
+
+	if (err < 0)
+		return err;
+
+	if (!sync_multi_wait_done(fences, count, any, index, &status))
+		return -ETIME;
+
+out:
+	return status < 0 ? status : 0;
+}
+EXPORT_SYMBOL(sync_fence_wait_multi);
+
 static void sync_fence_free(struct kref *kref)
 {
 	struct sync_fence *fence = container_of(kref, struct sync_fence, kref);
@@ -744,6 +869,58 @@ err_put_fd:
 	return err;
 }
 
+static long sync_fence_ioctl_wait_multi(unsigned long arg)
+{
+	struct sync_wait_multi_data __user *udata = (void __user *)arg;
+	struct sync_wait_multi_data data;
+	struct sync_fence **fences;
+	__s32 __user *fds;
+	int index = -1;
+	long err;
+	int n;
+
+	if (copy_from_user(&data, udata, sizeof(data)))
+		return -EFAULT;
+
+	if (!data.count || data.count > SYNC_WAIT_MULTI_MAX ||
+	    (data.flags & ~SYNC_WAIT_ANY))
+		return -EINVAL;
+
+	fences = kcalloc(data.count, sizeof(*fences), GFP_KERNEL);
+	if (fences == NULL)
+		return -ENOMEM;
+
+	fds = (__s32 __user *)(unsigned long)data.fences;
+	for (n = 0; n < data.count; n++) {
+		__s32 fd;
+
+		if (get_user(fd, &fds[n])) {
+			err = -EFAULT;
+			goto out;
+		}
+
+		fences[n] = sync_fence_fdget(fd);
+		if (fences[n] == NULL) {
+			err = -ENOENT;
+			goto out;
+		}
+	}
+
+	err = sync_fence_wait_multi(fences, data.count,
+				    data.flags & SYNC_WAIT_ANY,
+				    data.timeout, &index);
+
+	if (put_user(index, &udata->index))
+		err = -EFAULT;
+
+out:
+	while (n--)
+		sync_fence_put(fences[n]);
+	kfree(fences);
+
+	return err;
+}
+
 static int sync_fill_pt_info(struct sync_pt *pt, void *data, int size)
 {
 	struct sync_pt_info *info = data;
@@ -837,6 +1014,9 @@ static long sync_fence_ioctl(struct file *file, unsigned int cmd,
 	case SYNC_IOC_FENCE_INFO:
 		return sync_fence_ioctl_fence_info(fence, arg);
 
+	case SYNC_IOC_WAIT_MULTI:
+		return sync_fence_ioctl_wait_multi(arg);
+
 	default:
 		return -ENOTTY;
 	}
@@ -39,6 +39,8 @@ struct sync_fence;
  *			  1 if b will signal before a
  *			  0 if a and b will signal at the same time
  *			 -1 if a will signabl before b
+ *			  sync_timeline_signal() relies on pts signaling
+ *			  (or erroring) in this order
  * @free_pt:		called before sync_pt is freed
  * @release_obj:	called before sync_timeline is freed
  * @print_obj:		deprecated
@@ -95,7 +97,8 @@ struct sync_timeline_ops {
  * @child_list_head:	list of children sync_pts for this sync_timeline
  * @child_list_lock:	lock protecting @child_list_head, destroyed, and
  *			  sync_pt.status
- * @active_list_head:	list of active (unsignaled/errored) sync_pts
+ * @active_list_head:	list of active (unsignaled/errored) sync_pts, sorted
+ *			  in the order they will signal
  * @sync_timeline_list:	membership in global sync_timeline_list
  */
 struct sync_timeline {
@@ -151,8 +154,12 @@ struct sync_pt {
  * @pt_list_head:	list of sync_pts in ths fence.  immutable once fence
  *			  is created
  * @waiter_list_head:	list of asynchronous waiters on this fence
- * @waiter_list_lock:	lock protecting @waiter_list_head and @status
- * @status:		1: signaled, 0:active, <0: error
+ * @waiter_list_lock:	lock protecting @waiter_list_head
+ * @status:		1: signaled, 0:active, <0: error.  Leaves 0 exactly
+ *			  once, through cmpxchg()
+ * @pending:		number of sync_pts that have not signaled yet
+ * @create_time:	time the fence was created, for the signal latency
+ *			  tracepoint
  *
  * @wq:			wait queue for fence signaling
  * @sync_fence_list:	membership in global fence list
@@ -166,8 +173,11 @@ struct sync_fence {
 	struct list_head	pt_list_head;
 
 	struct list_head	waiter_list_head;
-	spinlock_t		waiter_list_lock; /* also protects status */
+	spinlock_t		waiter_list_lock;
 	int			status;
+	atomic_t		pending;
+
+	ktime_t			create_time;
 
 	wait_queue_head_t	wq;
 
@@ -342,4 +352,21 @@ int sync_fence_cancel_async(struct sync_fence *fence,
  */
 int sync_fence_wait(struct sync_fence *fence, long timeout);
 
+/**
+ * sync_fence_wait_multi() - wait on several fences at once
+ * @fences:	fences to wait on
+ * @count:	number of fences in @fences
+ * @any:	return as soon as any fence has signaled instead of waiting
+ *		for all of them
+ * @timeout:	timeout in ms
+ * @index:	set to the index of the fence that ended the wait, or -1 if
+ *		all of them had to signal
+ *
+ * Waits until any or all of @fences have signaled, or until one of them
+ * has an error, which is then returned.  Waits indefinitely if
+ * @timeout < 0 and returns -ETIME if it expires.
+ */
+int sync_fence_wait_multi(struct sync_fence **fences, int count, bool any,
+			  long timeout, int *index);
+
 #endif /* _LINUX_SYNC_H */
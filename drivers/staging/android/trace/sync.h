@@ -76,6 +76,52 @@ TRACE_EVENT(sync_pt,
 	TP_printk("name=%s value=%s", __get_str(timeline), __entry->value)
 );
 
+TRACE_EVENT(sync_fence_create,
+	TP_PROTO(struct sync_fence *fence),
+
+	TP_ARGS(fence),
+
+	TP_STRUCT__entry(
+		__string(name, fence->name)
+		__field(void *, fence)
+		__field(s32, pending)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, fence->name);
+		__entry->fence = fence;
+		__entry->pending = atomic_read(&fence->pending);
+	),
+
+	TP_printk("name=%s fence=%p pts=%d", __get_str(name), __entry->fence,
+		  __entry->pending)
+);
+
+TRACE_EVENT(sync_fence_signaled,
+	TP_PROTO(struct sync_fence *fence),
+
+	TP_ARGS(fence),
+
+	TP_STRUCT__entry(
+		__string(name, fence->name)
+		__field(void *, fence)
+		__field(s32, status)
+		__field(s64, latency_ns)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, fence->name);
+		__entry->fence = fence;
+		__entry->status = fence->status;
+		__entry->latency_ns = ktime_to_ns(ktime_sub(ktime_get(),
+							    fence->create_time));
+	),
+
+	TP_printk("name=%s fence=%p status=%d latency=%lldns",
+		  __get_str(name), __entry->fence, __entry->status,
+		  __entry->latency_ns)
+);
+
 #endif /* if !defined(_TRACE_SYNC_H) || defined(TRACE_HEADER_MULTI_READ) */
 
 /* This part must be outside protection */
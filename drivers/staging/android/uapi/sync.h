@@ -62,6 +62,27 @@ struct sync_fence_info_data {
 	__u8	pt_info[0];
 };
 
+/**
+ * struct sync_wait_multi_data - data passed to the batched wait ioctl
+ * @fences:	user pointer to an array of @count fence fds
+ * @count:	number of fds in @fences, at most SYNC_WAIT_MULTI_MAX
+ * @flags:	SYNC_WAIT_ANY to return once any fence has signaled instead
+ *		of waiting for all of them
+ * @timeout:	timeout in milliseconds.  Waits indefinitely if < 0
+ * @index:	returns the index of the fence that ended the wait, or -1
+ *		if all of them had to signal
+ */
+struct sync_wait_multi_data {
+	__u64	fences;
+	__u32	count;
+	__u32	flags;
+	__s32	timeout;
+	__s32	index;
+};
+
+#define SYNC_WAIT_ANY		(1 << 0)
+#define SYNC_WAIT_MULTI_MAX	256
+
 #define SYNC_IOC_MAGIC		'>'
 
 /**
@@ -94,4 +115,15 @@ struct sync_fence_info_data {
 #define SYNC_IOC_FENCE_INFO	_IOWR(SYNC_IOC_MAGIC, 2,\
 	struct sync_fence_info_data)
 
+/**
+ * DOC: SYNC_IOC_WAIT_MULTI - wait on an array of fences
+ *
+ * Takes a struct sync_wait_multi_data and may be issued on any fence fd;
+ * only the fences listed in sync_wait_multi_data.fences are waited on.
+ * Returns 0 once all of them (or with SYNC_WAIT_ANY, any of them) have
+ * signaled, the error of a fence that failed, or -ETIME on timeout.
+ */
+#define SYNC_IOC_WAIT_MULTI	_IOWR(SYNC_IOC_MAGIC, 3,\
+	struct sync_wait_multi_data)
+
 #endif /* _UAPI_LINUX_SYNC_H */
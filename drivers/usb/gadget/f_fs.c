@@ -22,6 +22,11 @@
 #include <linux/pagemap.h>
 #include <linux/export.h>
 #include <linux/hid.h>
+#include <linux/aio.h>
+#include <linux/mmu_context.h>
+#include <linux/uio.h>
+#include <linux/vmalloc.h>
+#include <linux/scatterlist.h>
 #include <asm/unaligned.h>
 
 #include <linux/usb/composite.h>
@@ -739,6 +744,143 @@ static const struct file_operations ffs_ep0_operations = {
 
 /* "Normal" endpoints operations ********************************************/
 
+/*
+ * One read or write on an endpoint file.  Synchronous I/O lives on the
+ * stack of the caller and uses ep->req; every asynchronous one gets its
+ * own request so that many of them can be queued on the endpoint, and
+ * is freed by ffs_user_copy_worker() once the request completes.
+ */
+struct ffs_io_data {
+	bool aio;
+	bool read;
+	bool use_sg;
+
+	struct kiocb *kiocb;
+	const struct iovec *iovec;
+	unsigned long nr_segs;
+	size_t len;
+
+	struct mm_struct *mm;
+	struct work_struct work;
+
+	struct usb_ep *ep;
+	struct usb_request *req;
+
+	/* Bounce buffer, described by sgt if use_sg */
+	char *data;
+	struct sg_table sgt;
+};
+
+/*
+ * Large transfers are bounced through vmalloc()ed memory described by a
+ * scatterlist on UDCs that can do scatter-gather, so they never need a
+ * high order allocation.
+ */
+static void *ffs_build_sg_list(struct sg_table *sgt, size_t sz)
+{
+	unsigned n_pages = PAGE_ALIGN(sz) >> PAGE_SHIFT;
+	struct page **pages;
+	char *vaddr, *ptr;
+	unsigned i;
+
+	vaddr = vmalloc(sz);
+	if (!vaddr)
+		return NULL;
+
+	pages = kmalloc(n_pages * sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		goto err_free;
+
+	for (i = 0, ptr = vaddr; i < n_pages; ++i, ptr += PAGE_SIZE)
+		pages[i] = vmalloc_to_page(ptr);
+
+	if (sg_alloc_table_from_pages(sgt, pages, n_pages, 0, sz, GFP_KERNEL))
+		goto err_free_pages;
+
+	kfree(pages);
+	return vaddr;
+
+err_free_pages:
+	kfree(pages);
+err_free:
+	vfree(vaddr);
+	return NULL;
+}
+
+static char *ffs_alloc_buffer(struct ffs_io_data *io_data)
+{
+	if (io_data->use_sg)
+		return ffs_build_sg_list(&io_data->sgt, io_data->len);
+
+	return kmalloc(io_data->len, GFP_KERNEL);
+}
+
+static void ffs_free_buffer(struct ffs_io_data *io_data)
+{
+	if (!io_data->data)
+		return;
+
+	if (io_data->use_sg) {
+		sg_free_table(&io_data->sgt);
+		vfree(io_data->data);
+	} else {
+		kfree(io_data->data);
+	}
+	io_data->data = NULL;
+}
+
+static void ffs_prep_request(struct ffs_io_data *io_data,
+			     struct usb_request *req)
+{
+	if (io_data->use_sg) {
+		req->buf     = NULL;
+		req->sg      = io_data->sgt.sgl;
+		req->num_sgs = io_data->sgt.nents;
+	} else {
+		req->buf     = io_data->data;
+		req->sg      = NULL;
+		req->num_sgs = 0;
+	}
+	req->length = io_data->len;
+}
+
+static int ffs_copy_from_iovec(struct ffs_io_data *io_data)
+{
+	char *to = io_data->data;
+	unsigned long i;
+
+	for (i = 0; i < io_data->nr_segs; i++) {
+		const struct iovec *iov = &io_data->iovec[i];
+
+		if (unlikely(copy_from_user(to, iov->iov_base, iov->iov_len)))
+			return -EFAULT;
+		to += iov->iov_len;
+	}
+
+	return 0;
+}
+
+static ssize_t ffs_copy_to_iovec(struct ffs_io_data *io_data, size_t total)
+{
+	const char *from = io_data->data;
+	ssize_t copied = 0;
+	unsigned long i;
+
+	for (i = 0; i < io_data->nr_segs && total; i++) {
+		size_t this = min(io_data->iovec[i].iov_len, total);
+
+		if (unlikely(copy_to_user(io_data->iovec[i].iov_base, from,
+					  this)))
+			return copied ? copied : -EFAULT;
+
+		total  -= this;
+		copied += this;
+		from   += this;
+	}
+
+	return copied;
+}
+
 static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 {
 	ENTER();
@@ -749,12 +891,75 @@ static void ffs_epfile_io_complete(struct usb_ep *_ep, struct usb_request *req)
 	}
 }
 
-static ssize_t ffs_epfile_io(struct file *file,
-			     char __user *buf, size_t len, int read)
+static void ffs_user_copy_worker(struct work_struct *work)
+{
+	struct ffs_io_data *io_data = container_of(work, struct ffs_io_data,
+						   work);
+	struct kiocb *kiocb = io_data->kiocb;
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct usb_request *req = io_data->req;
+	ssize_t ret = req->status ? req->status : req->actual;
+
+	if (io_data->read && ret > 0) {
+		use_mm(io_data->mm);
+		ret = ffs_copy_to_iovec(io_data, ret);
+		unuse_mm(io_data->mm);
+	}
+
+	/* Keep ffs_aio_cancel() off the request from now on */
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	kiocb->private = NULL;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	usb_ep_free_request(io_data->ep, req);
+
+	/* completing the iocb can drop the file and mm, don't touch them after */
+	aio_complete(kiocb, ret, ret);
+
+	ffs_free_buffer(io_data);
+	kfree(io_data);
+}
+
+/*
+ * The buffer may have to be vfree()d and read data copied to user space,
+ * neither of which can be done in the completion handler.
+ */
+static void ffs_epfile_async_io_complete(struct usb_ep *_ep,
+					 struct usb_request *req)
+{
+	struct ffs_io_data *io_data = req->context;
+
+	ENTER();
+
+	INIT_WORK(&io_data->work, ffs_user_copy_worker);
+	schedule_work(&io_data->work);
+}
+
+static int ffs_aio_cancel(struct kiocb *kiocb, struct io_event *e)
+{
+	struct ffs_epfile *epfile = kiocb->ki_filp->private_data;
+	struct ffs_io_data *io_data;
+	int value;
+
+	ENTER();
+
+	spin_lock_irq(&epfile->ffs->eps_lock);
+	io_data = kiocb->private;
+	if (likely(io_data && io_data->ep && io_data->req))
+		value = usb_ep_dequeue(io_data->ep, io_data->req);
+	else
+		value = -EINVAL;
+	spin_unlock_irq(&epfile->ffs->eps_lock);
+
+	aio_put_req(kiocb);
+	return value;
+}
+
+static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 {
 	struct ffs_epfile *epfile = file->private_data;
+	struct usb_gadget *gadget;
 	struct ffs_ep *ep;
-	char *data = NULL;
 	ssize_t ret;
 	int halt;
 
@@ -786,22 +991,26 @@ first_try:
 		}
 
 		/* Do we halt? */
-		halt = !read == !epfile->in;
+		halt = !io_data->read == !epfile->in;
 		if (halt && epfile->isoc) {
 			ret = -EINVAL;
 			goto error;
 		}
 
 		/* Allocate & copy */
-		if (!halt && !data) {
-			data = kzalloc(len, GFP_KERNEL);
-			if (unlikely(!data))
+		if (!halt && !io_data->data) {
+			gadget = epfile->ffs->gadget;
+			io_data->use_sg = gadget && gadget->sg_supported &&
+					  io_data->len > PAGE_SIZE;
+
+			io_data->data = ffs_alloc_buffer(io_data);
+			if (unlikely(!io_data->data))
 				return -ENOMEM;
 
-			if (!read &&
-			    unlikely(__copy_from_user(data, buf, len))) {
-				ret = -EFAULT;
-				goto error;
+			if (!io_data->read) {
+				ret = ffs_copy_from_iovec(io_data);
+				if (unlikely(ret))
+					goto error;
 			}
 		}
 
@@ -829,15 +1038,47 @@ first_try:
 			usb_ep_set_halt(ep->ep);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 		ret = -EBADMSG;
+	} else if (io_data->aio) {
+		/* Fire the request and let the worker complete the kiocb */
+		struct usb_request *req;
+
+		req = usb_ep_alloc_request(ep->ep, GFP_ATOMIC);
+		if (unlikely(!req)) {
+			spin_unlock_irq(&epfile->ffs->eps_lock);
+			ret = -ENOMEM;
+			goto error_mutex;
+		}
+
+		ffs_prep_request(io_data, req);
+		req->context  = io_data;
+		req->complete = ffs_epfile_async_io_complete;
+
+		io_data->ep  = ep->ep;
+		io_data->req = req;
+		io_data->mm  = current->mm;
+		io_data->kiocb->private = io_data;
+
+		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
+		if (unlikely(ret)) {
+			io_data->kiocb->private = NULL;
+			spin_unlock_irq(&epfile->ffs->eps_lock);
+			usb_ep_free_request(ep->ep, req);
+			goto error_mutex;
+		}
+		spin_unlock_irq(&epfile->ffs->eps_lock);
+
+		mutex_unlock(&epfile->mutex);
+
+		/* io_data now belongs to ffs_user_copy_worker() */
+		return -EIOCBQUEUED;
 	} else {
 		/* Fire the request */
 		DECLARE_COMPLETION_ONSTACK(done);
 
 		struct usb_request *req = ep->req;
+		ffs_prep_request(io_data, req);
 		req->context  = &done;
 		req->complete = ffs_epfile_io_complete;
-		req->buf      = data;
-		req->length   = len;
 
 		ret = usb_ep_queue(ep->ep, req, GFP_ATOMIC);
 
@@ -850,15 +1091,15 @@ first_try:
 			usb_ep_dequeue(ep->ep, req);
 		} else {
 			ret = ep->status;
-			if (read && ret > 0 &&
-			    unlikely(copy_to_user(buf, data, ret)))
-				ret = -EFAULT;
+			if (io_data->read && ret > 0)
+				ret = ffs_copy_to_iovec(io_data, ret);
 		}
 	}
 
+error_mutex:
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	ffs_free_buffer(io_data);
 	return ret;
 }
 
@@ -866,17 +1107,86 @@ static ssize_t
 ffs_epfile_write(struct file *file, const char __user *buf, size_t len,
 		 loff_t *ptr)
 {
+	struct iovec iov = { .iov_base = (void __user *)buf, .iov_len = len };
+	struct ffs_io_data io_data = {
+		.iovec   = &iov,
+		.nr_segs = 1,
+		.len     = len,
+	};
+
 	ENTER();
 
-	return ffs_epfile_io(file, (char __user *)buf, len, 0);
+	return ffs_epfile_io(file, &io_data);
 }
 
 static ssize_t
 ffs_epfile_read(struct file *file, char __user *buf, size_t len, loff_t *ptr)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+	struct ffs_io_data io_data = {
+		.read    = true,
+		.iovec   = &iov,
+		.nr_segs = 1,
+		.len     = len,
+	};
+
+	ENTER();
+
+	return ffs_epfile_io(file, &io_data);
+}
+
+/*
+ * io_submit() entry points.  Each call queues its own request and returns
+ * straight away, so user space can keep as many transfers in flight on an
+ * endpoint as it has iocbs.  readv() and writev() come here with a sync
+ * kiocb and are simply done synchronously.
+ */
+static ssize_t ffs_epfile_aio_rw(struct kiocb *kiocb, const struct iovec *iov,
+				 unsigned long nr_segs, bool read)
+{
+	struct ffs_io_data io_data_sync, *io_data;
+	ssize_t ret;
+
+	if (is_sync_kiocb(kiocb)) {
+		io_data = &io_data_sync;
+		memset(io_data, 0, sizeof(*io_data));
+	} else {
+		io_data = kzalloc(sizeof(*io_data), GFP_KERNEL);
+		if (unlikely(!io_data))
+			return -ENOMEM;
+		io_data->aio = true;
+		kiocb_set_cancel_fn(kiocb, ffs_aio_cancel);
+	}
+
+	io_data->read    = read;
+	io_data->kiocb   = kiocb;
+	io_data->iovec   = iov;
+	io_data->nr_segs = nr_segs;
+	io_data->len     = iov_length(iov, nr_segs);
+
+	ret = ffs_epfile_io(kiocb->ki_filp, io_data);
+	if (io_data->aio && ret != -EIOCBQUEUED)
+		kfree(io_data);
+
+	return ret;
+}
+
+static ssize_t ffs_epfile_aio_write(struct kiocb *kiocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t loff)
+{
+	ENTER();
+
+	return ffs_epfile_aio_rw(kiocb, iov, nr_segs, false);
+}
+
+static ssize_t ffs_epfile_aio_read(struct kiocb *kiocb,
+				  const struct iovec *iov,
+				  unsigned long nr_segs, loff_t loff)
 {
 	ENTER();
 
-	return ffs_epfile_io(file, buf, len, 1);
+	return ffs_epfile_aio_rw(kiocb, iov, nr_segs, true);
 }
 
 static int
@@ -951,6 +1261,8 @@ static const struct file_operations ffs_epfile_operations = {
 	.open =		ffs_epfile_open,
 	.write =	ffs_epfile_write,
 	.read =		ffs_epfile_read,
+	.aio_write =	ffs_epfile_aio_write,
+	.aio_read =	ffs_epfile_aio_read,
 	.release =	ffs_epfile_release,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
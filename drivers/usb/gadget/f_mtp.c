@@ -31,6 +31,8 @@
 #include <linux/device.h>
 #include <linux/miscdevice.h>
 #include <linux/cpufreq.h>
+#include <linux/pagemap.h>
+#include <linux/scatterlist.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -38,6 +40,7 @@
 #include <linux/usb/f_mtp.h>
 
 #define MTP_BULK_BUFFER_SIZE	   32768
+#define MTP_MAX_BUFFER_SIZE	   (1024 * 1024)
 #define INTR_BUFFER_SIZE           28
 
 /* String IDs */
@@ -57,6 +60,36 @@
 #define RX_REQ_MAX 8
 #define INTR_REQ_MAX 5
 
+/* upper bound of mtp_tx_reqs and mtp_rx_reqs */
+#define MTP_TX_REQ_MAX 32
+#define MTP_RX_REQ_MAX 32
+
+/*
+ * Queue depth and request size for bulk transfers.  When the larger
+ * buffers cannot be allocated we fall back to TX_REQ_MAX/RX_REQ_MAX
+ * requests of MTP_BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_req_len = 65536;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_req_len, "bulk-in request size in bytes");
+
+static unsigned int mtp_rx_req_len = 65536;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_req_len, "bulk-out request size in bytes");
+
+static unsigned int mtp_tx_reqs = 16;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_tx_reqs, "number of bulk-in requests");
+
+static unsigned int mtp_rx_reqs = 16;
+module_param(mtp_rx_reqs, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_rx_reqs, "number of bulk-out requests");
+
+/* send page cache pages as sg lists if the UDC can do so */
+static bool mtp_zero_copy = true;
+module_param(mtp_zero_copy, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(mtp_zero_copy, "send files straight from the page cache");
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -103,9 +136,16 @@ struct mtp_dev {
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
-	struct usb_request *rx_req[RX_REQ_MAX];
+	struct usb_request *rx_req[MTP_RX_REQ_MAX];
+	/* number of completed bulk-out requests */
 	int rx_done;
 
+	/* bulk request sizes and counts actually allocated at bind time */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
+	unsigned tx_reqs;
+	unsigned rx_reqs;
+
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
 	 */
@@ -350,6 +390,17 @@ struct mtp_data_header {
 /* temporary variable used between mtp_open() and mtp_gadget_bind() */
 static struct mtp_dev *_mtp_dev;
 
+/*
+ * Page cache pages referenced by a bulk-in request sent with
+ * send_file_work()'s zero-copy path, dropped again on completion.
+ */
+struct mtp_sg_ctx {
+	int nr_pages;
+	int max_pages;
+	struct page **pages;
+	struct scatterlist *sg;
+};
+
 static inline struct mtp_dev *func_to_mtp(struct usb_function *f)
 {
 	return container_of(f, struct mtp_dev, function);
@@ -367,6 +418,7 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 		usb_ep_free_request(ep, req);
 		return NULL;
 	}
+	req->context = NULL;
 
 	return req;
 }
@@ -374,11 +426,41 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
 	if (req) {
+		kfree(req->context);
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
 }
 
+/* room for the data header and a buffer_size range at any page offset */
+static struct mtp_sg_ctx *mtp_sg_ctx_new(int buffer_size)
+{
+	int max_pages = buffer_size / PAGE_SIZE + 2;
+	struct mtp_sg_ctx *ctx;
+
+	ctx = kzalloc(sizeof(*ctx) + max_pages * sizeof(struct page *) +
+		      (max_pages + 1) * sizeof(struct scatterlist),
+		      GFP_KERNEL);
+	if (!ctx)
+		return NULL;
+
+	ctx->max_pages = max_pages;
+	ctx->pages = (struct page **)(ctx + 1);
+	ctx->sg = (struct scatterlist *)(ctx->pages + max_pages);
+
+	return ctx;
+}
+
+static void mtp_sg_req_release(struct usb_request *req)
+{
+	struct mtp_sg_ctx *ctx = req->context;
+
+	while (ctx->nr_pages)
+		page_cache_release(ctx->pages[--ctx->nr_pages]);
+	req->sg = NULL;
+	req->num_sgs = 0;
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -441,6 +523,9 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	if (req->num_sgs)
+		mtp_sg_req_release(req);
+
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
@@ -450,7 +535,7 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
+	dev->rx_done++;
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
@@ -509,17 +594,45 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_req_len = clamp_t(unsigned, mtp_tx_req_len,
+				  MTP_BULK_BUFFER_SIZE, MTP_MAX_BUFFER_SIZE);
+	dev->tx_reqs = clamp_t(unsigned, mtp_tx_reqs, 1, MTP_TX_REQ_MAX);
+retry_tx_alloc:
+	for (i = 0; i < dev->tx_reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			dev->tx_reqs = TX_REQ_MAX;
+			goto retry_tx_alloc;
+		}
+		/* without a context the request just takes the copy path */
+		if (cdev->gadget->sg_supported)
+			req->context = mtp_sg_ctx_new(dev->tx_req_len);
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+
+	dev->rx_req_len = clamp_t(unsigned, mtp_rx_req_len,
+				  MTP_BULK_BUFFER_SIZE, MTP_MAX_BUFFER_SIZE);
+	dev->rx_reqs = clamp_t(unsigned, mtp_rx_reqs, 2, MTP_RX_REQ_MAX);
+retry_rx_alloc:
+	for (i = 0; i < dev->rx_reqs; i++) {
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len <= MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			dev->rx_reqs = RX_REQ_MAX;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -550,7 +663,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%zu)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -671,8 +784,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -709,6 +822,96 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static bool mtp_can_zero_copy(struct mtp_dev *dev, struct file *filp,
+			      loff_t offset, int64_t count)
+{
+	struct inode *inode = file_inode(filp);
+
+	if (!mtp_zero_copy || !dev->cdev->gadget->sg_supported)
+		return false;
+
+	if (!S_ISREG(inode->i_mode) || !(filp->f_mode & FMODE_READ) ||
+	    (filp->f_flags & O_DIRECT) || !filp->f_mapping->a_ops->readpage)
+		return false;
+
+	/* vfs_read() handles short files */
+	return offset >= 0 && offset + count <= i_size_read(inode);
+}
+
+/*
+ * Get an uptodate page cache page of @filp, reading ahead up to @last
+ * like do_generic_file_read() does.
+ */
+static struct page *mtp_get_file_page(struct file *filp, pgoff_t index,
+				      pgoff_t last)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct page *page;
+
+	page = find_get_page(mapping, index);
+	if (!page) {
+		page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					  index, last + 1 - index);
+		page = find_get_page(mapping, index);
+		if (!page)
+			return read_mapping_page(mapping, index, filp);
+	}
+	if (PageReadahead(page))
+		page_cache_async_readahead(mapping, &filp->f_ra, filp,
+					   page, index, last + 1 - index);
+
+	if (!PageUptodate(page)) {
+		wait_on_page_locked(page);
+		if (!PageUptodate(page)) {
+			/* readahead failed, retry the page on its own */
+			page_cache_release(page);
+			return read_mapping_page(mapping, index, filp);
+		}
+	}
+
+	return page;
+}
+
+/*
+ * Point @req at the page cache pages backing @len bytes of @filp at
+ * @offset, behind the @hdr_size bytes of data header already in req->buf.
+ */
+static int mtp_sg_req_fill(struct usb_request *req, struct file *filp,
+			   loff_t offset, int len, int hdr_size, pgoff_t last)
+{
+	struct mtp_sg_ctx *ctx = req->context;
+	struct scatterlist *sg = ctx->sg;
+	int done = 0;
+
+	sg_init_table(ctx->sg, ctx->max_pages + 1);
+	if (hdr_size)
+		sg_set_buf(sg++, req->buf, hdr_size);
+
+	while (done < len) {
+		pgoff_t index = (offset + done) >> PAGE_CACHE_SHIFT;
+		unsigned poff = (offset + done) & ~PAGE_CACHE_MASK;
+		unsigned plen = min_t(unsigned, PAGE_CACHE_SIZE - poff,
+				      len - done);
+		struct page *page;
+
+		page = mtp_get_file_page(filp, index, last);
+		if (IS_ERR(page)) {
+			mtp_sg_req_release(req);
+			return PTR_ERR(page);
+		}
+
+		ctx->pages[ctx->nr_pages++] = page;
+		sg_set_page(sg++, page, plen, poff);
+		done += plen;
+	}
+	sg_mark_end(sg - 1);
+
+	req->sg = ctx->sg;
+	req->num_sgs = sg - ctx->sg;
+
+	return done;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -723,6 +926,8 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool zero_copy;
+	pgoff_t last;
 
 	/* read our parameters */
 	smp_rmb();
@@ -732,6 +937,9 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	zero_copy = count > 0 && mtp_can_zero_copy(dev, filp, offset, count);
+	last = zero_copy ? (offset + count - 1) >> PAGE_CACHE_SHIFT : 0;
+
 	if (dev->xfer_file_length >= 100 * 1024 * 1024) {
 		pm_qos_update_request(&mtp_cluster0_qos, MTP_CLUSTER0_HIGH_QOS_FREQ);
 		pm_qos_update_request(&mtp_bus_qos, MTP_MEMORY_QOS_FREQ);
@@ -774,8 +982,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -789,8 +997,15 @@ static void send_file_work(struct work_struct *data)
 					__cpu_to_le32(dev->xfer_transaction_id);
 		}
 
-		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
-								&offset);
+		if (zero_copy && req->context && xfer > hdr_size) {
+			ret = mtp_sg_req_fill(req, filp, offset,
+					      xfer - hdr_size, hdr_size, last);
+			if (ret > 0)
+				offset += ret;
+		} else {
+			ret = vfs_read(filp, req->buf + hdr_size,
+				       xfer - hdr_size, &offset);
+		}
 		if (ret < 0) {
 			r = ret;
 			break;
@@ -813,8 +1028,11 @@ static void send_file_work(struct work_struct *data)
 		req = 0;
 	}
 
-	if (req)
+	if (req) {
+		if (req->num_sgs)
+			mtp_sg_req_release(req);
 		mtp_req_put(dev, &dev->tx_idle, req);
+	}
 
 	pm_qos_update_request(&mtp_cluster0_qos, 0);
 	pm_qos_update_request(&mtp_bus_qos, 0);
@@ -832,11 +1050,11 @@ static void receive_file_work(struct work_struct *data)
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req, *write_req = NULL;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, to_queue;
+	int ret, head = 0, tail = 0, depth, inflight = 0, queued = 0, done = 0;
 	int r = 0;
 
 	/* read our parameters */
@@ -857,23 +1075,33 @@ static void receive_file_work(struct work_struct *data)
 		pm_qos_update_request_timeout(&mtp_device_qos, MTP_DEVICE_QOS_FREQ, 1000000);
 	}
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	/* if xfer_file_length is 0xFFFFFFFF, then we read until we get a
+	 * short packet, so we must not queue more than one request ahead.
+	 * One request is always kept back for the write in progress.
+	 */
+	to_queue = count;
+	depth = count == 0xFFFFFFFF ? 1 : dev->rx_reqs - 1;
+	dev->rx_done = 0;
 
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
+	while (to_queue > 0 || inflight || write_req) {
+		/* queue the next reads before writing the last one out */
+		while (to_queue > 0 && inflight < depth) {
+			req = dev->rx_req[head];
+			req->length = (to_queue > dev->rx_req_len
+					? dev->rx_req_len : to_queue);
+			if (count != 0xFFFFFFFF)
+				to_queue -= req->length;
 
-			set_read_req_length(read_req);
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			set_read_req_length(req);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			head = (head + 1) % dev->rx_reqs;
+			inflight++;
+			queued++;
 		}
 
 		if (write_req) {
@@ -884,40 +1112,55 @@ static void receive_file_work(struct work_struct *data)
 			if (ret != write_req->actual) {
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
 			write_req = NULL;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+		if (!inflight)
+			continue;
+
+		/* requests on one endpoint complete in order */
+		req = dev->rx_req[tail];
+		wait_event(dev->read_wq,
+			dev->rx_done > done || dev->state != STATE_BUSY);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto out;
+		}
+		if (dev->state != STATE_BUSY) {
+			r = -EIO;
+			goto out;
+		}
+		tail = (tail + 1) % dev->rx_reqs;
+		inflight--;
+		done++;
+		write_req = req;
+
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
+			DBG(cdev, "got short packet\n");
+			to_queue = 0;
+			while (inflight--) {
+				usb_ep_dequeue(dev->ep_out, dev->rx_req[tail]);
+				tail = (tail + 1) % dev->rx_reqs;
 			}
-
-			write_req = read_req;
-			read_req = NULL;
+			inflight = 0;
 		}
 	}
 
+out:
+	/* drop what the host will never fill, oldest first */
+	while (inflight-- > 0) {
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[tail]);
+		tail = (tail + 1) % dev->rx_reqs;
+	}
+	/* dequeued requests must not complete into the next transfer */
+	wait_event_timeout(dev->read_wq, dev->rx_done >= queued, HZ);
+
 	pm_qos_update_request(&mtp_cluster0_qos, 0);
 	pm_qos_update_request(&mtp_bus_qos, 0);
 	pm_qos_update_request(&mtp_device_qos, 0);
@@ -1245,8 +1488,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < dev->rx_reqs; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
@@ -23,6 +23,7 @@
 #include <linux/poll.h>
 #include <linux/string.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/hash.h>
 #include <linux/spinlock.h>
 #include <linux/syscalls.h>
@@ -52,11 +53,14 @@
  * 3) ep->lock (spinlock)
  *
  * The acquire order is the one listed above, from 1 to 3.
- * We need a spinlock (ep->lock) because we manipulate objects
- * from inside the poll callback, that might be triggered from
- * a wake_up() that in turn might be called from IRQ context.
- * So we can't sleep inside the poll callback and hence we need
- * a spinlock. During the event transfer loop (from kernel to
+ * The poll callback, that might be triggered from a wake_up() that
+ * in turn might be called from IRQ context, does not take any of
+ * them for items without a wakeup source: it pushes the item onto
+ * the lockless "ep->cblist", which is moved to the ready list in a
+ * single batch by whoever next holds "ep->mtx" and "ep->lock".
+ * The ready list itself is protected by a spinlock (ep->lock) that
+ * the callback only takes for EPOLLWAKEUP items, so we can't sleep
+ * while holding it. During the event transfer loop (from kernel to
  * user space) we could end up sleeping due a copy_to_user(), so
  * we need a lock that will allow us to sleep. This lock is a
  * mutex (ep->mtx). It is acquired during the event transfer loop,
@@ -141,10 +145,10 @@ struct epitem {
 	struct list_head rdllink;
 
 	/*
-	 * Works together "struct eventpoll"->ovflist in keeping the
-	 * single linked chain of items.
+	 * Links the item to "struct eventpoll"->cblist. Points to
+	 * EP_UNACTIVE_PTR while the item is not queued there.
 	 */
-	struct epitem *next;
+	struct llist_node cbnode;
 
 	/* The file descriptor information this item refers to */
 	struct epoll_filefd ffd;
@@ -198,11 +202,10 @@ struct eventpoll {
 	struct rb_root rbr;
 
 	/*
-	 * This is a single linked list that chains all the "struct epitem" that
-	 * happened while transferring ready events to userspace w/out
-	 * holding ->lock.
+	 * Lockless list of the "struct epitem" queued by the poll callback,
+	 * moved to the ready list by ep_harvest_cblist().
 	 */
-	struct epitem *ovflist;
+	struct llist_head cblist;
 
 	/* wakeup_source used when ep_scan_ready_list is running */
 	struct wakeup_source *ws;
@@ -372,7 +375,7 @@ static void ep_nested_calls_init(struct nested_calls *ncalls)
  */
 static inline int ep_events_available(struct eventpoll *ep)
 {
-	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
+	return !list_empty(&ep->rdllist) || !llist_empty(&ep->cblist);
 }
 
 /**
@@ -572,6 +575,50 @@ static inline void ep_pm_stay_awake_rcu(struct epitem *epi)
 	rcu_read_unlock();
 }
 
+/*
+ * Queue @epi on "ep->cblist" unless it is already there. The cmpxchg() on
+ * the node claims it, so each item is on the list at most once.
+ */
+static inline void ep_cblist_add(struct eventpoll *ep, struct epitem *epi)
+{
+	if (cmpxchg(&epi->cbnode.next, (struct llist_node *) EP_UNACTIVE_PTR,
+		    NULL) == EP_UNACTIVE_PTR)
+		llist_add(&epi->cbnode, &ep->cblist);
+}
+
+/*
+ * Moves every item queued by the poll callback to the tail of @head, in the
+ * order they were queued, and makes their wakeup sources active. Must be
+ * called with "mtx" and "ep->lock" held.
+ */
+static void ep_harvest_cblist(struct eventpoll *ep, struct list_head *head)
+{
+	struct llist_node *node, *next, *batch = NULL;
+	struct epitem *epi;
+
+	/* The list is LIFO, reverse it while taking it over */
+	node = llist_del_all(&ep->cblist);
+	while (node) {
+		next = node->next;
+		node->next = batch;
+		batch = node;
+		node = next;
+	}
+
+	while (batch) {
+		epi = llist_entry(batch, struct epitem, cbnode);
+		batch = batch->next;
+
+		/* From now on the poll callback may queue the item again */
+		epi->cbnode.next = EP_UNACTIVE_PTR;
+
+		if (!ep_is_linked(&epi->rdllink)) {
+			list_add_tail(&epi->rdllink, head);
+			ep_pm_stay_awake(epi);
+		}
+	}
+}
+
 /**
  * ep_scan_ready_list - Scans the ready list in a way that makes possible for
  *                      the scan code, to call f_op->poll(). Also allows for
@@ -592,7 +639,6 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 {
 	int error, pwake = 0;
 	unsigned long flags;
-	struct epitem *epi, *nepi;
 	LIST_HEAD(txlist);
 
 	/*
@@ -602,16 +648,14 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	mutex_lock_nested(&ep->mtx, depth);
 
 	/*
-	 * Steal the ready list, and re-init the original one to the
-	 * empty list. Also, set ep->ovflist to NULL so that events
-	 * happening while looping w/out locks, are not lost. We cannot
-	 * have the poll callback to queue directly on ep->rdllist,
-	 * because we want the "sproc" callback to be able to do it
-	 * in a lockless way.
+	 * Steal the ready list, together with everything the poll callback
+	 * queued so far, and re-init the original one to the empty list.
+	 * The poll callback never queues directly on ep->rdllist, so the
+	 * "sproc" callback is free to do it in a lockless way.
 	 */
 	spin_lock_irqsave(&ep->lock, flags);
+	ep_harvest_cblist(ep, &ep->rdllist);
 	list_splice_init(&ep->rdllist, &txlist);
-	ep->ovflist = NULL;
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
@@ -623,27 +667,12 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	/*
 	 * During the time we spent inside the "sproc" callback, some
 	 * other events might have been queued by the poll callback.
-	 * We re-insert them inside the main ready-list here.
+	 * Items of EPOLLWAKEUP watches only keep ep->ws active until
+	 * they are harvested, so move them to the ready list before
+	 * relaxing it. Items that are still on "txlist" are skipped
+	 * here, and the list_splice() below takes care of them.
 	 */
-	for (nepi = ep->ovflist; (epi = nepi) != NULL;
-	     nepi = epi->next, epi->next = EP_UNACTIVE_PTR) {
-		/*
-		 * We need to check if the item is already in the list.
-		 * During the "sproc" callback execution time, items are
-		 * queued into ->ovflist but the "txlist" might already
-		 * contain them, and the list_splice() below takes care of them.
-		 */
-		if (!ep_is_linked(&epi->rdllink)) {
-			list_add_tail(&epi->rdllink, &ep->rdllist);
-			ep_pm_stay_awake(epi);
-		}
-	}
-	/*
-	 * We need to set back ep->ovflist to EP_UNACTIVE_PTR, so that after
-	 * releasing the lock, events will be queued in the normal way inside
-	 * ep->rdllist.
-	 */
-	ep->ovflist = EP_UNACTIVE_PTR;
+	ep_harvest_cblist(ep, &ep->rdllist);
 
 	/*
 	 * Quickly re-inject items left on "txlist".
@@ -653,11 +682,12 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 
 	if (!list_empty(&ep->rdllist)) {
 		/*
-		 * Wake up (if active) both the eventpoll wait list and
-		 * the ->poll() wait list (delayed after we release the lock).
+		 * Wake up both the eventpoll wait list and (if active) the
+		 * ->poll() wait list (delayed after we release the lock).
+		 * ep_poll() checks for events under ep->wq.lock, so the
+		 * wake_up() must take it rather than test waitqueue_active().
 		 */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+		wake_up(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -672,13 +702,47 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	return error;
 }
 
+/*
+ * Takes @epi off the ready list, once its poll callbacks are unregistered.
+ * The item cannot be unlinked from the lockless list on its own, so if the
+ * poll callback queued it, the whole list is moved over first. The other
+ * items harvested with it were already announced while ep->cblist held
+ * them, and a waiter may have looked in between, so announce them again,
+ * and hand ep->ws over to them as ep_scan_ready_list() does. Must be called
+ * with "mtx" held.
+ */
+static void ep_unqueue_item(struct eventpoll *ep, struct epitem *epi)
+{
+	unsigned long flags;
+	int pwake = 0;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	if (epi->cbnode.next != EP_UNACTIVE_PTR) {
+		ep_harvest_cblist(ep, &ep->rdllist);
+		__pm_relax(ep->ws);
+		if (ep_is_linked(&epi->rdllink))
+			list_del_init(&epi->rdllink);
+		if (!list_empty(&ep->rdllist)) {
+			wake_up(&ep->wq);
+			if (waitqueue_active(&ep->poll_wait))
+				pwake++;
+		}
+	} else if (ep_is_linked(&epi->rdllink)) {
+		list_del_init(&epi->rdllink);
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	/* We have to call this outside the lock */
+	if (pwake)
+		ep_poll_safewake(&ep->poll_wait);
+}
+
 /*
  * Removes a "struct epitem" from the eventpoll RB tree and deallocates
  * all the associated resources. Must be called with "mtx" held.
  */
 static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 {
-	unsigned long flags;
 	struct file *file = epi->ffd.file;
 
 	/*
@@ -699,10 +763,7 @@ static int ep_remove(struct eventpoll *ep, struct epitem *epi)
 
 	rb_erase(&epi->rbn, &ep->rbr);
 
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unqueue_item(ep, epi);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 
@@ -921,7 +982,7 @@ static int ep_alloc(struct eventpoll **pep)
 	init_waitqueue_head(&ep->poll_wait);
 	INIT_LIST_HEAD(&ep->rdllist);
 	ep->rbr = RB_ROOT;
-	ep->ovflist = EP_UNACTIVE_PTR;
+	init_llist_head(&ep->cblist);
 	ep->user = user;
 
 	*pep = ep;
@@ -969,7 +1030,6 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
@@ -985,8 +1045,6 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 		list_del_init(&wait->task_list);
 	}
 
-	spin_lock_irqsave(&ep->lock, flags);
-
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
 	 * descriptor to be disabled. This condition is likely the effect of the
@@ -994,7 +1052,7 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * until the next EPOLL_CTL_MOD will be issued.
 	 */
 	if (!(epi->event.events & ~EP_PRIVATE_BITS))
-		goto out_unlock;
+		return 1;
 
 	/*
 	 * Check the events coming with the callback. At this stage, not
@@ -1003,50 +1061,34 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	 * test for "key" != NULL before the event match test.
 	 */
 	if (key && !((unsigned long) key & epi->event.events))
-		goto out_unlock;
-
-	/*
-	 * If we are transferring events to userspace, we can hold no locks
-	 * (because we're accessing user memory, and because of linux f_op->poll()
-	 * semantics). All the events that happen during that period of time are
-	 * chained in ep->ovflist and requeued later on.
-	 */
-	if (unlikely(ep->ovflist != EP_UNACTIVE_PTR)) {
-		if (epi->next == EP_UNACTIVE_PTR) {
-			epi->next = ep->ovflist;
-			ep->ovflist = epi;
-			if (epi->ws) {
-				/*
-				 * Activate ep->ws since epi->ws may get
-				 * deactivated at any time.
-				 */
-				__pm_stay_awake(ep->ws);
-			}
-
-		}
-		goto out_unlock;
-	}
+		return 1;
 
-	/* If this file is already in the ready list we exit soon */
-	if (!ep_is_linked(&epi->rdllink)) {
-		list_add_tail(&epi->rdllink, &ep->rdllist);
-		ep_pm_stay_awake_rcu(epi);
+	if (unlikely(ep_has_wakeup_source(epi))) {
+		/*
+		 * Activate ep->ws since epi->ws may get deactivated at any
+		 * time. ep_harvest_cblist() hands it over to epi->ws, and
+		 * ep->lock makes sure that does not happen halfway through.
+		 */
+		spin_lock_irqsave(&ep->lock, flags);
+		ep_cblist_add(ep, epi);
+		__pm_stay_awake(ep->ws);
+		spin_unlock_irqrestore(&ep->lock, flags);
+	} else {
+		ep_cblist_add(ep, epi);
 	}
 
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
-	 * wait list.
+	 * wait list. The lockless waitqueue_active() test is safe here only
+	 * because llist_add() is a cmpxchg(), which is fully ordered: the
+	 * item is visible on ep->cblist before we look at ep->wq, and
+	 * ep_poll() adds itself to ep->wq before it checks
+	 * ep_events_available(). If the item was already queued, whoever
+	 * queued it did the same check after its own llist_add().
 	 */
 	if (waitqueue_active(&ep->wq))
-		wake_up_locked(&ep->wq);
+		wake_up(&ep->wq);
 	if (waitqueue_active(&ep->poll_wait))
-		pwake++;
-
-out_unlock:
-	spin_unlock_irqrestore(&ep->lock, flags);
-
-	/* We have to call this outside the lock */
-	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
 	return 1;
@@ -1252,7 +1294,7 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 	ep_set_ffd(&epi->ffd, tfile, fd);
 	epi->event = *event;
 	epi->nwait = 0;
-	epi->next = EP_UNACTIVE_PTR;
+	epi->cbnode.next = EP_UNACTIVE_PTR;
 	if (epi->event.events & EPOLLWAKEUP) {
 		error = ep_create_wakeup_source(epi);
 		if (error)
@@ -1307,9 +1349,12 @@ static int ep_insert(struct eventpoll *ep, struct epoll_event *event,
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 		ep_pm_stay_awake(epi);
 
-		/* Notify waiting tasks that events are available */
-		if (waitqueue_active(&ep->wq))
-			wake_up_locked(&ep->wq);
+		/*
+		 * Notify waiting tasks that events are available. ep_poll()
+		 * checks for events under ep->wq.lock, not ep->lock, so take
+		 * that lock rather than test waitqueue_active() unordered.
+		 */
+		wake_up(&ep->wq);
 		if (waitqueue_active(&ep->poll_wait))
 			pwake++;
 	}
@@ -1337,14 +1382,9 @@ error_unregister:
 
 	/*
 	 * We need to do this because an event could have been arrived on some
-	 * allocated wait queue. Note that we don't care about the ep->ovflist
-	 * list, since that is used/cleaned only inside a section bound by "mtx".
-	 * And ep_insert() is called with "mtx" held.
+	 * allocated wait queue, which queued the item on ep->cblist.
 	 */
-	spin_lock_irqsave(&ep->lock, flags);
-	if (ep_is_linked(&epi->rdllink))
-		list_del_init(&epi->rdllink);
-	spin_unlock_irqrestore(&ep->lock, flags);
+	ep_unqueue_item(ep, epi);
 
 	wakeup_source_unregister(ep_wakeup_source(epi));
 
@@ -1386,9 +1426,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 	 * 1) Flush epi changes above to other CPUs.  This ensures
 	 *    we do not miss events from ep_poll_callback if an
 	 *    event occurs immediately after we call f_op->poll().
-	 *    We need this because we did not take ep->lock while
-	 *    changing epi above (but ep_poll_callback does take
-	 *    ep->lock).
+	 *    We need this because ep_poll_callback reads the event
+	 *    mask without taking any lock.
 	 *
 	 * 2) We also need to ensure we do not miss _past_ events
 	 *    when calling f_op->poll().  This barrier also
@@ -1416,9 +1455,8 @@ static int ep_modify(struct eventpoll *ep, struct epitem *epi, struct epoll_even
 			list_add_tail(&epi->rdllink, &ep->rdllist);
 			ep_pm_stay_awake(epi);
 
-			/* Notify waiting tasks that events are available */
-			if (waitqueue_active(&ep->wq))
-				wake_up_locked(&ep->wq);
+			/* Notify waiting tasks, see ep_insert() */
+			wake_up(&ep->wq);
 			if (waitqueue_active(&ep->poll_wait))
 				pwake++;
 		}
@@ -1501,7 +1539,7 @@ static int ep_send_events_proc(struct eventpoll *ep, struct list_head *head,
 				 * into ep->rdllist besides us. The epoll_ctl()
 				 * callers are locked out by
 				 * ep_scan_ready_list() holding "mtx" and the
-				 * poll callback will queue them in ep->ovflist.
+				 * poll callback will queue them in ep->cblist.
 				 */
 				list_add_tail(&epi->rdllink, &ep->rdllist);
 				ep_pm_stay_awake(epi);
@@ -1572,18 +1610,20 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 		 * caller specified a non blocking operation.
 		 */
 		timed_out = 1;
-		spin_lock_irqsave(&ep->lock, flags);
+		spin_lock_irqsave(&ep->wq.lock, flags);
 		goto check_events;
 	}
 
 fetch_events:
-	spin_lock_irqsave(&ep->lock, flags);
+	spin_lock_irqsave(&ep->wq.lock, flags);
 
 	if (!ep_events_available(ep)) {
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
 		 * ep_poll_callback() when events will become available.
+		 * The poll callback does not take ep->lock, so the wait
+		 * queue is protected by its own lock.
 		 */
 		init_waitqueue_entry(&wait, current);
 		__add_wait_queue_exclusive(&ep->wq, &wait);
@@ -1602,12 +1642,12 @@ fetch_events:
 				break;
 			}
 
-			spin_unlock_irqrestore(&ep->lock, flags);
+			spin_unlock_irqrestore(&ep->wq.lock, flags);
 			if (!freezable_schedule_hrtimeout_range(to, slack,
 								HRTIMER_MODE_ABS))
 				timed_out = 1;
 
-			spin_lock_irqsave(&ep->lock, flags);
+			spin_lock_irqsave(&ep->wq.lock, flags);
 		}
 		__remove_wait_queue(&ep->wq, &wait);
 
@@ -1617,7 +1657,7 @@ check_events:
 	/* Is it worth to try to dig for events ? */
 	eavail = ep_events_available(ep);
 
-	spin_unlock_irqrestore(&ep->lock, flags);
+	spin_unlock_irqrestore(&ep->wq.lock, flags);
 
 	/*
 	 * Try to transfer events to user space. In case we get 0 events and
@@ -698,22 +698,35 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and keep the group on the matching sbi->s_mb_largest_free_orders
+ * list. Called with the group lock held.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	int i;
-	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
 
-	bits = sb->s_blocksize_bits + 1;
-	for (i = bits; i >= 0; i--) {
-		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+	for (i = MB_NUM_ORDERS(sb) - 1; i >= 0; i--)
+		if (grp->bb_counters[i] > 0)
 			break;
-		}
+
+	if (i == grp->bb_largest_free_order)
+		return;
+
+	if (grp->bb_largest_free_order >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[
+					      grp->bb_largest_free_order]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[
+					      grp->bb_largest_free_order]);
+	}
+	grp->bb_largest_free_order = i;
+	if (i >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[i]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[i]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[i]);
 	}
 }
 
@@ -2035,11 +2048,173 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Start reading the block bitmaps of up to @nr groups from @group on, for
+ * the groups whose buddy still has to be built, without waiting for them.
+ * Each group is read ahead at most once. Returns the group to continue
+ * from and adds the number of reads issued to *cnt.
+ */
+ext4_group_t ext4_mb_prefetch(struct super_block *sb, ext4_group_t group,
+			      unsigned int nr, int *cnt)
+{
+	ext4_group_t ngroups = ext4_get_groups_count(sb);
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_desc *gdp;
+	struct ext4_group_info *grp;
+	struct buffer_head *bh;
+	struct blk_plug plug;
+
+	blk_start_plug(&plug);
+	while (nr-- > 0) {
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		grp = ext4_get_group_info(sb, group);
+
+		/*
+		 * Groups marked uninitialized on disk don't need any
+		 * I/O to build their bitmap, so leave them alone.
+		 */
+		if (gdp && EXT4_MB_GRP_NEED_INIT(grp) &&
+		    ext4_free_group_clusters(sb, gdp) > 0 &&
+		    !(ext4_has_group_desc_csum(sb) &&
+		      (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT))) &&
+		    !EXT4_MB_GRP_TEST_AND_SET_READ(grp)) {
+			bh = ext4_read_block_bitmap_nowait(sb, group);
+			if (bh) {
+				if (!buffer_uptodate(bh) && cnt)
+					(*cnt)++;
+				if (sbi->s_mb_stats)
+					atomic_inc(&sbi->s_bal_prefetched);
+				brelse(bh);
+			}
+		}
+		if (++group >= ngroups)
+			group = 0;
+	}
+	blk_finish_plug(&plug);
+	return group;
+}
+
+/*
+ * Build the buddies of the @nr groups before @group, whose bitmaps were
+ * read ahead by ext4_mb_prefetch(), so that they show up on the per-order
+ * lists before the allocator needs them.
+ */
+void ext4_mb_prefetch_fini(struct super_block *sb, ext4_group_t group,
+			   unsigned int nr)
+{
+	struct ext4_group_desc *gdp;
+	struct ext4_group_info *grp;
+
+	while (nr-- > 0) {
+		if (!group)
+			group = ext4_get_groups_count(sb);
+		group--;
+		gdp = ext4_get_group_desc(sb, group, NULL);
+		grp = ext4_get_group_info(sb, group);
+
+		if (gdp && EXT4_MB_GRP_NEED_INIT(grp) &&
+		    ext4_free_group_clusters(sb, gdp) > 0) {
+			if (ext4_mb_init_group(sb, group))
+				break;
+		}
+	}
+}
+
+/*
+ * Collect up to MB_ORDER_LIST_BATCH initialized groups other than the goal
+ * whose largest free extent is big enough for the request, starting from the
+ * smallest such order so that large extents are kept for large requests.
+ * Each list is rotated past the groups taken from it, so that concurrent
+ * allocators don't all pile onto the groups at its head.
+ */
+static int ext4_mb_pick_groups(struct ext4_allocation_context *ac, int cr,
+			       ext4_group_t *groups)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_info *grp, *last;
+	struct list_head *head;
+	int order, nr = 0;
+
+	if (cr == 0)
+		order = ac->ac_2order;
+	else
+		order = fls(ac->ac_g_ex.fe_len) - 1;
+
+	for (; order < MB_NUM_ORDERS(sb) && nr < MB_ORDER_LIST_BATCH; order++) {
+		head = &sbi->s_mb_largest_free_orders[order];
+		if (list_empty(head))
+			continue;
+
+		last = NULL;
+		write_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+		list_for_each_entry(grp, head, bb_largest_free_order_node) {
+			if (EXT4_MB_GRP_NEED_INIT(grp) ||
+			    grp->bb_free < ac->ac_g_ex.fe_len ||
+			    grp->bb_group == ac->ac_g_ex.fe_group)
+				continue;
+			groups[nr++] = grp->bb_group;
+			last = grp;
+			if (nr == MB_ORDER_LIST_BATCH)
+				break;
+		}
+		if (last)
+			list_move(head, &last->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+	}
+
+	return nr;
+}
+
+static noinline_for_stack int
+ext4_mb_scan_group(struct ext4_allocation_context *ac, ext4_group_t group,
+		   int cr)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_buddy e4b;
+	int err;
+
+	/* This now checks without needing the buddy page */
+	if (!ext4_mb_good_group(ac, group, cr))
+		return 0;
+
+	err = ext4_mb_load_buddy(sb, group, &e4b);
+	if (err)
+		return err;
+
+	ext4_lock_group(sb, group);
+
+	/*
+	 * We need to check again after locking the
+	 * block group
+	 */
+	if (!ext4_mb_good_group(ac, group, cr)) {
+		ext4_unlock_group(sb, group);
+		ext4_mb_unload_buddy(&e4b);
+		return 0;
+	}
+
+	ac->ac_groups_scanned++;
+	if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
+		ext4_mb_simple_scan_group(ac, &e4b);
+	else if (cr == 1 && sbi->s_stripe &&
+			!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+		ext4_mb_scan_aligned(ac, &e4b);
+	else
+		ext4_mb_complex_scan_group(ac, &e4b);
+
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(&e4b);
+	return 0;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
-	ext4_group_t ngroups, group, i;
-	int cr;
+	ext4_group_t ngroups, group, i, prefetch_grp;
+	ext4_group_t groups[MB_ORDER_LIST_BATCH];
+	int cr, nr, prefetch_ios = 0;
 	int err = 0;
 	struct ext4_sb_info *sbi;
 	struct super_block *sb;
@@ -2100,13 +2275,51 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
 		ac->ac_criteria = cr;
+
 		/*
 		 * searching for the right group start
 		 * from the goal value specified
 		 */
 		group = ac->ac_g_ex.fe_group;
+		prefetch_grp = group;
+		i = 0;
 
-		for (i = 0; i < ngroups; group++, i++) {
+		/*
+		 * Groups with a free extent of the right order are kept on
+		 * per-order lists: after the goal group, try a few of them
+		 * before the linear scan, which only has to find what isn't
+		 * initialized yet.
+		 */
+		if (cr < 2 && sbi->s_mb_optimize_scan &&
+		    ext4_test_inode_flag(ac->ac_inode, EXT4_INODE_EXTENTS)) {
+			err = ext4_mb_scan_group(ac, group, cr);
+			if (err)
+				goto out;
+			if (ac->ac_status != AC_STATUS_CONTINUE)
+				break;
+
+			nr = ext4_mb_pick_groups(ac, cr, groups);
+			for (i = 0; i < nr; i++) {
+				if (sbi->s_mb_stats)
+					atomic_inc(&sbi->s_bal_list_picks);
+				err = ext4_mb_scan_group(ac, groups[i], cr);
+				if (err)
+					goto out;
+				if (ac->ac_status != AC_STATUS_CONTINUE)
+					break;
+			}
+			if (ac->ac_status != AC_STATUS_CONTINUE) {
+				if (sbi->s_mb_stats)
+					atomic_inc(&sbi->s_bal_list_hits);
+				break;
+			}
+
+			/* the goal group has been scanned already */
+			prefetch_grp = ++group;
+			i = 1;
+		}
+
+		for (; i < ngroups; group++, i++) {
 			/*
 			 * Artificially restricted ngroups for non-extent
 			 * files makes group > ngroups possible on first loop.
@@ -2114,37 +2327,20 @@ repeat:
 			if (group >= ngroups)
 				group = 0;
 
-			/* This now checks without needing the buddy page */
-			if (!ext4_mb_good_group(ac, group, cr))
-				continue;
-
-			err = ext4_mb_load_buddy(sb, group, &e4b);
-			if (err)
-				goto out;
-
-			ext4_lock_group(sb, group);
-
 			/*
-			 * We need to check again after locking the
-			 * block group
+			 * Read the block bitmaps of the following groups
+			 * ahead, so that building their buddies below
+			 * doesn't wait on each read in turn.
 			 */
-			if (!ext4_mb_good_group(ac, group, cr)) {
-				ext4_unlock_group(sb, group);
-				ext4_mb_unload_buddy(&e4b);
-				continue;
-			}
-
-			ac->ac_groups_scanned++;
-			if (cr == 0 && ac->ac_2order < sb->s_blocksize_bits+2)
-				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
-				ext4_mb_scan_aligned(ac, &e4b);
-			else
-				ext4_mb_complex_scan_group(ac, &e4b);
+			if (prefetch_grp == group && sbi->s_mb_prefetch &&
+			    prefetch_ios < sbi->s_mb_prefetch_limit)
+				prefetch_grp = ext4_mb_prefetch(sb, group,
+						sbi->s_mb_prefetch,
+						&prefetch_ios);
 
-			ext4_unlock_group(sb, group);
-			ext4_mb_unload_buddy(&e4b);
+			err = ext4_mb_scan_group(ac, group, cr);
+			if (err)
+				goto out;
 
 			if (ac->ac_status != AC_STATUS_CONTINUE)
 				break;
@@ -2177,6 +2373,8 @@ repeat:
 		}
 	}
 out:
+	if (sbi->s_mb_stats)
+		atomic_add(ac->ac_groups_scanned, &sbi->s_bal_groups_scanned);
 	return err;
 }
 
@@ -2286,6 +2484,59 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+static int ext4_mb_seq_stats_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	seq_puts(seq, "mballoc:\n");
+	if (!sbi->s_mb_stats) {
+		seq_puts(seq, "\tmb stats collection turned off.\n");
+		seq_puts(seq, "\tTo enable, please write \"1\" to sysfs file mb_stats.\n");
+		return 0;
+	}
+	seq_printf(seq, "\treqs: %u\n", atomic_read(&sbi->s_bal_reqs));
+	seq_printf(seq, "\tsuccess: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "\tallocated: %u\n",
+		   atomic_read(&sbi->s_bal_allocated));
+	seq_printf(seq, "\tgroups_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_groups_scanned));
+	seq_printf(seq, "\torder_list_picks: %u\n",
+		   atomic_read(&sbi->s_bal_list_picks));
+	seq_printf(seq, "\torder_list_hits: %u\n",
+		   atomic_read(&sbi->s_bal_list_hits));
+	seq_printf(seq, "\textents_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_ex_scanned));
+	seq_printf(seq, "\tgoal_hits: %u\n", atomic_read(&sbi->s_bal_goals));
+	seq_printf(seq, "\t2^n_hits: %u\n", atomic_read(&sbi->s_bal_2orders));
+	seq_printf(seq, "\tbreaks: %u\n", atomic_read(&sbi->s_bal_breaks));
+	seq_printf(seq, "\tlost: %u\n", atomic_read(&sbi->s_mb_lost_chunks));
+	seq_printf(seq, "\tbuddies_generated: %lu\n",
+		   sbi->s_mb_buddies_generated);
+	seq_printf(seq, "\tbuddies_time_used: %llu\n",
+		   sbi->s_mb_generation_time);
+	seq_printf(seq, "\tbitmaps_prefetched: %u\n",
+		   atomic_read(&sbi->s_bal_prefetched));
+	seq_printf(seq, "\tpreallocated: %u\n",
+		   atomic_read(&sbi->s_mb_preallocated));
+	seq_printf(seq, "\tdiscarded: %u\n",
+		   atomic_read(&sbi->s_mb_discarded));
+	return 0;
+}
+
+static int ext4_mb_seq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_stats_show, PDE_DATA(inode));
+}
+
+static const struct file_operations ext4_mb_seq_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2381,9 +2632,11 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2533,6 +2786,23 @@ int ext4_mb_init(struct super_block *sb)
 		goto out;
 	}
 
+	i = MB_NUM_ORDERS(sb) * sizeof(struct list_head);
+	sbi->s_mb_largest_free_orders = kmalloc(i, GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	i = MB_NUM_ORDERS(sb) * sizeof(rwlock_t);
+	sbi->s_mb_largest_free_orders_locks = kmalloc(i, GFP_KERNEL);
+	if (!sbi->s_mb_largest_free_orders_locks) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
 	ret = ext4_groupinfo_create_slab(sb->s_blocksize);
 	if (ret < 0)
 		goto out;
@@ -2560,6 +2830,9 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
+	sbi->s_mb_prefetch = MB_DEFAULT_PREFETCH;
+	sbi->s_mb_prefetch_limit = MB_DEFAULT_PREFETCH_LIMIT;
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2606,9 +2879,12 @@ int ext4_mb_init(struct super_block *sb)
 	if (ret != 0)
 		goto out_free_locality_groups;
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("mb_stats", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_stats_fops, sb);
+	}
 
 	return 0;
 
@@ -2618,6 +2894,10 @@ out_free_locality_groups:
 out_free_groupinfo_slab:
 	ext4_groupinfo_destroy_slabs();
 out:
+	kfree(sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = NULL;
+	kfree(sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = NULL;
 	kfree(sbi->s_mb_offsets);
 	sbi->s_mb_offsets = NULL;
 	kfree(sbi->s_mb_maxs);
@@ -2652,8 +2932,10 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
+		remove_proc_entry("mb_stats", sbi->s_proc);
 		remove_proc_entry("mb_groups", sbi->s_proc);
+	}
 
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
@@ -2673,6 +2955,8 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		ext4_kvfree(sbi->s_group_info);
 	}
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	if (sbi->s_buddy_cache)
@@ -89,6 +89,26 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * pick groups from the per-order lists of their largest free extent
+ * before scanning the groups one by one
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/*
+ * number of groups picked from the per-order lists in one go
+ */
+#define MB_ORDER_LIST_BATCH		8
+
+/*
+ * number of groups whose block bitmaps are read ahead together,
+ * and the max. number of reads one allocation may issue that way
+ */
+#define MB_DEFAULT_PREFETCH		32
+#define MB_DEFAULT_PREFETCH_LIMIT	(4 * MB_DEFAULT_PREFETCH)
+
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
 
 struct ext4_free_data {
 	/* MUST be the first member */
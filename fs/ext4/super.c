@@ -1131,7 +1131,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
-	Opt_max_dir_size_kb,
+	Opt_max_dir_size_kb, Opt_no_prefetch_block_bitmaps,
 };
 
 static const match_table_t tokens = {
@@ -1206,6 +1206,7 @@ static const match_table_t tokens = {
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
 	{Opt_max_dir_size_kb, "max_dir_size_kb=%u"},
+	{Opt_no_prefetch_block_bitmaps, "no_prefetch_block_bitmaps"},
 	{Opt_removed, "check=none"},	/* mount option from ext2/3 */
 	{Opt_removed, "nocheck"},	/* mount option from ext2/3 */
 	{Opt_removed, "reservation"},	/* mount option from ext2/3 */
@@ -1362,6 +1363,8 @@ static const struct mount_opts {
 	{Opt_noauto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_SET},
 	{Opt_auto_da_alloc, EXT4_MOUNT_NO_AUTO_DA_ALLOC, MOPT_CLEAR},
 	{Opt_noinit_itable, EXT4_MOUNT_INIT_INODE_TABLE, MOPT_CLEAR},
+	{Opt_no_prefetch_block_bitmaps, EXT4_MOUNT_NO_PREFETCH_BLOCK_BITMAPS,
+	 MOPT_SET},
 	{Opt_commit, 0, MOPT_GTE0},
 	{Opt_max_batch_time, 0, MOPT_GTE0},
 	{Opt_min_batch_time, 0, MOPT_GTE0},
@@ -2525,6 +2528,9 @@ EXT4_RW_ATTR_SBI_UI(mb_min_to_scan, s_mb_min_to_scan);
 EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
+EXT4_RW_ATTR_SBI_UI(mb_optimize_scan, s_mb_optimize_scan);
+EXT4_RW_ATTR_SBI_UI(mb_prefetch, s_mb_prefetch);
+EXT4_RW_ATTR_SBI_UI(mb_prefetch_limit, s_mb_prefetch_limit);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 EXT4_RW_ATTR_SBI_UI(extent_max_zeroout_kb, s_extent_max_zeroout_kb);
 EXT4_ATTR(trigger_fs_error, 0200, NULL, trigger_test_error);
@@ -2542,6 +2548,9 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_order2_req),
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
+	ATTR_LIST(mb_optimize_scan),
+	ATTR_LIST(mb_prefetch),
+	ATTR_LIST(mb_prefetch_limit),
 	ATTR_LIST(max_writeback_mb_bump),
 	ATTR_LIST(extent_max_zeroout_kb),
 	ATTR_LIST(trigger_fs_error),
@@ -2718,6 +2727,48 @@ static void print_daily_error_info(unsigned long arg)
 	mod_timer(&sbi->s_err_report, jiffies + 24*60*60*HZ);  /* Once a day */
 }
 
+/*
+ * Prefetch the next batch of block bitmaps and build their buddies. Once
+ * every group has been visited, switch the request over to inode table
+ * initialization, or report it done if there is nothing left to zero.
+ */
+static int ext4_run_li_prefetch(struct ext4_li_request *elr)
+{
+	struct super_block *sb = elr->lr_super;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t group = elr->lr_next_group;
+	ext4_group_t ngroups = sbi->s_groups_count;
+	unsigned int nr = sbi->s_mb_prefetch;
+	unsigned long timeout = jiffies;
+	int ios = 0;
+
+	if (!nr)
+		nr = 1;
+	if (nr > ngroups - group)
+		nr = ngroups - group;
+
+	elr->lr_next_group = ext4_mb_prefetch(sb, group, nr, &ios);
+	ext4_mb_prefetch_fini(sb, elr->lr_next_group, nr);
+
+	if (elr->lr_next_group > group) {
+		/* Back off in proportion to the time spent waiting on reads */
+		timeout = ios ? (jiffies - timeout) * sbi->s_li_wait_mult : 0;
+		elr->lr_next_sched = jiffies + timeout;
+		return 0;
+	}
+
+	if (elr->lr_first_not_zeroed == ngroups ||
+	    (sb->s_flags & MS_RDONLY) ||
+	    !test_opt(sb, INIT_INODE_TABLE))
+		return 1;
+
+	elr->lr_mode = EXT4_LI_MODE_ITABLE;
+	elr->lr_next_group = elr->lr_first_not_zeroed;
+	elr->lr_timeout = 0;
+	elr->lr_next_sched = jiffies;
+	return 0;
+}
+
 /* Find next suitable group and run ext4_init_inode_table */
 static int ext4_run_li_request(struct ext4_li_request *elr)
 {
@@ -2727,6 +2778,9 @@ static int ext4_run_li_request(struct ext4_li_request *elr)
 	unsigned long timeout = 0;
 	int ret = 0;
 
+	if (elr->lr_mode == EXT4_LI_MODE_PREFETCH_BBITMAP)
+		return ext4_run_li_prefetch(elr);
+
 	sb = elr->lr_super;
 	ngroups = EXT4_SB(sb)->s_groups_count;
 
@@ -2968,7 +3022,14 @@ static struct ext4_li_request *ext4_li_request_new(struct super_block *sb,
 
 	elr->lr_super = sb;
 	elr->lr_sbi = sbi;
-	elr->lr_next_group = start;
+	elr->lr_first_not_zeroed = start;
+	if (test_opt(sb, NO_PREFETCH_BLOCK_BITMAPS)) {
+		elr->lr_mode = EXT4_LI_MODE_ITABLE;
+		elr->lr_next_group = start;
+	} else {
+		elr->lr_mode = EXT4_LI_MODE_PREFETCH_BBITMAP;
+		elr->lr_next_group = 0;
+	}
 
 	/*
 	 * Randomize first schedule time of the request to
@@ -3000,9 +3061,14 @@ int ext4_register_li_request(struct super_block *sb,
 		goto out;
 	}
 
-	if (first_not_zeroed == ngroups ||
-	    (sb->s_flags & MS_RDONLY) ||
-	    !test_opt(sb, INIT_INODE_TABLE))
+	/*
+	 * Without block bitmap prefetching there is only work to do if
+	 * some inode tables still have to be zeroed.
+	 */
+	if ((sb->s_flags & MS_RDONLY) ||
+	    (test_opt(sb, NO_PREFETCH_BLOCK_BITMAPS) &&
+	     (first_not_zeroed == ngroups ||
+	      !test_opt(sb, INIT_INODE_TABLE))))
 		goto out;
 
 	elr = ext4_li_request_new(sb, first_not_zeroed);
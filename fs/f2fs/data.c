@@ -493,6 +493,7 @@ struct page *get_read_data_page(struct inode *inode, pgoff_t index,
 	err = get_dnode_of_data(&dn, index, LOOKUP_NODE);
 	if (err)
 		goto put_err;
+	f2fs_update_extent_cache_dnode(&dn);
 	f2fs_put_dnode(&dn);
 
 	if (unlikely(dn.data_blkaddr == NULL_ADDR)) {
@@ -778,6 +779,9 @@ next_dnode:
 		goto unlock_out;
 	}
 
+	if (!create)
+		f2fs_update_extent_cache_dnode(&dn);
+
 	prealloc = 0;
 	last_ofs_in_node = ofs_in_node = dn.ofs_in_node;
 	end_offset = ADDRS_PER_PAGE(dn.node_page, inode);
@@ -38,6 +38,7 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->hit_rbtree = atomic64_read(&sbi->read_hit_rbtree);
 	si->hit_total = si->hit_largest + si->hit_cached + si->hit_rbtree;
 	si->total_ext = atomic64_read(&sbi->total_hit_ext);
+	si->read_fill_ext = atomic64_read(&sbi->read_fill_ext);
 	si->ext_tree = atomic_read(&sbi->total_ext_tree);
 	si->zombie_tree = atomic_read(&sbi->total_zombie_tree);
 	si->ext_node = atomic_read(&sbi->total_ext_node);
@@ -57,6 +58,16 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->overp_segs = overprovision_segments(sbi);
 	si->valid_count = valid_user_blocks(sbi);
 	si->discard_blks = discard_blocks(sbi);
+	if (SM_I(sbi)->dcc_info) {
+		struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+		si->nr_discard_cmds = dcc->nr_cmds;
+		si->pending_discard_blks = dcc->pending_blks;
+		si->issued_discard_cmds = dcc->issued_cmds;
+		si->issued_discard_blks = dcc->issued_blks;
+		si->merged_discard_cmds = dcc->merged_cmds;
+		si->punched_discard_blks = dcc->punched_blks;
+	}
 	si->valid_node_count = valid_node_count(sbi);
 	si->valid_inode_count = valid_inode_count(sbi);
 	si->inline_xattr = atomic_read(&sbi->inline_xattr);
@@ -179,6 +190,9 @@ static void update_mem_info(struct f2fs_sb_info *sbi)
 	si->base_mem += sizeof(struct dirty_seglist_info);
 	si->base_mem += NR_DIRTY_TYPE * f2fs_bitmap_size(MAIN_SEGS(sbi));
 	si->base_mem += f2fs_bitmap_size(MAIN_SECS(sbi));
+	si->base_mem += MAIN_SECS(sbi) * sizeof(struct victim_entry);
+	si->base_mem += DIRTY_I(sbi)->vindex.nr_buckets *
+						sizeof(struct list_head);
 
 	/* build nm */
 	si->base_mem += sizeof(struct f2fs_nm_info);
@@ -195,6 +209,13 @@ get_cache:
 	if (SM_I(sbi)->cmd_control_info)
 		si->cache_mem += sizeof(struct flush_cmd_control);
 
+	/* build discard thread */
+	if (SM_I(sbi)->dcc_info) {
+		si->cache_mem += sizeof(struct discard_cmd_control);
+		si->cache_mem += SM_I(sbi)->dcc_info->nr_cmds *
+					sizeof(struct discard_cmd);
+	}
+
 	/* free nids */
 	si->cache_mem += (NM_I(sbi)->nid_cnt[FREE_NID_LIST] +
 				NM_I(sbi)->nid_cnt[ALLOC_NID_LIST]) *
@@ -299,6 +320,11 @@ static int stat_show(struct seq_file *s, void *v)
 				si->data_segs, si->bg_data_segs);
 		seq_printf(s, "  - node segments : %d (%d)\n",
 				si->node_segs, si->bg_node_segs);
+		seq_printf(s, "  - time per section : %llu us (BG: %llu us)\n",
+				!si->gc_secs[FG_GC] ? 0 :
+				div64_u64(si->gc_time[FG_GC], si->gc_secs[FG_GC]),
+				!si->gc_secs[BG_GC] ? 0 :
+				div64_u64(si->gc_time[BG_GC], si->gc_secs[BG_GC]));
 		seq_printf(s, "Try to move %d blocks (BG: %d)\n", si->tot_blks,
 				si->bg_data_blks + si->bg_node_blks);
 		seq_printf(s, "  - data blocks : %d (%d)\n", si->data_blks,
@@ -313,8 +339,19 @@ static int stat_show(struct seq_file *s, void *v)
 				!si->total_ext ? 0 :
 				div64_u64(si->hit_total * 100, si->total_ext),
 				si->hit_total, si->total_ext);
+		seq_printf(s, "  - Miss Count: %llu (filled by reads: %llu)\n",
+				si->total_ext - si->hit_total,
+				si->read_fill_ext);
 		seq_printf(s, "  - Inner Struct Count: tree: %d(%d), node: %d\n",
 				si->ext_tree, si->zombie_tree, si->ext_node);
+		seq_puts(s, "\nDiscard:\n");
+		seq_printf(s, "  - pending: %u cmds, %u blocks\n",
+				si->nr_discard_cmds, si->pending_discard_blks);
+		seq_printf(s, "  - issued: %llu cmds, %llu blocks\n",
+				si->issued_discard_cmds, si->issued_discard_blks);
+		seq_printf(s, "  - merged: %llu cmds, punched: %llu blocks\n",
+				si->merged_discard_cmds,
+				si->punched_discard_blks);
 		seq_puts(s, "\nBalancing F2FS Async:\n");
 		seq_printf(s, "  - inmem: %4d, wb_cp_data: %4d, wb_data: %4d\n",
 			   si->inmem_pages, si->nr_wb_cp_data, si->nr_wb_data);
@@ -410,6 +447,7 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 	atomic64_set(&sbi->read_hit_rbtree, 0);
 	atomic64_set(&sbi->read_hit_largest, 0);
 	atomic64_set(&sbi->read_hit_cached, 0);
+	atomic64_set(&sbi->read_fill_ext, 0);
 
 	atomic_set(&sbi->inline_xattr, 0);
 	atomic_set(&sbi->inline_inode, 0);
@@ -539,6 +539,47 @@ static unsigned int f2fs_update_extent_tree_range(struct inode *inode,
 	return !__is_extent_same(&prev, &et->largest);
 }
 
+/*
+ * Cache [fofs, fofs + len), which a read found mapped to blkaddr in the
+ * dnode it walked, around @pgofs that missed. Parts already cached are
+ * left alone, so this never splits an extent and can't trip FI_NO_EXTENT.
+ */
+static void f2fs_fill_extent_tree(struct inode *inode, pgoff_t pgofs,
+			pgoff_t fofs, block_t blkaddr, unsigned int len)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct extent_tree *et = F2FS_I(inode)->extent_tree;
+	struct extent_node *en, *prev_en = NULL, *next_en = NULL;
+	struct rb_node **insert_p = NULL, *insert_parent = NULL;
+	unsigned int start = fofs, end = fofs + len;
+	struct extent_info ei;
+
+	if (!et)
+		return;
+
+	write_lock(&et->lock);
+
+	if (is_inode_flag_set(inode, FI_NO_EXTENT))
+		goto out;
+
+	en = __lookup_extent_tree_ret(et, pgofs, &prev_en, &next_en,
+					&insert_p, &insert_parent);
+	if (en)
+		goto out;
+
+	if (prev_en && prev_en->ei.fofs + prev_en->ei.len > start)
+		start = prev_en->ei.fofs + prev_en->ei.len;
+	if (next_en && next_en->ei.fofs < end)
+		end = next_en->ei.fofs;
+
+	set_extent_info(&ei, start, blkaddr + start - fofs, end - start);
+	if (!__try_merge_extent_node(inode, et, &ei, prev_en, next_en))
+		__insert_extent_tree(inode, et, &ei, insert_p, insert_parent);
+	stat_inc_read_fill_ext(sbi);
+out:
+	write_unlock(&et->lock);
+}
+
 unsigned int f2fs_shrink_extent_tree(struct f2fs_sb_info *sbi, int nr_shrink)
 {
 	struct extent_tree *et, *next;
@@ -705,6 +746,41 @@ void f2fs_update_extent_cache(struct dnode_of_data *dn)
 	f2fs_update_extent_tree_range(dn->inode, fofs, blkaddr, 1);
 }
 
+/*
+ * A lookup missed the extent cache and walked to this dnode: cache the run
+ * of contiguous blocks in it around dn->ofs_in_node, so that the following
+ * random reads of the file find it without the node page. Caller should
+ * hold the locked node page, which orders this against block updates.
+ */
+void f2fs_update_extent_cache_dnode(struct dnode_of_data *dn)
+{
+	struct inode *inode = dn->inode;
+	block_t blkaddr = dn->data_blkaddr;
+	unsigned int ofs = dn->ofs_in_node;
+	unsigned int start, end, max_ofs;
+	pgoff_t fofs;
+
+	if (!f2fs_may_extent_tree(inode) ||
+			blkaddr == NEW_ADDR || blkaddr == NULL_ADDR)
+		return;
+
+	if (!available_free_memory(F2FS_I_SB(inode), EXTENT_CACHE))
+		return;
+
+	max_ofs = ADDRS_PER_PAGE(dn->node_page, inode);
+	for (start = ofs; start > 0; start--)
+		if (datablock_addr(dn->node_page, start - 1) !=
+						blkaddr - (ofs - start + 1))
+			break;
+	for (end = ofs + 1; end < max_ofs; end++)
+		if (datablock_addr(dn->node_page, end) != blkaddr + end - ofs)
+			break;
+
+	fofs = start_bidx_of_node(ofs_of_node(dn->node_page), inode);
+	f2fs_fill_extent_tree(inode, fofs + ofs, fofs + start,
+				blkaddr - (ofs - start), end - start);
+}
+
 void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 				pgoff_t fofs, block_t blkaddr, unsigned int len)
 
@@ -672,6 +672,37 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+/* for the discard commands pending on the idle-time issue thread */
+#define DEF_MAX_DISCARD_REQUEST		8	/* discards issued per round */
+#define DEF_URGENT_DISCARD_RATIO	5	/* 5% of main area pending */
+#define DEF_MIN_DISCARD_ISSUE_TIME	50	/* 50 ms, while pending */
+#define DEF_MAX_DISCARD_ISSUE_TIME	60000	/* 60 s, if nothing pending */
+
+struct discard_cmd {
+	struct rb_node rb_node;		/* rb node located in rb-tree */
+	block_t lstart;			/* start blkaddr of the discard */
+	block_t len;			/* # of consecutive blocks */
+};
+
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	wait_queue_head_t discard_done_queue;	/* waiters on the issuing range */
+	struct mutex issue_lock;		/* serialize discard issuers */
+	spinlock_t cmd_lock;			/* protect the tree and counters */
+	struct rb_root root;			/* pending discards, by lstart */
+	block_t issue_start;			/* range being issued now */
+	block_t issue_len;
+	unsigned int nr_cmds;			/* # of pending discards */
+	block_t pending_blks;			/* # of blocks pending discard */
+	block_t urgent_blks;			/* issue even if not idle */
+	unsigned int max_discard_request;	/* max. discards per round */
+	unsigned long long issued_cmds;		/* # of issued discards */
+	unsigned long long issued_blks;		/* # of issued blocks */
+	unsigned long long merged_cmds;		/* # of merged discards */
+	unsigned long long punched_blks;	/* # of blocks reused before issue */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -707,6 +738,9 @@ struct f2fs_sm_info {
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
 
+	/* for discard command control */
+	struct discard_cmd_control *dcc_info;
+
 };
 
 /*
@@ -939,6 +973,7 @@ struct f2fs_sb_info {
 	atomic64_t read_hit_rbtree;		/* # of hit rbtree extent node */
 	atomic64_t read_hit_largest;		/* # of hit largest extent node */
 	atomic64_t read_hit_cached;		/* # of hit cached extent node */
+	atomic64_t read_fill_ext;		/* # of extents cached by reads */
 	atomic_t inline_xattr;			/* # of inline_xattr inodes */
 	atomic_t inline_inode;			/* # of inline_data inodes */
 	atomic_t inline_dir;			/* # of inline_dentry inodes */
@@ -2180,6 +2215,8 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 int f2fs_issue_flush(struct f2fs_sb_info *);
 int create_flush_cmd_control(struct f2fs_sb_info *);
 void destroy_flush_cmd_control(struct f2fs_sb_info *, bool);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *, bool);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 bool is_checkpointed_data(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
@@ -2296,7 +2333,7 @@ struct f2fs_stat_info {
 	int all_area_segs, sit_area_segs, nat_area_segs, ssa_area_segs;
 	int main_area_segs, main_area_sections, main_area_zones;
 	unsigned long long hit_largest, hit_cached, hit_rbtree;
-	unsigned long long hit_total, total_ext;
+	unsigned long long hit_total, total_ext, read_fill_ext;
 	int ext_tree, zombie_tree, ext_node;
 	int ndirty_node, ndirty_dent, ndirty_meta, ndirty_data, ndirty_imeta;
 	int inmem_pages;
@@ -2322,6 +2359,11 @@ struct f2fs_stat_info {
 	unsigned int segment_count[2];
 	unsigned int block_count[2];
 	unsigned int inplace_count;
+	unsigned long long gc_secs[2];		/* victim sections, by gc_type */
+	unsigned long long gc_time[2];		/* usecs spent on them */
+	unsigned int nr_discard_cmds, pending_discard_blks;
+	unsigned long long issued_discard_cmds, issued_discard_blks;
+	unsigned long long merged_discard_cmds, punched_discard_blks;
 	unsigned long long base_mem, cache_mem, page_mem;
 };
 
@@ -2340,6 +2382,7 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 #define stat_inc_rbtree_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_rbtree))
 #define stat_inc_largest_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_largest))
 #define stat_inc_cached_node_hit(sbi)	(atomic64_inc(&(sbi)->read_hit_cached))
+#define stat_inc_read_fill_ext(sbi)	(atomic64_inc(&(sbi)->read_fill_ext))
 #define stat_inc_inline_xattr(inode)					\
 	do {								\
 		if (f2fs_has_inline_xattr(inode))			\
@@ -2389,6 +2432,13 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		}							\
 	} while (0)
 
+#define stat_add_gc_time(sbi, gc_type, us)				\
+	do {								\
+		struct f2fs_stat_info *si = F2FS_STAT(sbi);		\
+		si->gc_secs[gc_type]++;					\
+		si->gc_time[gc_type] += (us);				\
+	} while (0)
+
 #define stat_inc_tot_blk_count(si, blks)				\
 	(si->tot_blks += (blks))
 
@@ -2423,6 +2473,7 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_rbtree_node_hit(sb)
 #define stat_inc_largest_node_hit(sbi)
 #define stat_inc_cached_node_hit(sbi)
+#define stat_inc_read_fill_ext(sbi)
 #define stat_inc_inline_xattr(inode)
 #define stat_dec_inline_xattr(inode)
 #define stat_inc_inline_inode(inode)
@@ -2433,6 +2484,7 @@ void f2fs_destroy_root_stats(void);
 #define stat_inc_block_count(sbi, curseg)
 #define stat_inc_inplace_blocks(sbi)
 #define stat_inc_seg_count(sbi, type, gc_type)
+#define stat_add_gc_time(sbi, gc_type, us)
 #define stat_inc_tot_blk_count(si, blks)
 #define stat_inc_data_blk_count(sbi, blks, gc_type)
 #define stat_inc_node_blk_count(sbi, blks, gc_type)
@@ -2498,6 +2550,7 @@ unsigned int f2fs_destroy_extent_node(struct inode *);
 void f2fs_destroy_extent_tree(struct inode *);
 bool f2fs_lookup_extent_cache(struct inode *, pgoff_t, struct extent_info *);
 void f2fs_update_extent_cache(struct dnode_of_data *);
+void f2fs_update_extent_cache_dnode(struct dnode_of_data *);
 void f2fs_update_extent_cache_range(struct dnode_of_data *dn,
 						pgoff_t, block_t, unsigned int);
 void init_extent_cache_info(struct f2fs_sb_info *);
@@ -262,6 +262,65 @@ static unsigned int count_bits(const unsigned long *addr,
 	return sum;
 }
 
+/*
+ * Pick an LFS victim from the victim index rather than scanning dirty_segmap.
+ * Buckets are visited from the fewest valid blocks upwards. Greedy stops at
+ * the first usable bucket. Cost-benefit costs up to CB_BUCKET_SEARCH usable
+ * sections of each bucket, since an old section with more valid blocks may
+ * still beat a young one with fewer. Bucket order follows the last valid
+ * block change rather than section age, so the bucket is rotated past the
+ * sections it costed and the next round samples different ones.
+ */
+static void get_victim_from_index(struct f2fs_sb_info *sbi,
+			struct victim_sel_policy *p, int gc_type)
+{
+	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
+	struct victim_index *vi = &dirty_i->vindex;
+	unsigned int nsearched = 0;
+	unsigned int bucket, ncosted;
+
+	spin_lock(&vi->lock);
+	for (bucket = 0; bucket < vi->nr_buckets; bucket++) {
+		struct victim_entry *ve;
+
+		ncosted = 0;
+
+		list_for_each_entry(ve, &vi->buckets[bucket], list) {
+			unsigned int secno = ve - vi->entries;
+			unsigned int segno = secno * sbi->segs_per_sec;
+			unsigned long cost;
+
+			if (sec_usage_check(sbi, secno))
+				continue;
+			if (gc_type == BG_GC &&
+					test_bit(secno, dirty_i->victim_secmap))
+				continue;
+
+			cost = get_gc_cost(sbi, segno, p);
+			if (p->min_cost > cost) {
+				p->min_segno = segno;
+				p->min_cost = cost;
+			}
+
+			if (++nsearched >= p->max_search)
+				goto out;
+			/* greedy costs are equal in exact buckets */
+			if (p->gc_mode == GC_GREEDY && !vi->bucket_shift)
+				break;
+			if (p->gc_mode == GC_CB &&
+					++ncosted >= CB_BUCKET_SEARCH) {
+				list_move(&vi->buckets[bucket], &ve->list);
+				break;
+			}
+		}
+
+		if (p->gc_mode == GC_GREEDY && p->min_segno != NULL_SEGNO)
+			break;
+	}
+out:
+	spin_unlock(&vi->lock);
+}
+
 /*
  * This function is called from two paths.
  * One is garbage collection and the other is SSR segment selection.
@@ -297,6 +356,11 @@ static int get_victim_by_default(struct f2fs_sb_info *sbi,
 			goto got_it;
 	}
 
+	if (p.alloc_mode == LFS) {
+		get_victim_from_index(sbi, &p, gc_type);
+		goto done;
+	}
+
 	while (1) {
 		unsigned long cost;
 		unsigned int segno;
@@ -345,6 +409,7 @@ next:
 			break;
 		}
 	}
+done:
 	if (p.min_segno != NULL_SEGNO) {
 got_it:
 		if (p.alloc_mode == LFS) {
@@ -837,6 +902,7 @@ static int do_garbage_collect(struct f2fs_sb_info *sbi,
 	struct blk_plug plug;
 	unsigned int segno = start_segno;
 	unsigned int end_segno = start_segno + sbi->segs_per_sec;
+	ktime_t start_time = ktime_get();
 	int sec_freed = 0;
 	unsigned char type = IS_DATASEG(get_seg_entry(sbi, segno)->type) ?
 						SUM_TYPE_DATA : SUM_TYPE_NODE;
@@ -899,6 +965,7 @@ next:
 		sec_freed = 1;
 
 	stat_inc_call_count(sbi->stat_info);
+	stat_add_gc_time(sbi, gc_type, ktime_us_delta(ktime_get(), start_time));
 
 	return sec_freed;
 }
@@ -22,6 +22,9 @@
 /* Search max. number of dirty segments to select a victim segment */
 #define DEF_MAX_VICTIM_SEARCH 4096 /* covers 8GB */
 
+/* Sections costed per victim index bucket by cost-benefit GC */
+#define CB_BUCKET_SEARCH	16
+
 struct f2fs_gc_kthread {
 	struct task_struct *f2fs_gc_task;
 	wait_queue_head_t gc_wait_queue_head;
@@ -16,6 +16,8 @@
 #include <linux/kthread.h>
 #include <linux/swap.h>
 #include <linux/timer.h>
+#include <linux/freezer.h>
+#include <linux/delay.h>
 
 #include "f2fs.h"
 #include "segment.h"
@@ -26,6 +28,7 @@
 #define __reverse_ffz(x) __reverse_ffs(~(x))
 
 static struct kmem_cache *discard_entry_slab;
+static struct kmem_cache *discard_cmd_slab;
 static struct kmem_cache *sit_entry_set_slab;
 static struct kmem_cache *inmem_entry_slab;
 
@@ -603,6 +606,62 @@ void destroy_flush_cmd_control(struct f2fs_sb_info *sbi, bool free)
 	}
 }
 
+static inline unsigned int __victim_bucket(struct f2fs_sb_info *sbi,
+						unsigned int segno)
+{
+	return get_valid_blocks(sbi, segno, sbi->segs_per_sec) >>
+					DIRTY_I(sbi)->vindex.bucket_shift;
+}
+
+static void __victim_index_add(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+	struct victim_entry *ve = &vi->entries[GET_SECNO(sbi, segno)];
+
+	spin_lock(&vi->lock);
+	if (!ve->dirty_segs++) {
+		ve->bucket = __victim_bucket(sbi, segno);
+		list_add_tail(&ve->list, &vi->buckets[ve->bucket]);
+		vi->nr_entries++;
+	}
+	spin_unlock(&vi->lock);
+}
+
+static void __victim_index_del(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+	struct victim_entry *ve = &vi->entries[GET_SECNO(sbi, segno)];
+
+	spin_lock(&vi->lock);
+	f2fs_bug_on(sbi, !ve->dirty_segs);
+	if (!--ve->dirty_segs) {
+		list_del_init(&ve->list);
+		vi->nr_entries--;
+	}
+	spin_unlock(&vi->lock);
+}
+
+/*
+ * Move an indexed section to the bucket matching its current valid blocks.
+ * Called whenever the valid block count of a segment changes.
+ */
+static void update_victim_index(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+	struct victim_entry *ve = &vi->entries[GET_SECNO(sbi, segno)];
+	unsigned int bucket;
+
+	spin_lock(&vi->lock);
+	if (ve->dirty_segs) {
+		bucket = __victim_bucket(sbi, segno);
+		if (bucket != ve->bucket) {
+			list_move_tail(&ve->list, &vi->buckets[bucket]);
+			ve->bucket = bucket;
+		}
+	}
+	spin_unlock(&vi->lock);
+}
+
 static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 		enum dirty_type dirty_type)
 {
@@ -612,8 +671,11 @@ static void __locate_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 	if (IS_CURSEG(sbi, segno))
 		return;
 
-	if (!test_and_set_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+	if (!test_and_set_bit(segno, dirty_i->dirty_segmap[dirty_type])) {
 		dirty_i->nr_dirty[dirty_type]++;
+		if (dirty_type == DIRTY)
+			__victim_index_add(sbi, segno);
+	}
 
 	if (dirty_type == DIRTY) {
 		struct seg_entry *sentry = get_seg_entry(sbi, segno);
@@ -633,8 +695,11 @@ static void __remove_dirty_segment(struct f2fs_sb_info *sbi, unsigned int segno,
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
 
-	if (test_and_clear_bit(segno, dirty_i->dirty_segmap[dirty_type]))
+	if (test_and_clear_bit(segno, dirty_i->dirty_segmap[dirty_type])) {
 		dirty_i->nr_dirty[dirty_type]--;
+		if (dirty_type == DIRTY)
+			__victim_index_del(sbi, segno);
+	}
 
 	if (dirty_type == DIRTY) {
 		struct seg_entry *sentry = get_seg_entry(sbi, segno);
@@ -740,34 +805,420 @@ static int __issue_discard_async(struct f2fs_sb_info *sbi,
 	return blkdev_issue_discard(bdev, start, len, GFP_NOFS, 0);
 }
 
-static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
+static int __issue_discard_range(struct f2fs_sb_info *sbi,
 				block_t blkstart, block_t blklen)
 {
 	sector_t start = blkstart, len = 0;
 	struct block_device *bdev;
-	struct seg_entry *se;
-	unsigned int offset;
 	block_t i;
-	int err = 0;
+	int err;
 
 	bdev = f2fs_target_device(sbi, blkstart, NULL);
 
 	for (i = blkstart; i < blkstart + blklen; i++, len++) {
-		if (i != start) {
-			struct block_device *bdev2 =
-				f2fs_target_device(sbi, i, NULL);
-
-			if (bdev2 != bdev) {
-				err = __issue_discard_async(sbi, bdev,
-						start, len);
-				if (err)
-					return err;
-				bdev = bdev2;
-				start = i;
-				len = 0;
+		struct block_device *bdev2;
+
+		if (i == start)
+			continue;
+
+		bdev2 = f2fs_target_device(sbi, i, NULL);
+		if (bdev2 != bdev) {
+			err = __issue_discard_async(sbi, bdev, start, len);
+			if (err)
+				return err;
+			bdev = bdev2;
+			start = i;
+			len = 0;
+		}
+	}
+
+	return __issue_discard_async(sbi, bdev, start, len);
+}
+
+static void __remove_discard_cmd(struct discard_cmd_control *dcc,
+						struct discard_cmd *dc)
+{
+	rb_erase(&dc->rb_node, &dcc->root);
+	dcc->nr_cmds--;
+	kmem_cache_free(discard_cmd_slab, dc);
+}
+
+static void __link_discard_cmd(struct discard_cmd_control *dcc,
+						struct discard_cmd *new)
+{
+	struct rb_node **p = &dcc->root.rb_node;
+	struct rb_node *parent = NULL;
+	struct discard_cmd *dc;
+
+	while (*p) {
+		parent = *p;
+		dc = rb_entry(parent, struct discard_cmd, rb_node);
+		if (new->lstart < dc->lstart)
+			p = &(*p)->rb_left;
+		else
+			p = &(*p)->rb_right;
+	}
+	rb_link_node(&new->rb_node, parent, p);
+	rb_insert_color(&new->rb_node, &dcc->root);
+	dcc->nr_cmds++;
+}
+
+/*
+ * Queue [lstart, lstart + len) to the discard thread, merging it with the
+ * pending discards it overlaps or touches, so that deleting a large file
+ * ends up as a few large discards instead of one per segment.
+ */
+static void __queue_discard_cmd(struct f2fs_sb_info *sbi,
+				block_t lstart, block_t len)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_cmd *new, *dc, *prev = NULL;
+	struct rb_node *node = dcc->root.rb_node;
+	block_t end = lstart + len;
+	bool was_empty;
+
+	new = f2fs_kmem_cache_alloc(discard_cmd_slab, GFP_NOFS);
+
+	spin_lock(&dcc->cmd_lock);
+	was_empty = !dcc->nr_cmds;
+
+	/* find the last pending discard starting at or before lstart */
+	while (node) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (lstart < dc->lstart) {
+			node = node->rb_left;
+		} else {
+			prev = dc;
+			node = node->rb_right;
+		}
+	}
+
+	if (prev && prev->lstart + prev->len >= lstart) {
+		dcc->pending_blks -= prev->len;
+		prev->len = max(end, prev->lstart + prev->len) - prev->lstart;
+		dcc->pending_blks += prev->len;
+		dcc->merged_cmds++;
+		kmem_cache_free(discard_cmd_slab, new);
+	} else {
+		new->lstart = lstart;
+		new->len = len;
+		__link_discard_cmd(dcc, new);
+		dcc->pending_blks += len;
+		prev = new;
+	}
+
+	/* absorb the following discards that the new range reaches */
+	while ((node = rb_next(&prev->rb_node))) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (dc->lstart > prev->lstart + prev->len)
+			break;
+
+		dcc->pending_blks -= prev->len + dc->len;
+		prev->len = max(prev->lstart + prev->len,
+				dc->lstart + dc->len) - prev->lstart;
+		dcc->pending_blks += prev->len;
+		dcc->merged_cmds++;
+		__remove_discard_cmd(dcc, dc);
+	}
+
+	spin_unlock(&dcc->cmd_lock);
+
+	/*
+	 * An idle thread sleeps for DEF_MAX_DISCARD_ISSUE_TIME, so tell it
+	 * about the first discard as well as about an urgent backlog.
+	 */
+	if (was_empty || dcc->pending_blks >= dcc->urgent_blks)
+		wake_up(&dcc->discard_wait_queue);
+}
+
+/*
+ * Issue up to @nr pending discards from the lowest address, each one
+ * limited to a section, so that a writer waiting on the range in flight
+ * is not held up by a huge merged discard.
+ */
+static void __issue_discard_cmds(struct f2fs_sb_info *sbi, unsigned int nr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	unsigned int max_blks = sbi->segs_per_sec << sbi->log_blocks_per_seg;
+	struct discard_cmd *dc;
+	struct rb_node *node;
+	block_t start, len;
+
+	mutex_lock(&dcc->issue_lock);
+	while (nr--) {
+		spin_lock(&dcc->cmd_lock);
+		node = rb_first(&dcc->root);
+		if (!node) {
+			spin_unlock(&dcc->cmd_lock);
+			break;
+		}
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		start = dc->lstart;
+		len = min_t(block_t, dc->len, max_blks);
+
+		dc->lstart += len;
+		dc->len -= len;
+		if (!dc->len)
+			__remove_discard_cmd(dcc, dc);
+		dcc->pending_blks -= len;
+		dcc->issue_start = start;
+		dcc->issue_len = len;
+		spin_unlock(&dcc->cmd_lock);
+
+		__issue_discard_range(sbi, start, len);
+
+		spin_lock(&dcc->cmd_lock);
+		dcc->issue_len = 0;
+		dcc->issued_cmds++;
+		dcc->issued_blks += len;
+		spin_unlock(&dcc->cmd_lock);
+
+		wake_up_all(&dcc->discard_done_queue);
+	}
+	mutex_unlock(&dcc->issue_lock);
+}
+
+static void __punch_discard_cmds(struct f2fs_sb_info *sbi,
+				block_t start, block_t end)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct rb_node *node = dcc->root.rb_node, *next;
+	struct discard_cmd *dc, *first = NULL, *tail;
+	block_t dc_end, blkaddr, from, to;
+	struct seg_entry *se;
+
+	/* find the first pending discard ending after start */
+	while (node) {
+		dc = rb_entry(node, struct discard_cmd, rb_node);
+		if (dc->lstart + dc->len > start) {
+			first = dc;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	for (dc = first; dc && dc->lstart < end; dc = next ?
+			rb_entry(next, struct discard_cmd, rb_node) : NULL) {
+		next = rb_next(&dc->rb_node);
+		dc_end = dc->lstart + dc->len;
+		from = max(dc->lstart, start);
+		to = min(dc_end, end);
+
+		if (dc->lstart < start && dc_end > end) {
+			/* keep the tail as a new discard, or drop it */
+			dc->len = start - dc->lstart;
+			tail = kmem_cache_alloc(discard_cmd_slab, GFP_ATOMIC);
+			if (tail) {
+				tail->lstart = end;
+				tail->len = dc_end - end;
+				__link_discard_cmd(dcc, tail);
+			} else {
+				to = dc_end;
 			}
+		} else if (dc->lstart < start) {
+			dc->len = start - dc->lstart;
+		} else if (dc_end > end) {
+			dc->lstart = end;
+			dc->len = dc_end - end;
+		} else {
+			__remove_discard_cmd(dcc, dc);
+		}
+
+		dcc->pending_blks -= to - from;
+		dcc->punched_blks += to - from;
+
+		/* these blocks are no longer going to be discarded */
+		for (blkaddr = from; blkaddr < to; blkaddr++) {
+			se = get_seg_entry(sbi, GET_SEGNO(sbi, blkaddr));
+			if (f2fs_test_and_clear_bit(
+					GET_BLKOFF_FROM_SEG0(sbi, blkaddr),
+					se->discard_map))
+				sbi->discard_blks++;
 		}
+	}
+}
 
+static inline bool __discard_inflight(struct discard_cmd_control *dcc,
+							block_t blkaddr)
+{
+	return dcc->issue_len && blkaddr >= dcc->issue_start &&
+				blkaddr < dcc->issue_start + dcc->issue_len;
+}
+
+static bool discard_inflight(struct discard_cmd_control *dcc, block_t blkaddr)
+{
+	bool ret;
+
+	spin_lock(&dcc->cmd_lock);
+	ret = __discard_inflight(dcc, blkaddr);
+	spin_unlock(&dcc->cmd_lock);
+	return ret;
+}
+
+/*
+ * The block is about to be written: drop the pending discards on it and on
+ * the rest of its segment, which will be filled next. Returns true if the
+ * block is in the discard being issued now, in which case the caller must
+ * f2fs_wait_discard() once it dropped sentry_lock and curseg_mutex, and
+ * before it submits the write. Caller should hold sentry_lock.
+ */
+static bool f2fs_punch_discard(struct f2fs_sb_info *sbi, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	bool inflight;
+
+	if (!dcc)
+		return false;
+
+	spin_lock(&dcc->cmd_lock);
+	if (dcc->nr_cmds)
+		__punch_discard_cmds(sbi, blkaddr,
+			START_BLOCK(sbi, GET_SEGNO(sbi, blkaddr) + 1));
+	inflight = __discard_inflight(dcc, blkaddr);
+	spin_unlock(&dcc->cmd_lock);
+
+	return inflight;
+}
+
+static void f2fs_wait_discard(struct f2fs_sb_info *sbi, block_t blkaddr)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	wait_event(dcc->discard_done_queue, !discard_inflight(dcc, blkaddr));
+}
+
+/* Drop every pending discard without issuing it */
+static void __drop_discard_cmds(struct discard_cmd_control *dcc)
+{
+	struct rb_node *node;
+
+	spin_lock(&dcc->cmd_lock);
+	while ((node = rb_first(&dcc->root)))
+		__remove_discard_cmd(dcc,
+			rb_entry(node, struct discard_cmd, rb_node));
+	dcc->pending_blks = 0;
+	spin_unlock(&dcc->cmd_lock);
+}
+
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+	long wait_ms = DEF_MAX_DISCARD_ISSUE_TIME;
+
+	do {
+		if (try_to_freeze())
+			continue;
+		else
+			wait_event_interruptible_timeout(*q,
+				kthread_should_stop() ||
+				(wait_ms == DEF_MAX_DISCARD_ISSUE_TIME &&
+							dcc->nr_cmds) ||
+				dcc->pending_blks >= dcc->urgent_blks,
+				msecs_to_jiffies(wait_ms));
+		if (kthread_should_stop())
+			break;
+
+		if (!dcc->nr_cmds) {
+			wait_ms = DEF_MAX_DISCARD_ISSUE_TIME;
+			continue;
+		}
+		wait_ms = DEF_MIN_DISCARD_ISSUE_TIME;
+
+		/* keep out of the way of user I/O unless too much is pending */
+		if (!is_idle(sbi) && dcc->pending_blks < dcc->urgent_blks)
+			continue;
+
+		__issue_discard_cmds(sbi, dcc->max_discard_request);
+
+		/* don't spin on the urgent condition while the device is busy */
+		if (!is_idle(sbi))
+			msleep_interruptible(DEF_MIN_DISCARD_ISSUE_TIME);
+	} while (!kthread_should_stop());
+
+	return 0;
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err = 0;
+
+	if (SM_I(sbi)->dcc_info) {
+		dcc = SM_I(sbi)->dcc_info;
+		if (dcc->f2fs_issue_discard)
+			return err;
+		goto init_thread;
+	}
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	init_waitqueue_head(&dcc->discard_done_queue);
+	mutex_init(&dcc->issue_lock);
+	spin_lock_init(&dcc->cmd_lock);
+	dcc->root = RB_ROOT;
+	dcc->max_discard_request = DEF_MAX_DISCARD_REQUEST;
+	dcc->urgent_blks = (MAIN_SEGS(sbi) << sbi->log_blocks_per_seg) /
+					100 * DEF_URGENT_DISCARD_RATIO;
+	SM_I(sbi)->dcc_info = dcc;
+init_thread:
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		/* on remount, discards queued before may still be pending */
+		__drop_discard_cmds(dcc);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
+	}
+
+	return err;
+}
+
+/*
+ * Stop the discard thread and issue what it left behind, so that nothing
+ * stays pending without a thread to issue it.
+ */
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi, bool free)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+
+	if (dcc->f2fs_issue_discard) {
+		struct task_struct *discard_thread = dcc->f2fs_issue_discard;
+
+		dcc->f2fs_issue_discard = NULL;
+		kthread_stop(discard_thread);
+	}
+
+	if (f2fs_cp_error(sbi))
+		__drop_discard_cmds(dcc);
+	else
+		__issue_discard_cmds(sbi, UINT_MAX);
+
+	if (free) {
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+	}
+}
+
+static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
+			block_t blkstart, block_t blklen, bool force)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct seg_entry *se;
+	unsigned int offset;
+	block_t i;
+
+	for (i = blkstart; i < blkstart + blklen; i++) {
 		se = get_seg_entry(sbi, GET_SEGNO(sbi, i));
 		offset = GET_BLKOFF_FROM_SEG0(sbi, i);
 
@@ -775,11 +1226,14 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 			sbi->discard_blks--;
 	}
 
-	if (len)
-		err = __issue_discard_async(sbi, bdev, start, len);
-
 	trace_f2fs_issue_discard(sbi->sb, blkstart, blklen);
-	return err;
+
+	/* leave it to the discard thread, unless fstrim wants it now */
+	if (!force && dcc && dcc->f2fs_issue_discard) {
+		__queue_discard_cmd(sbi, blkstart, blklen);
+		return 0;
+	}
+	return __issue_discard_range(sbi, blkstart, blklen);
 }
 
 static void __add_discard_entry(struct f2fs_sb_info *sbi,
@@ -904,7 +1358,7 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi, struct cp_control *cpc)
 
 		if (!test_opt(sbi, LFS) || sbi->segs_per_sec == 1) {
 			f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
-				(end - start) << sbi->log_blocks_per_seg);
+				(end - start) << sbi->log_blocks_per_seg, false);
 			continue;
 		}
 next:
@@ -913,7 +1367,8 @@ next:
 		if (!IS_CURSEC(sbi, secno) &&
 			!get_valid_blocks(sbi, start, sbi->segs_per_sec))
 			f2fs_issue_discard(sbi, START_BLOCK(sbi, start_segno),
-				sbi->segs_per_sec << sbi->log_blocks_per_seg);
+				sbi->segs_per_sec << sbi->log_blocks_per_seg,
+				false);
 
 		start = start_segno + sbi->segs_per_sec;
 		if (start < end)
@@ -925,7 +1380,7 @@ next:
 	list_for_each_entry_safe(entry, this, head, list) {
 		if (force && entry->len < cpc->trim_minlen)
 			goto skip;
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		f2fs_issue_discard(sbi, entry->blkaddr, entry->len, force);
 		cpc->trimmed += entry->len;
 skip:
 		list_del(&entry->list);
@@ -998,6 +1453,8 @@ static void update_sit_entry(struct f2fs_sb_info *sbi, block_t blkaddr, int del)
 
 	if (sbi->segs_per_sec > 1)
 		get_sec_entry(sbi, segno)->valid_blocks += del;
+
+	update_victim_index(sbi, segno);
 }
 
 void refresh_sit_entry(struct f2fs_sb_info *sbi, block_t old, block_t new)
@@ -1470,6 +1927,10 @@ int f2fs_trim_fs(struct f2fs_sb_info *sbi, struct fstrim_range *range)
 
 		schedule();
 	}
+
+	/* issue what earlier checkpoints left to the discard thread as well */
+	if (!err && SM_I(sbi)->dcc_info)
+		__issue_discard_cmds(sbi, UINT_MAX);
 out:
 	range->len = F2FS_BLK_TO_BYTES(cpc.trimmed);
 	return err;
@@ -1548,11 +2009,13 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 {
 	struct sit_info *sit_i = SIT_I(sbi);
 	struct curseg_info *curseg = CURSEG_I(sbi, type);
+	bool discarding;
 
 	mutex_lock(&curseg->curseg_mutex);
 	mutex_lock(&sit_i->sentry_lock);
 
 	*new_blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
+	discarding = f2fs_punch_discard(sbi, *new_blkaddr);
 
 	/*
 	 * __add_sum_entry should be resided under the curseg_mutex
@@ -1579,6 +2042,9 @@ void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
 		fill_node_footer_blkaddr(page, NEXT_FREE_BLKADDR(sbi, curseg));
 
 	mutex_unlock(&curseg->curseg_mutex);
+
+	if (discarding)
+		f2fs_wait_discard(sbi, *new_blkaddr);
 }
 
 static void do_write_page(struct f2fs_summary *sum, struct f2fs_io_info *fio)
@@ -1655,6 +2121,7 @@ void __f2fs_replace_block(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
 	struct seg_entry *se;
 	int type;
 	unsigned short old_blkoff;
+	bool discarding;
 
 	segno = GET_SEGNO(sbi, new_blkaddr);
 	se = get_seg_entry(sbi, segno);
@@ -1688,6 +2155,7 @@ void __f2fs_replace_block(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
 	}
 
 	curseg->next_blkoff = GET_BLKOFF_FROM_SEG0(sbi, new_blkaddr);
+	discarding = f2fs_punch_discard(sbi, new_blkaddr);
 	__add_sum_entry(sbi, type, sum);
 
 	if (!recover_curseg || recover_newaddr)
@@ -1710,6 +2178,9 @@ void __f2fs_replace_block(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
 
 	mutex_unlock(&sit_i->sentry_lock);
 	mutex_unlock(&curseg->curseg_mutex);
+
+	if (discarding)
+		f2fs_wait_discard(sbi, new_blkaddr);
 }
 
 void f2fs_replace_block(struct f2fs_sb_info *sbi, struct dnode_of_data *dn,
@@ -2523,10 +2994,40 @@ static int init_victim_secmap(struct f2fs_sb_info *sbi)
 	return 0;
 }
 
+static int init_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+	unsigned int blocks_per_sec = sbi->blocks_per_seg * sbi->segs_per_sec;
+	unsigned int i;
+
+	spin_lock_init(&vi->lock);
+	vi->bucket_shift = 0;
+	while ((blocks_per_sec >> vi->bucket_shift) >= MAX_VICTIM_BUCKETS)
+		vi->bucket_shift++;
+	vi->nr_buckets = (blocks_per_sec >> vi->bucket_shift) + 1;
+	vi->nr_entries = 0;
+
+	vi->buckets = f2fs_kvzalloc(vi->nr_buckets * sizeof(struct list_head),
+								GFP_KERNEL);
+	if (!vi->buckets)
+		return -ENOMEM;
+	for (i = 0; i < vi->nr_buckets; i++)
+		INIT_LIST_HEAD(&vi->buckets[i]);
+
+	vi->entries = f2fs_kvzalloc(MAIN_SECS(sbi) *
+				sizeof(struct victim_entry), GFP_KERNEL);
+	if (!vi->entries)
+		return -ENOMEM;
+	for (i = 0; i < MAIN_SECS(sbi); i++)
+		INIT_LIST_HEAD(&vi->entries[i].list);
+	return 0;
+}
+
 static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i;
 	unsigned int bitmap_size, i;
+	int err;
 
 	/* allocate memory for dirty segments list information */
 	dirty_i = kzalloc(sizeof(struct dirty_seglist_info), GFP_KERNEL);
@@ -2544,6 +3045,10 @@ static int build_dirty_segmap(struct f2fs_sb_info *sbi)
 			return -ENOMEM;
 	}
 
+	err = init_victim_index(sbi);
+	if (err)
+		return err;
+
 	init_dirty_segmap(sbi);
 	return init_victim_secmap(sbi);
 }
@@ -2620,6 +3125,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2659,6 +3170,14 @@ static void destroy_victim_secmap(struct f2fs_sb_info *sbi)
 	f2fs_kvfree(dirty_i->victim_secmap);
 }
 
+static void destroy_victim_index(struct f2fs_sb_info *sbi)
+{
+	struct victim_index *vi = &DIRTY_I(sbi)->vindex;
+
+	f2fs_kvfree(vi->entries);
+	f2fs_kvfree(vi->buckets);
+}
+
 static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 {
 	struct dirty_seglist_info *dirty_i = DIRTY_I(sbi);
@@ -2672,6 +3191,7 @@ static void destroy_dirty_segmap(struct f2fs_sb_info *sbi)
 		discard_dirty_segmap(sbi, i);
 
 	destroy_victim_secmap(sbi);
+	destroy_victim_index(sbi);
 	SM_I(sbi)->dirty_info = NULL;
 	kfree(dirty_i);
 }
@@ -2735,6 +3255,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi, true);
+	destroy_discard_cmd_control(sbi, true);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -2750,10 +3271,15 @@ int __init create_segment_manager_caches(void)
 	if (!discard_entry_slab)
 		goto fail;
 
+	discard_cmd_slab = f2fs_kmem_cache_create("discard_cmd",
+			sizeof(struct discard_cmd));
+	if (!discard_cmd_slab)
+		goto destory_discard_entry;
+
 	sit_entry_set_slab = f2fs_kmem_cache_create("sit_entry_set",
 			sizeof(struct sit_entry_set));
 	if (!sit_entry_set_slab)
-		goto destory_discard_entry;
+		goto destroy_discard_cmd;
 
 	inmem_entry_slab = f2fs_kmem_cache_create("inmem_page_entry",
 			sizeof(struct inmem_pages));
@@ -2763,6 +3289,8 @@ int __init create_segment_manager_caches(void)
 
 destroy_sit_entry_set:
 	kmem_cache_destroy(sit_entry_set_slab);
+destroy_discard_cmd:
+	kmem_cache_destroy(discard_cmd_slab);
 destory_discard_entry:
 	kmem_cache_destroy(discard_entry_slab);
 fail:
@@ -2772,6 +3300,7 @@ fail:
 void destroy_segment_manager_caches(void)
 {
 	kmem_cache_destroy(sit_entry_set_slab);
+	kmem_cache_destroy(discard_cmd_slab);
 	kmem_cache_destroy(discard_entry_slab);
 	kmem_cache_destroy(inmem_entry_slab);
 }
@@ -241,12 +241,37 @@ enum dirty_type {
 	NR_DIRTY_TYPE
 };
 
+/*
+ * The victim index keeps every section holding DIRTY segments on a list
+ * bucketed by its valid blocks, so LFS victim selection can start from the
+ * emptiest sections instead of scanning dirty_segmap. A section is appended
+ * to a bucket whenever its valid blocks move it there, so the order inside
+ * a bucket says nothing about the age of its sections.
+ */
+#define MAX_VICTIM_BUCKETS	512
+
+struct victim_entry {
+	struct list_head list;			/* link in its bucket */
+	unsigned short dirty_segs;		/* # of DIRTY segments */
+	unsigned short bucket;			/* bucket it is linked in */
+};
+
+struct victim_index {
+	spinlock_t lock;			/* protects buckets and entries */
+	struct victim_entry *entries;		/* one per section */
+	struct list_head *buckets;		/* sections by valid blocks */
+	unsigned int nr_buckets;
+	unsigned int bucket_shift;		/* valid blocks >> shift */
+	unsigned int nr_entries;		/* # of indexed sections */
+};
+
 struct dirty_seglist_info {
 	const struct victim_selection *v_ops;	/* victim selction operation */
 	unsigned long *dirty_segmap[NR_DIRTY_TYPE];
 	struct mutex seglist_lock;		/* lock for segment bitmaps */
 	int nr_dirty[NR_DIRTY_TYPE];		/* # of dirty segments */
 	unsigned long *victim_secmap;		/* background GC victims */
+	struct victim_index vindex;		/* LFS victim candidates */
 };
 
 /* victim selection function for cleaning and SSR */
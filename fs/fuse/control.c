@@ -10,6 +10,7 @@
 
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/seq_file.h>
 
 #define FUSE_CTL_SUPER_MAGIC 0x65735543
 
@@ -170,6 +171,57 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+static int fuse_conn_stats_show(struct seq_file *m, void *v)
+{
+	struct fuse_conn *fc = m->private;
+	struct fuse_dev *fud;
+	struct fuse_req *req;
+	unsigned queued;
+	u64 avg;
+
+	spin_lock(&fc->lock);
+	avg = fc->stat_reqs ? div64_u64(fc->stat_lat_total, fc->stat_reqs) : 0;
+	seq_printf(m, "channels: %u\n", fc->num_devices);
+	seq_printf(m, "queued: %u\n", fc->num_queued);
+	seq_printf(m, "max_queued: %u\n", fc->max_queued);
+	seq_printf(m, "background: %u\n", fc->num_background);
+	seq_printf(m, "requests: %llu\n", fc->stat_reqs);
+	seq_printf(m, "latency_avg_us: %llu\n", avg);
+	seq_printf(m, "latency_max_us: %llu\n", fc->stat_lat_max);
+	list_for_each_entry(fud, &fc->devices, entry) {
+		queued = 0;
+		list_for_each_entry(req, &fud->pending, list)
+			queued++;
+		seq_printf(m, "channel %u: queued %u read %llu stolen %llu\n",
+			   fud->id, queued, fud->nr_read, fud->nr_stolen);
+	}
+	spin_unlock(&fc->lock);
+
+	return 0;
+}
+
+static int fuse_conn_stats_open(struct inode *inode, struct file *file)
+{
+	struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+	int err;
+
+	if (!fc)
+		return -ENOENT;
+
+	err = single_open(file, fuse_conn_stats_show, fc);
+	if (err)
+		fuse_conn_put(fc);
+	return err;
+}
+
+static int fuse_conn_stats_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+
+	fuse_conn_put(m->private);
+	return single_release(inode, file);
+}
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -196,6 +248,13 @@ static const struct file_operations fuse_conn_congestion_threshold_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_conn_stats_ops = {
+	.open = fuse_conn_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = fuse_conn_stats_release,
+};
+
 static struct dentry *fuse_ctl_add_dentry(struct dentry *parent,
 					  struct fuse_conn *fc,
 					  const char *name,
@@ -260,7 +319,9 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
 				 S_IFREG | 0600, 1, NULL,
-				 &fuse_conn_congestion_threshold_ops))
+				 &fuse_conn_congestion_threshold_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "stats", S_IFREG | 0400, 1,
+				 NULL, &fuse_conn_stats_ops))
 		goto err;
 
 	return 0;
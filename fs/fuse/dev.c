@@ -28,7 +28,7 @@ MODULE_ALIAS("devname:fuse");
 
 static struct kmem_cache *fuse_req_cachep;
 
-static struct fuse_conn *fuse_get_conn(struct file *file)
+static struct fuse_dev *fuse_get_dev(struct file *file)
 {
 	/*
 	 * Lockless access is OK, because file->private data is set
@@ -37,6 +37,13 @@ static struct fuse_conn *fuse_get_conn(struct file *file)
 	return file->private_data;
 }
 
+static struct fuse_conn *fuse_get_conn(struct file *file)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+
+	return fud ? fud->fc : NULL;
+}
+
 static void fuse_request_init(struct fuse_req *req, struct page **pages,
 			      struct fuse_page_desc *page_descs,
 			      unsigned npages)
@@ -282,6 +289,9 @@ void fuse_put_request(struct fuse_conn *fc, struct fuse_req *req)
 		if (req->waiting)
 			atomic_dec(&fc->num_waiting);
 
+		/* Open reply whose lower file was never claimed */
+		fuse_passthrough_put_req(req);
+
 		if (req->stolen_file)
 			put_reserved_req(fc, req);
 		else
@@ -311,18 +321,70 @@ static u64 fuse_get_unique(struct fuse_conn *fc)
 	return fc->reqctr;
 }
 
+/*
+ * Pick the channel to hand new work to: the one belonging to the
+ * submitting CPU if a reader is waiting on it, else any channel with a
+ * waiting reader, else the submitting CPU's channel anyway.
+ *
+ * Called with fc->lock held
+ */
+static struct fuse_dev *fuse_pick_dev(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud, *local = NULL;
+	unsigned idx;
+
+	if (!fc->num_devices)
+		return NULL;
+
+	idx = raw_smp_processor_id() % fc->num_devices;
+	list_for_each_entry(fud, &fc->devices, entry) {
+		if (!idx--) {
+			local = fud;
+			break;
+		}
+	}
+	if (waitqueue_active(&local->waitq))
+		return local;
+
+	list_for_each_entry(fud, &fc->devices, entry) {
+		if (waitqueue_active(&fud->waitq))
+			return fud;
+	}
+	return local;
+}
+
+static void fuse_wake_reader(struct fuse_conn *fc, struct fuse_dev *fud)
+{
+	if (fud)
+		wake_up(&fud->waitq);
+	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+}
+
+static void fuse_wake_all_readers(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud;
+
+	list_for_each_entry(fud, &fc->devices, entry)
+		wake_up_all(&fud->waitq);
+	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+}
+
 static void queue_request(struct fuse_conn *fc, struct fuse_req *req)
 {
+	struct fuse_dev *fud = fuse_pick_dev(fc);
+
 	req->in.h.len = sizeof(struct fuse_in_header) +
 		len_args(req->in.numargs, (struct fuse_arg *) req->in.args);
-	list_add_tail(&req->list, &fc->pending);
+	list_add_tail(&req->list, fud ? &fud->pending : &fc->pending);
 	req->state = FUSE_REQ_PENDING;
+	req->queue_time = ktime_get();
 	if (!req->waiting) {
 		req->waiting = 1;
 		atomic_inc(&fc->num_waiting);
 	}
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	if (++fc->num_queued > fc->max_queued)
+		fc->max_queued = fc->num_queued;
+	fuse_wake_reader(fc, fud);
 }
 
 void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
@@ -335,8 +397,7 @@ void fuse_queue_forget(struct fuse_conn *fc, struct fuse_forget_link *forget,
 	if (fc->connected) {
 		fc->forget_list_tail->next = forget;
 		fc->forget_list_tail = forget;
-		wake_up(&fc->waitq);
-		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+		fuse_wake_reader(fc, fuse_pick_dev(fc));
 	} else {
 		kfree(forget);
 	}
@@ -374,6 +435,16 @@ __releases(fc->lock)
 	req->end = NULL;
 	list_del(&req->list);
 	list_del(&req->intr_entry);
+	if (req->state == FUSE_REQ_PENDING) {
+		fc->num_queued--;
+	} else if (req->state != FUSE_REQ_INIT) {
+		u64 lat = ktime_us_delta(ktime_get(), req->queue_time);
+
+		fc->stat_reqs++;
+		fc->stat_lat_total += lat;
+		if (lat > fc->stat_lat_max)
+			fc->stat_lat_max = lat;
+	}
 	req->state = FUSE_REQ_FINISHED;
 	if (req->background) {
 		req->background = 0;
@@ -417,8 +488,7 @@ __acquires(fc->lock)
 static void queue_interrupt(struct fuse_conn *fc, struct fuse_req *req)
 {
 	list_add_tail(&req->intr_entry, &fc->interrupts);
-	wake_up(&fc->waitq);
-	kill_fasync(&fc->fasync, SIGIO, POLL_IN);
+	fuse_wake_reader(fc, fuse_pick_dev(fc));
 }
 
 static void request_wait_answer(struct fuse_conn *fc, struct fuse_req *req)
@@ -455,6 +525,7 @@ __acquires(fc->lock)
 		/* Request is not yet in userspace, bail out */
 		if (req->state == FUSE_REQ_PENDING) {
 			list_del(&req->list);
+			fc->num_queued--;
 			__fuse_put_request(req);
 			req->out.h.error = -EINTR;
 			return;
@@ -1015,18 +1086,23 @@ static int forget_pending(struct fuse_conn *fc)
 
 static int request_pending(struct fuse_conn *fc)
 {
-	return !list_empty(&fc->pending) || !list_empty(&fc->interrupts) ||
+	return fc->num_queued || !list_empty(&fc->interrupts) ||
 		forget_pending(fc);
 }
 
-/* Wait until a request is available on the pending list */
-static void request_wait(struct fuse_conn *fc)
-__releases(fc->lock)
-__acquires(fc->lock)
+/*
+ * Wait until a request is available on any pending list.  Queued
+ * requests are not tied to the channel they were routed to, a reader
+ * that would otherwise sleep takes over work from the other channels.
+ */
+static void request_wait(struct fuse_dev *fud)
+__releases(fud->fc->lock)
+__acquires(fud->fc->lock)
 {
+	struct fuse_conn *fc = fud->fc;
 	DECLARE_WAITQUEUE(wait, current);
 
-	add_wait_queue_exclusive(&fc->waitq, &wait);
+	add_wait_queue_exclusive(&fud->waitq, &wait);
 	while (fc->connected && !request_pending(fc)) {
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (signal_pending(current))
@@ -1037,7 +1113,38 @@ __acquires(fc->lock)
 		spin_lock(&fc->lock);
 	}
 	set_current_state(TASK_RUNNING);
-	remove_wait_queue(&fc->waitq, &wait);
+	remove_wait_queue(&fud->waitq, &wait);
+}
+
+/*
+ * Take the next request for @fud: from its own queue first, then from
+ * the requests queued while no channel was attached, then from the
+ * first other channel that has any.
+ */
+static struct fuse_req *dequeue_request(struct fuse_dev *fud)
+{
+	struct fuse_conn *fc = fud->fc;
+	struct list_head *head = NULL;
+	struct fuse_dev *other;
+
+	if (!list_empty(&fud->pending)) {
+		head = &fud->pending;
+	} else if (!list_empty(&fc->pending)) {
+		head = &fc->pending;
+	} else {
+		list_for_each_entry(other, &fc->devices, entry) {
+			if (!list_empty(&other->pending)) {
+				head = &other->pending;
+				fud->nr_stolen++;
+				break;
+			}
+		}
+	}
+	BUG_ON(!head);
+
+	fc->num_queued--;
+	fud->nr_read++;
+	return list_entry(head->next, struct fuse_req, list);
 }
 
 /*
@@ -1201,9 +1308,10 @@ __releases(fc->lock)
  * request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
+	struct fuse_conn *fc = fud->fc;
 	int err;
 	struct fuse_req *req;
 	struct fuse_in *in;
@@ -1216,7 +1324,7 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	    !request_pending(fc))
 		goto err_unlock;
 
-	request_wait(fc);
+	request_wait(fud);
 	err = -ENODEV;
 	if (!fc->connected)
 		goto err_unlock;
@@ -1231,14 +1339,14 @@ static ssize_t fuse_dev_do_read(struct fuse_conn *fc, struct file *file,
 	}
 
 	if (forget_pending(fc)) {
-		if (list_empty(&fc->pending) || fc->forget_batch-- > 0)
+		if (!fc->num_queued || fc->forget_batch-- > 0)
 			return fuse_read_forget(fc, cs, nbytes);
 
 		if (fc->forget_batch <= -8)
 			fc->forget_batch = 16;
 	}
 
-	req = list_entry(fc->pending.next, struct fuse_req, list);
+	req = dequeue_request(fud);
 	req->state = FUSE_REQ_READING;
 	list_move(&req->list, &fc->io);
 
@@ -1292,13 +1400,13 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, const struct iovec *iov,
 {
 	struct fuse_copy_state cs;
 	struct file *file = iocb->ki_filp;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (!fud)
 		return -EPERM;
 
-	fuse_copy_init(&cs, fc, 1, iov, nr_segs);
+	fuse_copy_init(&cs, fud->fc, 1, iov, nr_segs);
 
-	return fuse_dev_do_read(fc, file, &cs, iov_length(iov, nr_segs));
+	return fuse_dev_do_read(fud, file, &cs, iov_length(iov, nr_segs));
 }
 
 static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
@@ -1310,18 +1418,18 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	int do_wakeup = 0;
 	struct pipe_buffer *bufs;
 	struct fuse_copy_state cs;
-	struct fuse_conn *fc = fuse_get_conn(in);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(in);
+	if (!fud)
 		return -EPERM;
 
 	bufs = kmalloc(pipe->buffers * sizeof(struct pipe_buffer), GFP_KERNEL);
 	if (!bufs)
 		return -ENOMEM;
 
-	fuse_copy_init(&cs, fc, 1, NULL, 0);
+	fuse_copy_init(&cs, fud->fc, 1, NULL, 0);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fc, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -1876,6 +1984,9 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
                req->out.h.error = kern_path((char *)req->out.args[0].value, 0,
                                                        req->canonical_path);
        }
+	if (!err && !oh.error && (req->in.h.opcode == FUSE_OPEN ||
+				  req->in.h.opcode == FUSE_CREATE))
+		fuse_setup_passthrough(fc, req);
 	fuse_copy_finish(cs);
 
 	spin_lock(&fc->lock);
@@ -1990,11 +2101,13 @@ out:
 static unsigned fuse_dev_poll(struct file *file, poll_table *wait)
 {
 	unsigned mask = POLLOUT | POLLWRNORM;
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (!fc)
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_conn *fc;
+	if (!fud)
 		return POLLERR;
 
-	poll_wait(file, &fc->waitq, wait);
+	fc = fud->fc;
+	poll_wait(file, &fud->waitq, wait);
 
 	spin_lock(&fc->lock);
 	if (!fc->connected)
@@ -2065,8 +2178,12 @@ static void end_queued_requests(struct fuse_conn *fc)
 __releases(fc->lock)
 __acquires(fc->lock)
 {
+	struct fuse_dev *fud;
+
 	fc->max_background = UINT_MAX;
 	flush_bg_queue(fc);
+	list_for_each_entry(fud, &fc->devices, entry)
+		list_splice_tail_init(&fud->pending, &fc->pending);
 	end_requests(fc, &fc->pending);
 	end_requests(fc, &fc->processing);
 	while (forget_pending(fc))
@@ -2117,26 +2234,90 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		end_io_requests(fc);
 		end_queued_requests(fc);
 		end_polls(fc);
-		wake_up_all(&fc->waitq);
+		fuse_wake_all_readers(fc);
 		wake_up_all(&fc->blocked_waitq);
-		kill_fasync(&fc->fasync, SIGIO, POLL_IN);
 	}
 	spin_unlock(&fc->lock);
 }
 EXPORT_SYMBOL_GPL(fuse_abort_conn);
 
+void fuse_conn_wake_readers(struct fuse_conn *fc)
+{
+	spin_lock(&fc->lock);
+	fuse_wake_all_readers(fc);
+	spin_unlock(&fc->lock);
+}
+
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc)
+{
+	struct fuse_dev *fud;
+
+	fud = kzalloc(sizeof(struct fuse_dev), GFP_KERNEL);
+	if (!fud)
+		return NULL;
+
+	fud->fc = fc;
+	INIT_LIST_HEAD(&fud->pending);
+	INIT_LIST_HEAD(&fud->entry);
+	init_waitqueue_head(&fud->waitq);
+
+	return fud;
+}
+EXPORT_SYMBOL_GPL(fuse_dev_alloc);
+
+/*
+ * Attach a channel to its connection and to @file.  The channel takes
+ * over a reference to the connection from the caller.
+ */
+void fuse_dev_install(struct fuse_dev *fud, struct file *file)
+{
+	struct fuse_conn *fc = fud->fc;
+
+	spin_lock(&fc->lock);
+	fud->id = fc->devctr++;
+	list_add_tail(&fud->entry, &fc->devices);
+	fc->num_devices++;
+	if (request_pending(fc))
+		fuse_wake_reader(fc, fud);
+	spin_unlock(&fc->lock);
+
+	file->private_data = fud;
+}
+EXPORT_SYMBOL_GPL(fuse_dev_install);
+
+void fuse_dev_free(struct fuse_dev *fud)
+{
+	kfree(fud);
+}
+EXPORT_SYMBOL_GPL(fuse_dev_free);
+
+/*
+ * Closing one of several channels hands its queued requests over to the
+ * others; the connection only goes down with the last one.  Requests
+ * already read through this channel can still be answered on any other.
+ */
 int fuse_dev_release(struct inode *inode, struct file *file)
 {
-	struct fuse_conn *fc = fuse_get_conn(file);
-	if (fc) {
+	struct fuse_dev *fud = fuse_get_dev(file);
+	if (fud) {
+		struct fuse_conn *fc = fud->fc;
+
 		spin_lock(&fc->lock);
-		fc->connected = 0;
-		fc->blocked = 0;
-		fc->initialized = 1;
-		end_queued_requests(fc);
-		end_polls(fc);
-		wake_up_all(&fc->blocked_waitq);
+		list_del(&fud->entry);
+		fc->num_devices--;
+		list_splice_tail_init(&fud->pending, &fc->pending);
+		if (!fc->num_devices) {
+			fc->connected = 0;
+			fc->blocked = 0;
+			fc->initialized = 1;
+			end_queued_requests(fc);
+			end_polls(fc);
+			wake_up_all(&fc->blocked_waitq);
+		} else if (request_pending(fc)) {
+			fuse_wake_reader(fc, fuse_pick_dev(fc));
+		}
 		spin_unlock(&fc->lock);
+		fuse_dev_free(fud);
 		fuse_conn_put(fc);
 	}
 
@@ -2144,6 +2325,60 @@ int fuse_dev_release(struct inode *inode, struct file *file)
 }
 EXPORT_SYMBOL_GPL(fuse_dev_release);
 
+/* Attach @file as another channel of the connection behind @oldfd */
+static int fuse_dev_clone(struct file *file, int oldfd)
+{
+	struct fuse_dev *fud;
+	struct file *old;
+	int err = -EINVAL;
+
+	old = fget(oldfd);
+	if (!old)
+		return -EBADF;
+
+	/* Only plain fuse channels, CUSE has its own open and release */
+	if (old->f_op != &fuse_dev_operations ||
+	    file->f_op != &fuse_dev_operations || !fuse_get_dev(old))
+		goto out_fput;
+
+	err = -ENOMEM;
+	fud = fuse_dev_alloc(fuse_get_conn(old));
+	if (!fud)
+		goto out_fput;
+
+	mutex_lock(&fuse_mutex);
+	err = -EINVAL;
+	if (file->private_data) {
+		mutex_unlock(&fuse_mutex);
+		fuse_dev_free(fud);
+		goto out_fput;
+	}
+	fuse_dev_install(fud, file);
+	fuse_conn_get(fud->fc);
+	mutex_unlock(&fuse_mutex);
+	err = 0;
+
+ out_fput:
+	fput(old);
+	return err;
+}
+
+static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	int oldfd;
+
+	switch (cmd) {
+	case FUSE_DEV_IOC_CLONE:
+		if (get_user(oldfd, (__u32 __user *) arg))
+			return -EFAULT;
+		return fuse_dev_clone(file, oldfd);
+
+	default:
+		return -ENOTTY;
+	}
+}
+
 static int fuse_dev_fasync(int fd, struct file *file, int on)
 {
 	struct fuse_conn *fc = fuse_get_conn(file);
@@ -2166,6 +2401,8 @@ const struct file_operations fuse_dev_operations = {
 	.poll		= fuse_dev_poll,
 	.release	= fuse_dev_release,
 	.fasync		= fuse_dev_fasync,
+	.unlocked_ioctl	= fuse_dev_ioctl,
+	.compat_ioctl	= fuse_dev_ioctl,
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
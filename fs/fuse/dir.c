@@ -504,6 +504,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	req->out.args[1].value = &outopen;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	fuse_passthrough_claim(ff, req);
 	if (err)
 		goto out_free_ff;
 
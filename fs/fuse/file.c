@@ -19,9 +19,11 @@
 #include <linux/falloc.h>
 
 static const struct file_operations fuse_direct_io_file_operations;
+static const struct file_operations fuse_passthrough_file_operations;
 
 static int fuse_send_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
-			  int opcode, struct fuse_open_out *outargp)
+			  int opcode, struct fuse_open_out *outargp,
+			  struct fuse_file *ff)
 {
 	struct fuse_open_in inarg;
 	struct fuse_req *req;
@@ -45,6 +47,7 @@ static int fuse_send_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 	req->out.args[0].value = outargp;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	fuse_passthrough_claim(ff, req);
 	fuse_put_request(fc, req);
 
 	return err;
@@ -67,6 +70,8 @@ struct fuse_file *fuse_file_alloc(struct fuse_conn *fc)
 
 	INIT_LIST_HEAD(&ff->write_entry);
 	atomic_set(&ff->count, 0);
+	ff->passthrough_filp = NULL;
+	ff->passthrough_cred = NULL;
 	RB_CLEAR_NODE(&ff->polled_node);
 	init_waitqueue_head(&ff->poll_wait);
 
@@ -79,6 +84,7 @@ struct fuse_file *fuse_file_alloc(struct fuse_conn *fc)
 
 void fuse_file_free(struct fuse_file *ff)
 {
+	fuse_passthrough_release(ff);
 	fuse_request_free(ff->reserved_req);
 	kfree(ff);
 }
@@ -137,6 +143,7 @@ static void fuse_file_put(struct fuse_file *ff, bool sync)
 			req->background = 1;
 			fuse_request_send_background(ff->fc, req);
 		}
+		fuse_passthrough_release(ff);
 		kfree(ff);
 	}
 }
@@ -153,7 +160,7 @@ int fuse_do_open(struct fuse_conn *fc, u64 nodeid, struct file *file,
 	if (!ff)
 		return -ENOMEM;
 
-	err = fuse_send_open(fc, nodeid, file, opcode, &outarg);
+	err = fuse_send_open(fc, nodeid, file, opcode, &outarg, ff);
 	if (err) {
 		fuse_file_free(ff);
 		return err;
@@ -178,6 +185,8 @@ void fuse_finish_open(struct inode *inode, struct file *file)
 
 	if (ff->open_flags & FOPEN_DIRECT_IO)
 		file->f_op = &fuse_direct_io_file_operations;
+	if (fuse_passthrough_open(ff, file))
+		file->f_op = &fuse_passthrough_file_operations;
 	if (!(ff->open_flags & FOPEN_KEEP_CACHE))
 		invalidate_inode_pages2(inode->i_mapping);
 	if (ff->open_flags & FOPEN_NONSEEKABLE)
@@ -2579,6 +2588,41 @@ static const struct file_operations fuse_direct_io_file_operations = {
 	/* no splice_read */
 };
 
+static int fuse_passthrough_file_mmap(struct file *file,
+				      struct vm_area_struct *vma)
+{
+	/*
+	 * mmap_region() has already denied writes to @file for a
+	 * MAP_DENYWRITE mapping and settles that against file_inode(@file),
+	 * while a passed through vma would be accounted to the lower inode.
+	 * Map those, executables mostly, through the fuse page cache.
+	 */
+	if (vma->vm_flags & VM_DENYWRITE)
+		return fuse_file_mmap(file, vma);
+
+	return fuse_passthrough_mmap(file, vma);
+}
+
+static const struct file_operations fuse_passthrough_file_operations = {
+	.llseek		= fuse_file_llseek,
+	.read		= do_sync_read,
+	.aio_read	= fuse_passthrough_aio_read,
+	.write		= do_sync_write,
+	.aio_write	= fuse_passthrough_aio_write,
+	.mmap		= fuse_passthrough_file_mmap,
+	.open		= fuse_open,
+	.flush		= fuse_flush,
+	.release	= fuse_release,
+	.fsync		= fuse_fsync,
+	.lock		= fuse_file_lock,
+	.flock		= fuse_file_flock,
+	.unlocked_ioctl	= fuse_file_ioctl,
+	.compat_ioctl	= fuse_file_compat_ioctl,
+	.poll		= fuse_file_poll,
+	.fallocate	= fuse_file_fallocate,
+	.splice_read	= fuse_passthrough_splice_read,
+};
+
 static const struct address_space_operations fuse_file_aops  = {
 	.readpage	= fuse_readpage,
 	.writepage	= fuse_writepage,
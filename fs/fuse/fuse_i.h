@@ -22,6 +22,9 @@
 #include <linux/rbtree.h>
 #include <linux/poll.h>
 #include <linux/workqueue.h>
+#include <linux/ktime.h>
+
+#define FUSE_SUPER_MAGIC 0x65735546
 
 /** Max number of pages that can be used in a single read request */
 #define FUSE_MAX_PAGES_PER_REQ 32
@@ -33,7 +36,7 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
 
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
@@ -155,6 +158,12 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Lower file that read, write and mmap are passed through to */
+	struct file *passthrough_filp;
+
+	/** Daemon credentials the lower file is accessed with */
+	const struct cred *passthrough_cred;
 };
 
 /** One input argument of a request */
@@ -300,6 +309,9 @@ struct fuse_req {
 	/** Used to wake up the task waiting for completion of request*/
 	wait_queue_head_t waitq;
 
+	/** Time the request was queued for userspace */
+	ktime_t queue_time;
+
 	/** Data for asynchronous requests */
 	union {
 		struct {
@@ -351,6 +363,12 @@ struct fuse_req {
 	/** Path used for completing d_canonical_path */
 	struct path *canonical_path;
 
+	/** Lower file named by an OPEN or CREATE reply, if any */
+	struct file *passthrough_filp;
+
+	/** Credentials of the daemon that sent that reply */
+	const struct cred *passthrough_cred;
+
 	/** AIO control block */
 	struct fuse_io_priv *io;
 
@@ -364,6 +382,35 @@ struct fuse_req {
 	struct file *stolen_file;
 };
 
+/**
+ * A channel of a fuse connection: the /dev/fuse file the filesystem was
+ * mounted with, or one attached later with FUSE_DEV_IOC_CLONE.  Requests
+ * are routed to the channel of the submitting CPU, so that a daemon with
+ * a thread per channel serves them on separate queues.
+ */
+struct fuse_dev {
+	/** Fuse connection for this channel */
+	struct fuse_conn *fc;
+
+	/** Requests routed to this channel, not yet read */
+	struct list_head pending;
+
+	/** Readers of this channel are waiting on this */
+	wait_queue_head_t waitq;
+
+	/** Entry on fc->devices */
+	struct list_head entry;
+
+	/** Channel number, as shown in the control filesystem */
+	unsigned id;
+
+	/** Requests read through this channel */
+	u64 nr_read;
+
+	/** Requests taken over from other channels' queues */
+	u64 nr_stolen;
+};
+
 /**
  * A Fuse connection.
  *
@@ -396,12 +443,31 @@ struct fuse_conn {
 	/** Maximum write size */
 	unsigned max_write;
 
-	/** Readers of the connection are waiting on this */
-	wait_queue_head_t waitq;
+	/** Channels (open /dev/fuse files) attached to this connection */
+	struct list_head devices;
+
+	/** Number of channels on the above list */
+	unsigned num_devices;
 
-	/** The list of pending requests */
+	/** The next channel number */
+	unsigned devctr;
+
+	/** Requests queued while no channel was attached */
 	struct list_head pending;
 
+	/** Number of requests on all pending lists */
+	unsigned num_queued;
+
+	/** Peak of num_queued */
+	unsigned max_queued;
+
+	/** Number of requests completed after being queued */
+	u64 stat_reqs;
+
+	/** Total and worst queue-to-completion latency in microseconds */
+	u64 stat_lat_total;
+	u64 stat_lat_max;
+
 	/** The list of requests being processed */
 	struct list_head processing;
 
@@ -549,6 +615,9 @@ struct fuse_conn {
 	/** Does the filesystem support asynchronous direct-IO submission? */
 	unsigned async_dio:1;
 
+	/** Does the filesystem hand back lower files to pass I/O through to? */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -874,4 +943,28 @@ void fuse_write_update_size(struct inode *inode, loff_t pos);
 int fuse_do_setattr(struct inode *inode, struct iattr *attr,
 		    struct file *file);
 
+struct fuse_dev *fuse_dev_alloc(struct fuse_conn *fc);
+void fuse_dev_install(struct fuse_dev *fud, struct file *file);
+void fuse_dev_free(struct fuse_dev *fud);
+
+/**
+ * Wake up the readers of all channels, after the connection went down
+ */
+void fuse_conn_wake_readers(struct fuse_conn *fc);
+
+/* passthrough.c */
+void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req);
+void fuse_passthrough_claim(struct fuse_file *ff, struct fuse_req *req);
+void fuse_passthrough_put_req(struct fuse_req *req);
+bool fuse_passthrough_open(struct fuse_file *ff, struct file *file);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
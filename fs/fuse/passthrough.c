@@ -0,0 +1,226 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  Passing read, write and mmap of an open file straight through to a
+  lower file handed back by the filesystem daemon.
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/cred.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/uio.h>
+
+/*
+ * Called from the daemon's write of an OPEN or CREATE reply, so that
+ * passthrough_fd is looked up in the daemon's file table.  The lower file
+ * and the daemon's credentials, which all I/O on it is done with, are
+ * parked on the request until the opener claims them.
+ */
+void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *passthrough_filp;
+	struct inode *lower;
+
+	/* FUSE_CREATE replies carry the entry before the open reply */
+	outarg = req->out.args[req->out.numargs - 1].value;
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH))
+		return;
+	outarg->open_flags &= ~FOPEN_PASSTHROUGH;
+
+	if (!fc->passthrough)
+		return;
+
+	passthrough_filp = fget(outarg->passthrough_fd);
+	if (!passthrough_filp)
+		return;
+
+	lower = file_inode(passthrough_filp);
+	if (!S_ISREG(lower->i_mode) ||
+	    lower->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !passthrough_filp->f_op ||
+	    !passthrough_filp->f_op->aio_read ||
+	    !passthrough_filp->f_op->aio_write) {
+		fput(passthrough_filp);
+		return;
+	}
+
+	req->passthrough_filp = passthrough_filp;
+	req->passthrough_cred = get_current_cred();
+}
+
+/* Move the lower file of an OPEN or CREATE reply over to @ff */
+void fuse_passthrough_claim(struct fuse_file *ff, struct fuse_req *req)
+{
+	ff->passthrough_filp = req->passthrough_filp;
+	ff->passthrough_cred = req->passthrough_cred;
+	req->passthrough_filp = NULL;
+	req->passthrough_cred = NULL;
+}
+
+/* Drop the lower file of a reply that was never claimed */
+void fuse_passthrough_put_req(struct fuse_req *req)
+{
+	if (req->passthrough_filp) {
+		fput(req->passthrough_filp);
+		put_cred(req->passthrough_cred);
+	}
+}
+
+/*
+ * Decide at open time whether @file can use the lower file.  It must have
+ * been opened with at least the access of @file and the same append mode,
+ * since all data I/O bypasses the daemon from now on.
+ */
+bool fuse_passthrough_open(struct fuse_file *ff, struct file *file)
+{
+	struct file *passthrough_filp = ff->passthrough_filp;
+
+	if (!passthrough_filp)
+		return false;
+
+	if ((file->f_mode & ~passthrough_filp->f_mode &
+	     (FMODE_READ | FMODE_WRITE)) ||
+	    ((file->f_flags ^ passthrough_filp->f_flags) & O_APPEND)) {
+		fuse_passthrough_release(ff);
+		return false;
+	}
+
+	return true;
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		put_cred(ff->passthrough_cred);
+		ff->passthrough_filp = NULL;
+		ff->passthrough_cred = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	/* The lower file is the daemon's, check and access it as the daemon */
+	old_cred = override_creds(ff->passthrough_cred);
+
+	ret = rw_verify_area(rw, passthrough_filp, &pos,
+			     iov_length(iov, nr_segs));
+	if (ret < 0)
+		goto out;
+
+	init_sync_kiocb(&kiocb, passthrough_filp);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = ret;
+	kiocb.ki_nbytes = kiocb.ki_left;
+
+	if (rw == WRITE) {
+		file_start_write(passthrough_filp);
+		ret = passthrough_filp->f_op->aio_write(&kiocb, iov, nr_segs,
+							kiocb.ki_pos);
+		if (ret == -EIOCBQUEUED)
+			ret = wait_on_sync_kiocb(&kiocb);
+		file_end_write(passthrough_filp);
+	} else {
+		ret = passthrough_filp->f_op->aio_read(&kiocb, iov, nr_segs,
+						       kiocb.ki_pos);
+		if (ret == -EIOCBQUEUED)
+			ret = wait_on_sync_kiocb(&kiocb);
+	}
+	iocb->ki_pos = kiocb.ki_pos;
+out:
+	revert_creds(old_cred);
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	struct inode *inode = file_inode(iocb->ki_filp);
+	ssize_t ret;
+
+	ret = fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+	if (ret > 0) {
+		/* Attributes still come from the daemon, just drop them */
+		fuse_write_update_size(inode, iocb->ki_pos);
+		fuse_invalidate_attr(inode);
+		/* MAP_DENYWRITE mappings use the fuse page cache */
+		if (inode->i_mapping->nrpages)
+			invalidate_inode_pages2_range(inode->i_mapping,
+				(iocb->ki_pos - ret) >> PAGE_CACHE_SHIFT,
+				(iocb->ki_pos - 1) >> PAGE_CACHE_SHIFT);
+	}
+
+	return ret;
+}
+
+ssize_t fuse_passthrough_splice_read(struct file *in, loff_t *ppos,
+				     struct pipe_inode_info *pipe, size_t len,
+				     unsigned int flags)
+{
+	struct fuse_file *ff = in->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	const struct cred *old_cred;
+	ssize_t ret;
+
+	if (!passthrough_filp->f_op->splice_read)
+		return -EINVAL;
+
+	old_cred = override_creds(ff->passthrough_cred);
+	ret = rw_verify_area(READ, passthrough_filp, ppos, len);
+	if (ret >= 0)
+		ret = passthrough_filp->f_op->splice_read(passthrough_filp, ppos,
+							  pipe, ret, flags);
+	revert_creds(old_cred);
+
+	return ret;
+}
+
+/*
+ * Map the lower file instead, so that page faults never reach the fuse
+ * page cache.  The vma takes over the reference mmap_region() got on
+ * @file only once the lower mmap has succeeded.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *passthrough_filp = ff->passthrough_filp;
+	int err;
+
+	if (!passthrough_filp->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = get_file(passthrough_filp);
+	err = passthrough_filp->f_op->mmap(passthrough_filp, vma);
+	if (err) {
+		vma->vm_file = file;
+		fput(passthrough_filp);
+		return err;
+	}
+	fput(file);
+
+	return 0;
+}
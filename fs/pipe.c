@@ -39,6 +39,20 @@ unsigned int pipe_max_size = 1048576;
  */
 unsigned int pipe_min_size = PAGE_SIZE;
 
+/*
+ * The size a pipe grows to on its own when writers keep finding it full.
+ * Can be set by root in /proc/sys/fs/pipe-max-auto-size
+ */
+unsigned int pipe_max_auto_size = 262144;
+
+/*
+ * A pipe that is still full after its readers took PIPE_GROW_TURNS times
+ * its size out of it within PIPE_GROW_WINDOW moves 80 times its size per
+ * second or more.
+ */
+#define PIPE_GROW_TURNS		8
+#define PIPE_GROW_WINDOW	(HZ / 10)
+
 /*
  * We use a start+len construction, which provides full use of the 
  * allocated memory.
@@ -428,6 +442,7 @@ redo:
 			ret += chars;
 			buf->offset += chars;
 			buf->len -= chars;
+			pipe->drained += chars;
 
 			/* Was it a packet buffer? Clean up and exit */
 			if (buf->flags & PIPE_BUF_FLAG_PACKET) {
@@ -590,6 +605,11 @@ redo1:
 			 * FIXME! Is this really true?
 			 */
 			do_wakeup = 1;
+			/*
+			 * Even page aligned data is copied: do_wp_page() would
+			 * let the writer scribble over a page queued here by
+			 * reference. vmsplice() is the zero-copy way in.
+			 */
 			chars = PAGE_SIZE;
 			if (chars > total_len)
 				chars = total_len;
@@ -653,6 +673,7 @@ redo2:
 			kill_fasync(&pipe->fasync_readers, SIGIO, POLL_IN);
 			do_wakeup = 0;
 		}
+		pipe_note_full(pipe);
 		pipe->waiting_writers++;
 		pipe_wait(pipe);
 		pipe->waiting_writers--;
@@ -793,6 +814,7 @@ struct pipe_inode_info *alloc_pipe_info(void)
 			init_waitqueue_head(&pipe->wait);
 			pipe->r_counter = pipe->w_counter = 1;
 			pipe->buffers = PIPE_DEF_BUFFERS;
+			pipe->auto_size = true;
 			mutex_init(&pipe->mutex);
 			return pipe;
 		}
@@ -1203,6 +1225,43 @@ static long pipe_set_size(struct pipe_inode_info *pipe, unsigned long nr_pages)
 	return nr_pages * PAGE_SIZE;
 }
 
+/**
+ * pipe_note_full - a writer is about to wait for room in a full pipe
+ * @pipe:	the pipe, locked
+ *
+ * A pipe that is full again although its readers moved many times its
+ * size out of it lately carries more data than its ring holds between
+ * two wakeups. Double the ring then, up to pipe_max_auto_size, so that
+ * each wakeup moves more data. A pipe that is full because its reader
+ * is slow has moved little and keeps its size, as do pipes sized with
+ * F_SETPIPE_SZ.
+ */
+void pipe_note_full(struct pipe_inode_info *pipe)
+{
+	unsigned int nr_pages;
+
+	if (!pipe->auto_size)
+		return;
+
+	if (time_after(jiffies, pipe->full_stamp + PIPE_GROW_WINDOW)) {
+		pipe->full_stamp = jiffies;
+		pipe->drained = 0;
+		return;
+	}
+	if (pipe->drained < (unsigned long)pipe->buffers * PAGE_SIZE *
+			    PIPE_GROW_TURNS)
+		return;
+	pipe->full_stamp = jiffies;
+	pipe->drained = 0;
+
+	nr_pages = pipe->buffers * 2;
+	if (nr_pages > (pipe_max_auto_size >> PAGE_SHIFT)) {
+		pipe->auto_size = false;
+		return;
+	}
+	pipe_set_size(pipe, nr_pages);
+}
+
 /*
  * Currently we rely on the pipe array holding a power-of-2 number
  * of pages.
@@ -1222,13 +1281,14 @@ static inline unsigned int round_pipe_size(unsigned int size)
 int pipe_proc_fn(struct ctl_table *table, int write, void __user *buf,
 		 size_t *lenp, loff_t *ppos)
 {
+	unsigned int *size = table->data;
 	int ret;
 
 	ret = proc_dointvec_minmax(table, write, buf, lenp, ppos);
 	if (ret < 0 || !write)
 		return ret;
 
-	pipe_max_size = round_pipe_size(pipe_max_size);
+	*size = round_pipe_size(*size);
 	return ret;
 }
 
@@ -1269,6 +1329,8 @@ long pipe_fcntl(struct file *file, unsigned int cmd, unsigned long arg)
 			goto out;
 		}
 		ret = pipe_set_size(pipe, nr_pages);
+		if (ret > 0)
+			pipe->auto_size = false;
 		break;
 		}
 	case F_GETPIPE_SZ:
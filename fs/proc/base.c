@@ -2568,6 +2568,47 @@ static int proc_tgid_io_accounting(struct task_struct *task, char *buffer)
 }
 #endif /* CONFIG_TASK_IO_ACCOUNTING */
 
+#ifdef CONFIG_RECLAIM_STATS
+static int do_reclaim_stats(struct task_struct *task, char *buffer, int whole)
+{
+	struct task_reclaim_stats stats = task->reclaim_stats;
+	unsigned long flags;
+	int result;
+
+	result = mutex_lock_killable(&task->signal->cred_guard_mutex);
+	if (result)
+		return result;
+
+	if (!ptrace_may_access(task, PTRACE_MODE_READ)) {
+		result = -EACCES;
+		goto out_unlock;
+	}
+
+	if (whole && lock_task_sighand(task, &flags)) {
+		struct task_struct *t = task;
+
+		while_each_thread(task, t)
+			reclaim_stats_add(&stats, &t->reclaim_stats);
+
+		unlock_task_sighand(task, &flags);
+	}
+	result = reclaim_stats_sprint(buffer, &stats);
+out_unlock:
+	mutex_unlock(&task->signal->cred_guard_mutex);
+	return result;
+}
+
+static int proc_tid_reclaim_stats(struct task_struct *task, char *buffer)
+{
+	return do_reclaim_stats(task, buffer, 0);
+}
+
+static int proc_tgid_reclaim_stats(struct task_struct *task, char *buffer)
+{
+	return do_reclaim_stats(task, buffer, 1);
+}
+#endif /* CONFIG_RECLAIM_STATS */
+
 #ifdef CONFIG_USER_NS
 static int proc_id_map_open(struct inode *inode, struct file *file,
 	struct seq_operations *seq_ops)
@@ -2748,6 +2789,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_TASK_IO_ACCOUNTING
 	INF("io",	S_IRUSR, proc_tgid_io_accounting),
 #endif
+#ifdef CONFIG_RECLAIM_STATS
+	INF("reclaim_stats", S_IRUSR, proc_tgid_reclaim_stats),
+#endif
 #ifdef CONFIG_HARDWALL
 	INF("hardwall",   S_IRUGO, proc_pid_hardwall),
 #endif
@@ -3101,6 +3145,9 @@ static const struct pid_entry tid_base_stuff[] = {
 #ifdef CONFIG_TASK_IO_ACCOUNTING
 	INF("io",	S_IRUSR, proc_tid_io_accounting),
 #endif
+#ifdef CONFIG_RECLAIM_STATS
+	INF("reclaim_stats", S_IRUSR, proc_tid_reclaim_stats),
+#endif
 #ifdef CONFIG_HARDWALL
 	INF("hardwall",   S_IRUGO, proc_pid_hardwall),
 #endif
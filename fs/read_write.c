@@ -329,6 +329,7 @@ int rw_verify_area(int read_write, struct file *file, loff_t *ppos, size_t count
 		return retval;
 	return count > MAX_RW_COUNT ? MAX_RW_COUNT : count;
 }
+EXPORT_SYMBOL_GPL(rw_verify_area);
 
 ssize_t do_sync_read(struct file *filp, char __user *buf, size_t len, loff_t *ppos)
 {
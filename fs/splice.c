@@ -250,6 +250,7 @@ ssize_t splice_to_pipe(struct pipe_inode_info *pipe,
 			do_wakeup = 0;
 		}
 
+		pipe_note_full(pipe);
 		pipe->waiting_writers++;
 		pipe_wait(pipe);
 		pipe->waiting_writers--;
@@ -303,6 +304,25 @@ void splice_shrink_spd(struct splice_pipe_desc *spd)
 	kfree(spd->partial);
 }
 
+/*
+ * A non-blocking splice can only fill the buffers that are free right
+ * now. Pages read or pinned beyond that would be released again, and
+ * data read from a stream would be lost.
+ */
+static unsigned int splice_nonblock_room(const struct pipe_inode_info *pipe,
+					 unsigned int flags,
+					 unsigned int nr_pages)
+{
+	unsigned int buffers = ACCESS_ONCE(pipe->buffers);
+	unsigned int nrbufs = ACCESS_ONCE(pipe->nrbufs);
+
+	if (!(flags & SPLICE_F_NONBLOCK))
+		return nr_pages;
+	if (nrbufs >= buffers)
+		return 0;
+	return min(nr_pages, buffers - nrbufs);
+}
+
 static int
 __generic_file_splice_read(struct file *in, loff_t *ppos,
 			   struct pipe_inode_info *pipe, size_t len,
@@ -611,6 +631,7 @@ ssize_t default_file_splice_read(struct file *in, loff_t *ppos,
 {
 	unsigned int nr_pages;
 	unsigned int nr_freed;
+	unsigned int room;
 	size_t offset;
 	struct page *pages[PIPE_DEF_BUFFERS];
 	struct partial_page partial[PIPE_DEF_BUFFERS];
@@ -631,8 +652,13 @@ ssize_t default_file_splice_read(struct file *in, loff_t *ppos,
 	if (splice_grow_spd(pipe, &spd))
 		return -ENOMEM;
 
-	res = -ENOMEM;
 	vec = __vec;
+	res = -EAGAIN;
+	room = splice_nonblock_room(pipe, flags, spd.nr_pages_max);
+	if (!room)
+		goto shrink_ret;
+
+	res = -ENOMEM;
 	if (spd.nr_pages_max > PIPE_DEF_BUFFERS) {
 		vec = kmalloc(spd.nr_pages_max * sizeof(struct iovec), GFP_KERNEL);
 		if (!vec)
@@ -642,7 +668,7 @@ ssize_t default_file_splice_read(struct file *in, loff_t *ppos,
 	offset = *ppos & ~PAGE_CACHE_MASK;
 	nr_pages = (len + offset + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
 
-	for (i = 0; i < nr_pages && i < spd.nr_pages_max && len; i++) {
+	for (i = 0; i < nr_pages && i < room && len; i++) {
 		struct page *page;
 
 		page = alloc_page(GFP_USER);
@@ -836,6 +862,7 @@ int splice_from_pipe_feed(struct pipe_inode_info *pipe, struct splice_desc *sd,
 
 		buf->offset += ret;
 		buf->len -= ret;
+		pipe->drained += ret;
 
 		sd->num_spliced += ret;
 		sd->len -= ret;
@@ -1653,6 +1680,7 @@ static long vmsplice_to_pipe(struct file *file, const struct iovec __user *iov,
 		.ops = &user_page_pipe_buf_ops,
 		.spd_release = spd_release_page,
 	};
+	unsigned int nr_pages;
 	long ret;
 
 	pipe = get_pipe_info(file);
@@ -1662,14 +1690,19 @@ static long vmsplice_to_pipe(struct file *file, const struct iovec __user *iov,
 	if (splice_grow_spd(pipe, &spd))
 		return -ENOMEM;
 
+	ret = -EAGAIN;
+	nr_pages = splice_nonblock_room(pipe, flags, spd.nr_pages_max);
+	if (!nr_pages)
+		goto out;
+
 	spd.nr_pages = get_iovec_page_array(iov, nr_segs, spd.pages,
-					    spd.partial, false,
-					    spd.nr_pages_max);
+					    spd.partial, false, nr_pages);
 	if (spd.nr_pages <= 0)
 		ret = spd.nr_pages;
 	else
 		ret = splice_to_pipe(pipe, &spd);
 
+out:
 	splice_shrink_spd(&spd);
 	return ret;
 }
@@ -1834,6 +1867,7 @@ static int opipe_prep(struct pipe_inode_info *pipe, unsigned int flags)
 			ret = -ERESTARTSYS;
 			break;
 		}
+		pipe_note_full(pipe);
 		pipe->waiting_writers++;
 		pipe_wait(pipe);
 		pipe->waiting_writers--;
@@ -1939,6 +1973,7 @@ retry:
 			ibuf->offset += obuf->len;
 			ibuf->len -= obuf->len;
 		}
+		ipipe->drained += obuf->len;
 		ret += obuf->len;
 		len -= obuf->len;
 	} while (len);
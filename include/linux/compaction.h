@@ -19,13 +19,22 @@ extern int sysctl_extfrag_threshold;
 extern int sysctl_extfrag_handler(struct ctl_table *table, int write,
 			void __user *buffer, size_t *length, loff_t *ppos);
 
+extern int sysctl_kcompactd_orders;
+extern int sysctl_kcompactd_wakeup_score;
+extern int sysctl_kcompactd_stop_score;
+extern unsigned int sysctl_kcompactd_interval_ms;
+extern int sysctl_kcompactd_interval_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos);
+
 extern int fragmentation_index(struct zone *zone, unsigned int order);
+extern int fragmentation_score(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *mask,
 			bool sync, bool *contended);
 extern void compact_pgdat(pg_data_t *pgdat, int order);
 extern void reset_isolation_suitable(pg_data_t *pgdat);
 extern unsigned long compaction_suitable(struct zone *zone, int order);
+extern void wakeup_kcompactd(struct zone *zone, int order);
 
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
@@ -93,6 +102,10 @@ static inline unsigned long compaction_suitable(struct zone *zone, int order)
 	return COMPACT_SKIPPED;
 }
 
+static inline void wakeup_kcompactd(struct zone *zone, int order)
+{
+}
+
 static inline void defer_compaction(struct zone *zone, int order)
 {
 }
@@ -16,6 +16,8 @@
 #include <linux/device.h>
 #include <linux/notifier.h>
 #include <linux/opp.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 #define DEVFREQ_NAME_LEN 16
 
@@ -263,6 +265,45 @@ struct devfreq_simple_exynos_data {
 };
 #endif
 
+#if IS_ENABLED(CONFIG_DEVFREQ_GOV_BUS_HINT)
+/**
+ * struct devfreq_bus_hint_data - void *data fed to struct devfreq
+ *	and devfreq_add_device for the bus_hint governor
+ * @upthreshold:	If the busy ratio is above this (%), go to the maximum.
+ * @downdifferential:	Keep the current frequency while the busy ratio is
+ *			within this many points below @upthreshold.
+ * @cpu_scale_max:	When the fastest CPU has sped up since the last PPMU
+ *			window, scale the measured busy ratio by the CPU
+ *			frequency ratio, up to this many percent.  0 disables.
+ * @boost_freq:		Minimum frequency while a frame boost is pending.
+ * @pm_qos_class:	PM QoS class of the minimum frequency.
+ * @pm_qos_class_max:	PM QoS class of the maximum frequency, if any.
+ * @cal_qos_max:	Highest frequency chosen from load alone.
+ *
+ * The remaining fields are private to the governor.
+ */
+struct devfreq_bus_hint_data {
+	unsigned int upthreshold;
+	unsigned int downdifferential;
+	unsigned int cpu_scale_max;
+	unsigned long boost_freq;
+	int pm_qos_class;
+	int pm_qos_class_max;
+	unsigned long cal_qos_max;
+
+	struct devfreq_notifier_block nb;
+	struct work_struct work;
+	struct list_head node;
+	unsigned long long last_busy;
+	unsigned long long last_total;
+	unsigned int window_cpu_freq;
+};
+
+extern void devfreq_bus_hint_boost(ktime_t deadline);
+#else
+static inline void devfreq_bus_hint_boost(ktime_t deadline) {}
+#endif
+
 #else /* !CONFIG_PM_DEVFREQ */
 static inline struct devfreq *devfreq_add_device(struct device *dev,
 					  struct devfreq_dev_profile *profile,
@@ -305,6 +346,8 @@ static inline int devfreq_unregister_opp_notifier(struct device *dev,
 	return -EINVAL;
 }
 
+static inline void devfreq_bus_hint_boost(ktime_t deadline) {}
+
 #endif /* CONFIG_PM_DEVFREQ */
 
 #endif /* __LINUX_DEVFREQ_H__ */
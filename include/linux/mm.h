@@ -1656,6 +1656,36 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+/* ra_record.c */
+#ifdef CONFIG_READAHEAD_RECORD
+extern unsigned int ra_record_active;
+void __ra_record_access(struct address_space *mapping, pgoff_t index,
+			bool cached);
+void __ra_record_open(struct file *file);
+
+static inline void ra_record_access(struct address_space *mapping,
+				    pgoff_t index, bool cached)
+{
+	if (unlikely(ra_record_active))
+		__ra_record_access(mapping, index, cached);
+}
+
+static inline void ra_record_open(struct file *file)
+{
+	if (unlikely(ra_record_active))
+		__ra_record_open(file);
+}
+#else
+static inline void ra_record_access(struct address_space *mapping,
+				    pgoff_t index, bool cached)
+{
+}
+
+static inline void ra_record_open(struct file *file)
+{
+}
+#endif
+
 /* Generic expand stack which grows the stack according to GROWS{UP,DOWN} */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 
@@ -264,6 +264,9 @@ struct per_cpu_pageset {
 
 #endif /* !__GENERATING_BOUNDS.H */
 
+/* Upper bound of vm.kswapd_threads */
+#define MAX_KSWAPD_THREADS	4
+
 enum zone_type {
 #ifdef CONFIG_ZONE_DMA
 	/*
@@ -735,9 +738,18 @@ typedef struct pglist_data {
 	nodemask_t reclaim_nodes;	/* Nodes allowed to reclaim from */
 	wait_queue_head_t kswapd_wait;
 	wait_queue_head_t pfmemalloc_wait;
-	struct task_struct *kswapd;	/* Protected by lock_memory_hotplug() */
-	int kswapd_max_order;
-	enum zone_type classzone_idx;
+	/* Protected by lock_memory_hotplug() */
+	struct task_struct *kswapd[MAX_KSWAPD_THREADS];
+	/* Pending reclaim request of each kswapd thread */
+	int kswapd_max_order[MAX_KSWAPD_THREADS];
+	enum zone_type classzone_idx[MAX_KSWAPD_THREADS];
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	bool kcompactd_check;		/* A zone needs its score checked */
+	unsigned int kcompactd_defer;	/* Wakeups left to ignore */
+	unsigned int kcompactd_defer_shift;
+#endif
 #ifdef CONFIG_NUMA_BALANCING
 	/*
 	 * Lock serializing the per destination node AutoNUMA memory
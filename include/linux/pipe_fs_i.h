@@ -42,6 +42,9 @@ struct pipe_buffer {
  *	@fasync_readers: reader side fasync
  *	@fasync_writers: writer side fasync
  *	@bufs: the circular array of pipe buffers
+ *	@drained: bytes readers took out of the pipe since @full_stamp
+ *	@full_stamp: jiffies when @drained started counting
+ *	@auto_size: grow the pipe while it fills up despite busy readers
  **/
 struct pipe_inode_info {
 	struct mutex mutex;
@@ -57,6 +60,9 @@ struct pipe_inode_info {
 	struct fasync_struct *fasync_readers;
 	struct fasync_struct *fasync_writers;
 	struct pipe_buffer *bufs;
+	unsigned long drained;
+	unsigned long full_stamp;
+	bool auto_size;
 };
 
 /*
@@ -139,9 +145,12 @@ void pipe_lock(struct pipe_inode_info *);
 void pipe_unlock(struct pipe_inode_info *);
 void pipe_double_lock(struct pipe_inode_info *, struct pipe_inode_info *);
 
-extern unsigned int pipe_max_size, pipe_min_size;
+extern unsigned int pipe_max_size, pipe_min_size, pipe_max_auto_size;
 int pipe_proc_fn(struct ctl_table *, int, void __user *, size_t *, loff_t *);
 
+/* A writer is about to wait for room in a full pipe */
+void pipe_note_full(struct pipe_inode_info *pipe);
+
 
 /* Drop the inode semaphore and wait for a pipe event, atomically */
 void pipe_wait(struct pipe_inode_info *pipe);
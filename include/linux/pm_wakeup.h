@@ -40,8 +40,9 @@
  * @relax_count: Number of times the wakeup sorce was deactivated.
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
- * @active: Status of the wakeup source.
- * @has_timeout: The wakeup source has been activated with a timeout.
+ * @active: Status of the wakeup source, may be read without @lock.
+ * @autosleep_enabled: Autosleep is active, so track @prevent_sleep_time.
+ * @fts_tp: Touch panel source, ignored unless the fts_tp_wl parameter is set.
  */
 struct wakeup_source {
 	const char 		*name;
@@ -59,8 +60,9 @@ struct wakeup_source {
 	unsigned long		relax_count;
 	unsigned long		expire_count;
 	unsigned long		wakeup_count;
-	bool			active:1;
+	bool			active;
 	bool			autosleep_enabled:1;
+	bool			fts_tp:1;
 };
 
 #ifdef CONFIG_PM_SLEEP
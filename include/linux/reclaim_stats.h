@@ -0,0 +1,75 @@
+#ifndef _LINUX_RECLAIM_STATS_H
+#define _LINUX_RECLAIM_STATS_H
+
+/*
+ * Time spent stalled in direct reclaim and compaction, per task and in
+ * global latency histograms.  Nested items overlap: direct_reclaim
+ * includes the LRU, slab and pageout time spent under it.
+ */
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+
+enum reclaim_stat_item {
+	RECLAIM_STAT_DIRECT,		/* try_to_free_pages() */
+	RECLAIM_STAT_COMPACT,		/* try_to_compact_pages() */
+	RECLAIM_STAT_INACTIVE_ANON,	/* shrink_inactive_list() */
+	RECLAIM_STAT_INACTIVE_FILE,
+	RECLAIM_STAT_SLAB,		/* all shrinkers */
+	RECLAIM_STAT_PAGEOUT_SWAP,	/* swap writeout, zram compression */
+	RECLAIM_STAT_PAGEOUT_FILE,
+	NR_RECLAIM_STAT_ITEMS,
+};
+
+/* Bucket 0 is below 1us, bucket n >= 1 from 2^(n-1)us, the last is open */
+#define RECLAIM_HIST_BUCKETS	16
+
+struct reclaim_hist {
+	atomic_long_t count[RECLAIM_HIST_BUCKETS];
+	atomic64_t total_ns;
+};
+
+struct task_reclaim_stats {
+	u64 ns[NR_RECLAIM_STAT_ITEMS];
+	unsigned long count[NR_RECLAIM_STAT_ITEMS];
+};
+
+struct shrinker;
+struct seq_file;
+
+#ifdef CONFIG_RECLAIM_STATS
+u64 reclaim_stat_start(void);
+void reclaim_stat_end(enum reclaim_stat_item item, u64 start);
+void reclaim_stat_shrinker_end(struct shrinker *shrinker, u64 start);
+void reclaim_hist_show(struct seq_file *m, const char *name,
+		       struct reclaim_hist *hist);
+void shrinker_latency_show(struct seq_file *m);
+int reclaim_stats_sprint(char *buffer, struct task_reclaim_stats *stats);
+
+static inline void reclaim_stats_add(struct task_reclaim_stats *dst,
+				     struct task_reclaim_stats *src)
+{
+	int i;
+
+	for (i = 0; i < NR_RECLAIM_STAT_ITEMS; i++) {
+		dst->ns[i] += src->ns[i];
+		dst->count[i] += src->count[i];
+	}
+}
+#else
+static inline u64 reclaim_stat_start(void)
+{
+	return 0;
+}
+
+static inline void reclaim_stat_end(enum reclaim_stat_item item, u64 start)
+{
+}
+
+static inline void reclaim_stat_shrinker_end(struct shrinker *shrinker,
+					     u64 start)
+{
+}
+#endif
+
+#endif /* _LINUX_RECLAIM_STATS_H */
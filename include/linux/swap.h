@@ -309,8 +309,12 @@ static inline void scan_unevictable_unregister_node(struct node *node)
 }
 #endif
 
+extern int kswapd_threads;
 extern int kswapd_run(int nid);
 extern void kswapd_stop(int nid);
+extern int kswapd_threads_sysctl_handler(struct ctl_table *table, int write,
+					 void __user *buffer, size_t *length,
+					 loff_t *ppos);
 #ifdef CONFIG_MEMCG
 extern int mem_cgroup_swappiness(struct mem_cgroup *mem);
 #else
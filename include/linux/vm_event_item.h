@@ -31,6 +31,10 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		FOR_ALL_ZONES(PGSCAN_KSWAPD),
 		FOR_ALL_ZONES(PGSCAN_DIRECT),
 		PGSCAN_DIRECT_THROTTLE,
+		/* One each per kswapd thread, up to MAX_KSWAPD_THREADS */
+		KSWAPD_PGSCAN_0, KSWAPD_PGSCAN_1, KSWAPD_PGSCAN_2, KSWAPD_PGSCAN_3,
+		KSWAPD_PGSTEAL_0, KSWAPD_PGSTEAL_1, KSWAPD_PGSTEAL_2,
+		KSWAPD_PGSTEAL_3,
 #ifdef CONFIG_NUMA
 		PGSCAN_ZONE_RECLAIM_FAILED,
 #endif
@@ -51,6 +55,7 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		COMPACTMIGRATE_SCANNED, COMPACTFREE_SCANNED,
 		COMPACTISOLATED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		KCOMPACTD_WAKE, KCOMPACTD_FAIL, KCOMPACTD_SUCCESS,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -0,0 +1,50 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM devfreq
+
+#if !defined(_TRACE_DEVFREQ_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_DEVFREQ_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(devfreq_bus_hint,
+	TP_PROTO(const char *name, unsigned int busy, unsigned int cpu_scale,
+		 unsigned long load_freq, unsigned long boost_freq,
+		 unsigned long qos_min, unsigned long qos_max,
+		 unsigned long cur_freq, unsigned long target_freq),
+	TP_ARGS(name, busy, cpu_scale, load_freq, boost_freq, qos_min, qos_max,
+		cur_freq, target_freq),
+
+	TP_STRUCT__entry(
+	    __string(		name,		name		)
+	    __field(unsigned int,	busy		)
+	    __field(unsigned int,	cpu_scale	)
+	    __field(unsigned long,	load_freq	)
+	    __field(unsigned long,	boost_freq	)
+	    __field(unsigned long,	qos_min		)
+	    __field(unsigned long,	qos_max		)
+	    __field(unsigned long,	cur_freq	)
+	    __field(unsigned long,	target_freq	)
+	),
+
+	TP_fast_assign(
+	    __assign_str(name, name);
+	    __entry->busy = busy;
+	    __entry->cpu_scale = cpu_scale;
+	    __entry->load_freq = load_freq;
+	    __entry->boost_freq = boost_freq;
+	    __entry->qos_min = qos_min;
+	    __entry->qos_max = qos_max;
+	    __entry->cur_freq = cur_freq;
+	    __entry->target_freq = target_freq;
+	),
+
+	TP_printk("%s busy=%u%% cpu_scale=%u%% load=%lu boost=%lu qos=%lu-%lu cur=%lu target=%lu",
+		  __get_str(name), __entry->busy, __entry->cpu_scale,
+		  __entry->load_freq, __entry->boost_freq, __entry->qos_min,
+		  __entry->qos_max, __entry->cur_freq, __entry->target_freq)
+);
+
+#endif /* _TRACE_DEVFREQ_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
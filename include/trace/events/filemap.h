@@ -52,6 +52,57 @@ DEFINE_EVENT(mm_filemap_op_page_cache, mm_filemap_add_to_page_cache,
 	TP_ARGS(page)
 	);
 
+TRACE_EVENT(mm_filemap_replay,
+
+	TP_PROTO(struct inode *inode, unsigned long nr_pages),
+
+	TP_ARGS(inode, nr_pages),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, i_ino)
+		__field(dev_t, s_dev)
+		__field(unsigned long, nr_pages)
+	),
+
+	TP_fast_assign(
+		__entry->i_ino = inode->i_ino;
+		__entry->s_dev = inode->i_sb->s_dev;
+		__entry->nr_pages = nr_pages;
+	),
+
+	TP_printk("dev %d:%d ino %lx nr_pages=%lu",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino,
+		__entry->nr_pages)
+);
+
+TRACE_EVENT(mm_filemap_replay_access,
+
+	TP_PROTO(struct inode *inode, pgoff_t index, bool hit),
+
+	TP_ARGS(inode, index, hit),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, i_ino)
+		__field(dev_t, s_dev)
+		__field(unsigned long, index)
+		__field(bool, hit)
+	),
+
+	TP_fast_assign(
+		__entry->i_ino = inode->i_ino;
+		__entry->s_dev = inode->i_sb->s_dev;
+		__entry->index = index;
+		__entry->hit = hit;
+	),
+
+	TP_printk("dev %d:%d ino %lx ofs=%lu %s",
+		MAJOR(__entry->s_dev), MINOR(__entry->s_dev),
+		__entry->i_ino,
+		__entry->index << PAGE_SHIFT,
+		__entry->hit ? "hit" : "miss")
+);
+
 #endif /* _TRACE_FILEMAP_H */
 
 /* This part must be outside protection */
@@ -93,6 +93,8 @@
  *
  * 7.22
  *  - add FUSE_ASYNC_DIO
+ *  - add FUSE_PASSTHROUGH and FOPEN_PASSTHROUGH
+ *  - add FUSE_DEV_IOC_CLONE
  */
 
 #ifndef _LINUX_FUSE_H
@@ -103,6 +105,7 @@
 #else
 #include <stdint.h>
 #endif
+#include <linux/ioctl.h>
 
 /*
  * Version negotiation:
@@ -195,10 +198,12 @@ struct fuse_file_lock {
  * FOPEN_DIRECT_IO: bypass page cache for this open file
  * FOPEN_KEEP_CACHE: don't invalidate the data cache on open
  * FOPEN_NONSEEKABLE: the file is not seekable
+ * FOPEN_PASSTHROUGH: read, write and mmap go straight to passthrough_fd
  */
 #define FOPEN_DIRECT_IO		(1 << 0)
 #define FOPEN_KEEP_CACHE	(1 << 1)
 #define FOPEN_NONSEEKABLE	(1 << 2)
+#define FOPEN_PASSTHROUGH	(1 << 31)
 
 /**
  * INIT request/reply flags
@@ -219,6 +224,7 @@ struct fuse_file_lock {
  * FUSE_DO_READDIRPLUS: do READDIRPLUS (READDIR+LOOKUP in one)
  * FUSE_READDIRPLUS_AUTO: adaptive readdirplus
  * FUSE_ASYNC_DIO: asynchronous direct I/O submission
+ * FUSE_PASSTHROUGH: kernel supports FOPEN_PASSTHROUGH open replies
  */
 #define FUSE_ASYNC_READ		(1 << 0)
 #define FUSE_POSIX_LOCKS	(1 << 1)
@@ -236,6 +242,7 @@ struct fuse_file_lock {
 #define FUSE_DO_READDIRPLUS	(1 << 13)
 #define FUSE_READDIRPLUS_AUTO	(1 << 14)
 #define FUSE_ASYNC_DIO		(1 << 15)
+#define FUSE_PASSTHROUGH	(1 << 31)
 
 /**
  * CUSE INIT request/reply flags
@@ -460,7 +467,7 @@ struct fuse_create_in {
 struct fuse_open_out {
 	uint64_t	fh;
 	uint32_t	open_flags;
-	uint32_t	padding;
+	int32_t		passthrough_fd;
 };
 
 struct fuse_release_in {
@@ -730,4 +737,14 @@ struct fuse_notify_retrieve_in {
 	uint64_t	dummy4;
 };
 
+/*
+ * Device ioctls
+ *
+ * FUSE_DEV_IOC_CLONE: attach the /dev/fuse file this is issued on to the
+ * connection of the /dev/fuse file descriptor passed as the argument, as
+ * an additional channel with a request queue of its own
+ */
+#define FUSE_DEV_IOC_MAGIC		229
+#define FUSE_DEV_IOC_CLONE		_IOR(FUSE_DEV_IOC_MAGIC, 0, uint32_t)
+
 #endif /* _LINUX_FUSE_H */
@@ -0,0 +1,41 @@
+#ifndef _UAPI_LINUX_WAKEUP_STATS_H
+#define _UAPI_LINUX_WAKEUP_STATS_H
+
+#include <linux/types.h>
+
+/*
+ * Binary snapshot of the wakeup source statistics, read from
+ * <debugfs>/wakeup_sources_snapshot.  The file starts with a header
+ * followed by nr_records fixed size records, one per registered wakeup
+ * source.  Readers must step through the records by record_size so that
+ * fields appended in later versions can be skipped.
+ */
+
+#define WAKEUP_STATS_MAGIC	0x57414b45	/* "WAKE" */
+#define WAKEUP_STATS_VERSION	1
+#define WAKEUP_STATS_NAME_LEN	48
+
+struct wakeup_stats_header {
+	__u32	magic;
+	__u32	version;
+	__u32	record_size;
+	__u32	nr_records;
+	__s64	timestamp_ns;		/* ktime_get() at snapshot time */
+};
+
+struct wakeup_stats_record {
+	char	name[WAKEUP_STATS_NAME_LEN];
+	__u64	active_count;
+	__u64	event_count;
+	__u64	wakeup_count;
+	__u64	expire_count;
+	__s64	active_time_ns;		/* 0 unless the source is active */
+	__s64	total_time_ns;
+	__s64	max_time_ns;
+	__s64	last_change_ns;
+	__s64	prevent_sleep_time_ns;
+	__u32	active;
+	__u32	reserved;
+};
+
+#endif /* _UAPI_LINUX_WAKEUP_STATS_H */
@@ -15,6 +15,7 @@
 #include <linux/sched.h>
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
+#include <linux/cpuidle.h>
 #include <linux/exynos-ss.h>
 
 #include <trace/events/irq.h>
@@ -176,6 +177,7 @@ handle_irq_event_percpu(struct irq_desc *desc, struct irqaction *action)
 	} while (action);
 
 	add_interrupt_randomness(irq, flags);
+	cpuidle_predict_irq(irq);
 
 	if (!noirqdebug)
 		note_interrupt(irq, desc, retval);
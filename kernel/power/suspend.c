@@ -60,7 +60,13 @@ static void freeze_enter(void)
 void freeze_wake(void)
 {
 	suspend_freeze_wake = true;
-	wake_up(&suspend_freeze_wait_head);
+	/*
+	 * This runs on every wakeup source activation, so only take the wait
+	 * queue lock while freeze_enter() is actually sleeping.
+	 */
+	smp_mb();
+	if (waitqueue_active(&suspend_freeze_wait_head))
+		wake_up(&suspend_freeze_wait_head);
 }
 EXPORT_SYMBOL_GPL(freeze_wake);
 
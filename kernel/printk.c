@@ -44,6 +44,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include "printk_interface.h"
 
@@ -235,6 +236,21 @@ struct log {
 #endif
 };
 
+/*
+ * Where and when printk() was called. Records staged in the per-CPU
+ * buffers carry this until another CPU merges them into the log buffer.
+ */
+struct log_origin {
+	u64 ts_nsec;		/* timestamp in nanoseconds */
+	struct task_struct *task; /* caller, compared but never dereferenced */
+#ifdef CONFIG_PRINTK_PROCESS
+	char process[16];	/* process name */
+	pid_t pid;		/* process id */
+	u8 cpu;			/* cpu id */
+	u8 in_interrupt;	/* interrupt context */
+#endif
+};
+
 /*
  * The logbuf_lock protects kmsg buffer, indices, counters. It is also
  * used in interesting ways to provide interlocking in console_unlock();
@@ -402,8 +418,24 @@ static void emit_log_char(char c)
 #endif
 
 
+static void log_origin_init(struct log_origin *origin)
+{
+	origin->ts_nsec = local_clock();
+	origin->task = current;
+#ifdef CONFIG_PRINTK_PROCESS
+	if (printk_process) {
+		strncpy(origin->process, current->comm,
+			sizeof(origin->process));
+		origin->pid = task_pid_nr(current);
+		origin->cpu = smp_processor_id();
+		origin->in_interrupt = in_interrupt() ? 1 : 0;
+	}
+#endif
+}
+
 /* insert record into the buffer, discard old ones, update heads */
-static void log_store(int facility, int level,
+static void log_store(const struct log_origin *origin,
+		      int facility, int level,
 		      enum log_flags flags, u64 ts_nsec,
 		      const char *dict, u16 dict_len,
 		      const char *text, u16 text_len)
@@ -454,16 +486,16 @@ static void log_store(int facility, int level,
 	if (ts_nsec > 0)
 		msg->ts_nsec = ts_nsec;
 	else
-		msg->ts_nsec = local_clock();
+		msg->ts_nsec = origin->ts_nsec;
 	memset(log_dict(msg) + dict_len, 0, pad_len);
 	msg->len = sizeof(struct log) + text_len + dict_len + pad_len;
 
 #ifdef CONFIG_PRINTK_PROCESS
 	if (printk_process) {
-		strncpy(msg->process, current->comm, sizeof(msg->process));
-		msg->pid = task_pid_nr(current);
-		msg->cpu = smp_processor_id();
-		msg->in_interrupt = in_interrupt() ? 1 : 0;
+		memcpy(msg->process, origin->process, sizeof(msg->process));
+		msg->pid = origin->pid;
+		msg->cpu = origin->cpu;
+		msg->in_interrupt = origin->in_interrupt;
 	}
 #endif
 
@@ -1155,6 +1187,8 @@ static int syslog_print(char __user *buf, int size)
 	return len;
 }
 
+static bool log_stage_flush(void);
+
 static int syslog_print_all(char __user *buf, int size, bool clear)
 {
 	char *text;
@@ -1164,6 +1198,7 @@ static int syslog_print_all(char __user *buf, int size, bool clear)
 	if (!text)
 		return -ENOMEM;
 
+	log_stage_flush();
 	raw_spin_lock_irq(&logbuf_lock);
 	if (buf) {
 		u64 next_seq;
@@ -1539,7 +1574,7 @@ static struct cont {
 	char buf[LOG_LINE_MAX];
 	size_t len;			/* length == 0 means unused buffer */
 	size_t cons;			/* bytes written to console */
-	struct task_struct *owner;	/* task of first print*/
+	struct log_origin origin;	/* origin of first print */
 	u64 ts_nsec;			/* time of first print */
 	u8 level;			/* log level of first message */
 	u8 facility;			/* log level of first message */
@@ -1560,8 +1595,9 @@ static void cont_flush(enum log_flags flags)
 		 * console; wait for the console to pick up the rest of the
 		 * line. LOG_NOCONS suppresses a duplicated output.
 		 */
-		log_store(cont.facility, cont.level, flags | LOG_NOCONS,
-			  cont.ts_nsec, NULL, 0, cont.buf, cont.len);
+		log_store(&cont.origin, cont.facility, cont.level,
+			  flags | LOG_NOCONS, cont.ts_nsec, NULL, 0,
+			  cont.buf, cont.len);
 		cont.flags = flags;
 		cont.flushed = true;
 	} else {
@@ -1569,13 +1605,14 @@ static void cont_flush(enum log_flags flags)
 		 * If no fragment of this line ever reached the console,
 		 * just submit it to the store and free the buffer.
 		 */
-		log_store(cont.facility, cont.level, flags, 0,
+		log_store(&cont.origin, cont.facility, cont.level, flags, 0,
 			  NULL, 0, cont.buf, cont.len);
 		cont.len = 0;
 	}
 }
 
-static bool cont_add(int facility, int level, const char *text, size_t len)
+static bool cont_add(const struct log_origin *origin,
+		     int facility, int level, const char *text, size_t len)
 {
 	if (cont.len && cont.flushed)
 		return false;
@@ -1589,8 +1626,8 @@ static bool cont_add(int facility, int level, const char *text, size_t len)
 	if (!cont.len) {
 		cont.facility = facility;
 		cont.level = level;
-		cont.owner = current;
-		cont.ts_nsec = local_clock();
+		cont.origin = *origin;
+		cont.ts_nsec = origin->ts_nsec;
 		cont.flags = 0;
 		cont.cons = 0;
 		cont.flushed = false;
@@ -1635,19 +1672,310 @@ static size_t cont_print_text(char *text, size_t size)
 	return textlen;
 }
 
+/*
+ * Commit a parsed printk() message to the continuation buffer or the
+ * record buffer. The 'logbuf_lock' must be held.
+ */
+static void log_output(const struct log_origin *origin,
+		       int facility, int level, enum log_flags lflags,
+		       const char *dict, size_t dictlen,
+		       const char *text, size_t text_len)
+{
+	if (!(lflags & LOG_NEWLINE)) {
+		/*
+		 * Flush the conflicting buffer. An earlier newline was missing,
+		 * or another task also prints continuation lines.
+		 */
+		if (cont.len && (lflags & LOG_PREFIX ||
+				 cont.origin.task != origin->task))
+			cont_flush(LOG_NEWLINE);
+
+		/* buffer line if possible, otherwise store it right away */
+		if (!cont_add(origin, facility, level, text, text_len))
+			log_store(origin, facility, level, lflags | LOG_CONT, 0,
+				  dict, dictlen, text, text_len);
+	} else {
+		bool stored = false;
+
+		/*
+		 * If an earlier newline was missing and it was the same task,
+		 * either merge it with the current buffer and flush, or if
+		 * there was a race with interrupts (prefix == true) then just
+		 * flush it out and store this line separately.
+		 */
+		if (cont.len && cont.origin.task == origin->task) {
+			if (!(lflags & LOG_PREFIX))
+				stored = cont_add(origin, facility, level,
+						  text, text_len);
+			cont_flush(LOG_NEWLINE);
+		}
+
+		if (!stored)
+			log_store(origin, facility, level, lflags, 0,
+				  dict, dictlen, text, text_len);
+	}
+}
+
+/*
+ * Per-CPU staging buffers.
+ *
+ * Once the system runs, printk() does not take 'logbuf_lock' nor call
+ * the consoles. The message is formatted and appended to a buffer that
+ * only the calling CPU writes, with interrupts disabled, and the printk
+ * kthread merges the buffers into the record buffer and prints them.
+ * Each record draws a number from log_stage_seq just before it becomes
+ * visible; the merge takes the lowest number first, so records reach
+ * the record buffer in the order they were printed on any CPU.
+ *
+ * printk() stores the message itself, like it always did, while
+ * booting, during an oops or shutdown, when the buffer of its CPU is
+ * full and with printk.synchronous=1. It first merges what is staged, so
+ * the order is kept.
+ */
+#define LOG_STAGE_SIZE		(1 << CONFIG_LOG_CPU_BUF_SHIFT)
+#define LOG_STAGE_ALIGN		8
+#define LOG_STAGE_BATCH		32	/* records merged per lock hold */
+#define LOG_STAGE_SPINS		1000	/* wait for an unpublished record */
+
+struct log_stage_rec {
+	u16 len;		/* length of entire record, 0 wraps */
+	u16 text_len;		/* length of text buffer */
+	u16 dict_len;		/* length of dictionary buffer */
+	u8 facility;		/* syslog facility */
+	u8 flags:5;		/* internal record flags */
+	u8 level:3;		/* syslog level */
+	u32 seq;		/* merge order */
+	struct log_origin origin;
+};
+
+struct log_stage {
+	u32 head;		/* written by the owning CPU only */
+	u32 tail;		/* written under 'logbuf_lock' only */
+	char buf[LOG_STAGE_SIZE] __aligned(LOG_STAGE_ALIGN);
+};
+
+static DEFINE_PER_CPU(struct log_stage, log_stage);
+static atomic_t log_stage_seq = ATOMIC_INIT(0);
+/* the next number to merge, protected by 'logbuf_lock' */
+static u32 log_stage_next = 1;
+
+/* printk() of this CPU is formatting or staging a message */
+static DEFINE_PER_CPU(int, printk_busy);
+static DEFINE_PER_CPU(char [LOG_LINE_MAX], printk_textbuf);
+static DEFINE_PER_CPU(bool, printk_line_start) = true;
+
+static struct task_struct *printk_kthread;
+static bool __read_mostly printk_synchronous;
+module_param_named(synchronous, printk_synchronous, bool, S_IRUGO | S_IWUSR);
+
+static void wake_up_printk_kthread(void);
+
+static bool log_stage_enabled(void)
+{
+	return printk_kthread && !printk_synchronous && !oops_in_progress &&
+	       system_state == SYSTEM_RUNNING;
+}
+
+/* append a record to the buffer of this CPU; interrupts are disabled */
+static bool log_stage_store(const struct log_origin *origin,
+			    int facility, int level, enum log_flags flags,
+			    const char *dict, size_t dict_len,
+			    const char *text, size_t text_len)
+{
+	struct log_stage *s = &__get_cpu_var(log_stage);
+	struct log_stage_rec *rec;
+	u32 head = s->head;
+	u32 off = head & (LOG_STAGE_SIZE - 1);
+	u32 size, room;
+
+	size = ALIGN(sizeof(*rec) + text_len + dict_len, LOG_STAGE_ALIGN);
+	if (size > LOG_STAGE_SIZE / 2)
+		return false;
+
+	room = size;
+	if (off + size > LOG_STAGE_SIZE)
+		room += LOG_STAGE_SIZE - off;
+	if (LOG_STAGE_SIZE - (head - ACCESS_ONCE(s->tail)) < room)
+		return false;
+	/* pairs with smp_mb() in log_stage_drain() before the tail moves */
+	smp_mb();
+
+	if (off + size > LOG_STAGE_SIZE) {
+		/* a zero length header wraps around to the start */
+		((struct log_stage_rec *)(s->buf + off))->len = 0;
+		head += LOG_STAGE_SIZE - off;
+		off = 0;
+	}
+
+	rec = (struct log_stage_rec *)(s->buf + off);
+	rec->len = size;
+	rec->text_len = text_len;
+	rec->dict_len = dict_len;
+	rec->facility = facility;
+	rec->flags = flags & 0x1f;
+	rec->level = level & 7;
+	rec->origin = *origin;
+	memcpy(rec + 1, text, text_len);
+	memcpy((char *)(rec + 1) + text_len, dict, dict_len);
+
+	rec->seq = atomic_inc_return(&log_stage_seq);
+	smp_wmb();
+	ACCESS_ONCE(s->head) = head + size;
+
+	return true;
+}
+
+/* oldest published record of a buffer, or NULL */
+static struct log_stage_rec *log_stage_peek(struct log_stage *s)
+{
+	u32 head = ACCESS_ONCE(s->head);
+	struct log_stage_rec *rec;
+
+	/* pairs with smp_wmb() in log_stage_store() */
+	smp_rmb();
+	while (s->tail != head) {
+		u32 off = s->tail & (LOG_STAGE_SIZE - 1);
+
+		rec = (struct log_stage_rec *)(s->buf + off);
+		if (rec->len)
+			return rec;
+		s->tail += LOG_STAGE_SIZE - off;
+	}
+	return NULL;
+}
+
+static bool log_stage_pending(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct log_stage *s = &per_cpu(log_stage, cpu);
+
+		if (ACCESS_ONCE(s->head) != ACCESS_ONCE(s->tail))
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Merge up to @budget staged records into the record buffer, oldest
+ * first. Returns true if any was merged. The 'logbuf_lock' must be held.
+ */
+static bool log_stage_drain(unsigned int budget)
+{
+	unsigned int spins = 0;
+	bool merged = false;
+
+	while (budget) {
+		struct log_stage *s, *oldest_s = NULL;
+		struct log_stage_rec *rec, *oldest = NULL;
+		char *text;
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			s = &per_cpu(log_stage, cpu);
+			rec = log_stage_peek(s);
+			if (rec && (!oldest || (s32)(rec->seq - oldest->seq) < 0)) {
+				oldest = rec;
+				oldest_s = s;
+			}
+		}
+		if (!oldest)
+			break;
+
+		/*
+		 * Another CPU may have drawn a lower number and not published
+		 * its record yet. It does so with interrupts disabled, right
+		 * away, so wait for it a little.
+		 */
+		if ((s32)(oldest->seq - log_stage_next) > 0 &&
+		    spins++ < LOG_STAGE_SPINS) {
+			cpu_relax();
+			continue;
+		}
+		spins = 0;
+
+		text = (char *)(oldest + 1);
+		log_output(&oldest->origin, oldest->facility, oldest->level,
+			   oldest->flags, text + oldest->text_len,
+			   oldest->dict_len, text, oldest->text_len);
+		log_stage_next = oldest->seq + 1;
+
+		/* done reading before the CPU may write the space again */
+		smp_mb();
+		oldest_s->tail += oldest->len;
+		merged = true;
+		budget--;
+	}
+	return merged;
+}
+
+/* merge everything staged so far into the record buffer */
+static bool log_stage_flush(void)
+{
+	unsigned long flags;
+	bool merged = false;
+
+	do {
+		raw_spin_lock_irqsave(&logbuf_lock, flags);
+		if (!log_stage_drain(LOG_STAGE_BATCH)) {
+			raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+			break;
+		}
+		raw_spin_unlock_irqrestore(&logbuf_lock, flags);
+		merged = true;
+	} while (1);
+
+	return merged;
+}
+
+static int printk_kthread_func(void *unused)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!log_stage_pending())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		if (log_stage_flush() && waitqueue_active(&log_wait))
+			wake_up_interruptible(&log_wait);
+
+		if (console_trylock())
+			console_unlock();
+	}
+	return 0;
+}
+
+/* insert "[cN] " after the level header of the text */
+static size_t printk_insert_core_num(char *text, size_t text_len, int cpu)
+{
+	size_t skip = printk_get_level(text) ? 2 : 0;
+	char num[16];
+	size_t n;
+
+	n = snprintf(num, sizeof(num), "[c%d] ", cpu);
+	if (text_len + n > LOG_LINE_MAX - 1)
+		text_len = LOG_LINE_MAX - 1 - n;
+	memmove(text + skip + n, text + skip, text_len - skip);
+	memcpy(text + skip, num, n);
+	text_len += n;
+	text[text_len] = '\0';
+
+	return text_len;
+}
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
 {
 	static int recursion_bug;
-	static char textbuf[LOG_LINE_MAX];
-	char *text = textbuf;
+	struct log_origin origin;
+	char *text;
 	size_t text_len;
 	enum log_flags lflags = 0;
 	unsigned long flags;
 	int this_cpu;
 	int printed_len = 0;
-	static bool prev_new_line = true;
 
 	// if printk mode is disabled, terminate instantly
 	if (printk_mode == 0)
@@ -1663,7 +1991,7 @@ asmlinkage int vprintk_emit(int facility, int level,
 	/*
 	 * Ouch, printk recursed into itself!
 	 */
-	if (unlikely(logbuf_cpu == this_cpu)) {
+	if (unlikely(logbuf_cpu == this_cpu || __this_cpu_read(printk_busy))) {
 		/*
 		 * If a crash is occurring during printk() on this CPU,
 		 * then try to get the crash message out but make sure
@@ -1677,41 +2005,18 @@ asmlinkage int vprintk_emit(int facility, int level,
 		}
 		zap_locks();
 	}
+	__this_cpu_write(printk_busy, 1);
 
-	lockdep_off();
-	raw_spin_lock(&logbuf_lock);
-	logbuf_cpu = this_cpu;
-
-	if (recursion_bug) {
-		static const char recursion_msg[] =
-			"BUG: recent printk recursion!";
-
-		recursion_bug = 0;
-		printed_len += strlen(recursion_msg);
-		/* emit KERN_CRIT message */
-		log_store(0, 2, LOG_PREFIX|LOG_NEWLINE, 0,
-			  NULL, 0, recursion_msg, printed_len);
-	}
+	log_origin_init(&origin);
 
 	/*
 	 * The printf needs to come first; we need the syslog
 	 * prefix which might be passed-in as a parameter.
 	 */
-	if (printk_core_num && prev_new_line) {
-		char tempbuf[LOG_LINE_MAX];
-		char *temp = tempbuf;
-
-		vscnprintf(temp, sizeof(tempbuf), fmt, args);
-		if (printk_get_level(tempbuf))
-			text_len = snprintf(text, sizeof(textbuf),
-					    "%c%c[c%d] %s", tempbuf[0],
-					    tempbuf[1], this_cpu, &tempbuf[2]);
-		else
-			text_len = snprintf(text, sizeof(textbuf), "[c%d] %s",
-					    this_cpu, &tempbuf[0]);
-	} else {
-		text_len = vscnprintf(text, sizeof(textbuf), fmt, args);
-	}
+	text = __get_cpu_var(printk_textbuf);
+	text_len = vscnprintf(text, LOG_LINE_MAX, fmt, args);
+	if (printk_core_num && __this_cpu_read(printk_line_start))
+		text_len = printk_insert_core_num(text, text_len, this_cpu);
 
 #ifdef	CONFIG_DEBUG_LL
 	printascii(text);
@@ -1721,9 +2026,9 @@ asmlinkage int vprintk_emit(int facility, int level,
 	if (text_len && text[text_len-1] == '\n') {
 		text_len--;
 		lflags |= LOG_NEWLINE;
-		prev_new_line = true;
+		__this_cpu_write(printk_line_start, true);
 	} else {
-		prev_new_line = false;
+		__this_cpu_write(printk_line_start, false);
 	}
 
 	/* strip kernel syslog prefix and extract log level or control flags */
@@ -1756,37 +2061,37 @@ asmlinkage int vprintk_emit(int facility, int level,
 	if (dict)
 		lflags |= LOG_PREFIX|LOG_NEWLINE;
 
-	if (!(lflags & LOG_NEWLINE)) {
-		/*
-		 * Flush the conflicting buffer. An earlier newline was missing,
-		 * or another task also prints continuation lines.
-		 */
-		if (cont.len && (lflags & LOG_PREFIX || cont.owner != current))
-			cont_flush(LOG_NEWLINE);
+	/* leave the record buffer and the consoles to the printk kthread */
+	if (!recursion_bug && log_stage_enabled() &&
+	    log_stage_store(&origin, facility, level, lflags,
+			    dict, dictlen, text, text_len)) {
+		__this_cpu_write(printk_busy, 0);
+		wake_up_printk_kthread();
+		printed_len = text_len;
+		goto out_restore_irqs;
+	}
+	__this_cpu_write(printk_busy, 0);
 
-		/* buffer line if possible, otherwise store it right away */
-		if (!cont_add(facility, level, text, text_len))
-			log_store(facility, level, lflags | LOG_CONT, 0,
-				  dict, dictlen, text, text_len);
-	} else {
-		bool stored = false;
+	lockdep_off();
+	raw_spin_lock(&logbuf_lock);
+	logbuf_cpu = this_cpu;
 
-		/*
-		 * If an earlier newline was missing and it was the same task,
-		 * either merge it with the current buffer and flush, or if
-		 * there was a race with interrupts (prefix == true) then just
-		 * flush it out and store this line separately.
-		 */
-		if (cont.len && cont.owner == current) {
-			if (!(lflags & LOG_PREFIX))
-				stored = cont_add(facility, level, text, text_len);
-			cont_flush(LOG_NEWLINE);
-		}
+	if (recursion_bug) {
+		static const char recursion_msg[] =
+			"BUG: recent printk recursion!";
 
-		if (!stored)
-			log_store(facility, level, lflags, 0,
-				  dict, dictlen, text, text_len);
+		recursion_bug = 0;
+		printed_len += strlen(recursion_msg);
+		/* emit KERN_CRIT message */
+		log_store(&origin, 0, 2, LOG_PREFIX|LOG_NEWLINE, 0,
+			  NULL, 0, recursion_msg, printed_len);
 	}
+
+	/* what other CPUs staged so far was printed before this message */
+	log_stage_drain(UINT_MAX);
+
+	log_output(&origin, facility, level, lflags,
+		   dict, dictlen, text, text_len);
 	printed_len += text_len;
 
 	/*
@@ -1879,6 +2184,7 @@ EXPORT_SYMBOL(printk);
 
 #define LOG_LINE_MAX		0
 #define PREFIX_MAX		0
+#define LOG_STAGE_BATCH		0
 #define LOG_LINE_MAX 0
 static u64 syslog_seq;
 static u32 syslog_idx;
@@ -1901,6 +2207,8 @@ static void call_console_drivers(int level, const char *text, size_t len) {}
 static size_t msg_print_text(const struct log *msg, enum log_flags prev,
 			     bool syslog, char *buf, size_t size) { return 0; }
 static size_t cont_print_text(char *text, size_t size) { return 0; }
+static bool log_stage_pending(void) { return false; }
+static bool log_stage_drain(unsigned int budget) { return false; }
 
 #endif /* CONFIG_PRINTK */
 
@@ -2248,6 +2556,7 @@ again:
 		int level;
 
 		raw_spin_lock_irqsave(&logbuf_lock, flags);
+		log_stage_drain(LOG_STAGE_BATCH);
 		if (seen_seq != log_next_seq) {
 			wake_klogd = true;
 			seen_seq = log_next_seq;
@@ -2316,7 +2625,7 @@ skip:
 	 * flush, no worries.
 	 */
 	raw_spin_lock(&logbuf_lock);
-	retry = console_seq != log_next_seq;
+	retry = console_seq != log_next_seq || log_stage_pending();
 	raw_spin_unlock_irqrestore(&logbuf_lock, flags);
 
 	if (retry && console_trylock())
@@ -2642,6 +2951,11 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+#ifdef CONFIG_PRINTK
+	printk_kthread = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(printk_kthread))
+		printk_kthread = NULL;
+#endif
 	return 0;
 }
 late_initcall(printk_late_init);
@@ -2654,6 +2968,7 @@ late_initcall(printk_late_init);
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_OUTPUT	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
@@ -2669,6 +2984,9 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 
 	if (pending & PRINTK_PENDING_WAKEUP)
 		wake_up_interruptible(&log_wait);
+
+	if (pending & PRINTK_PENDING_OUTPUT)
+		wake_up_process(printk_kthread);
 }
 
 static DEFINE_PER_CPU(struct irq_work, wake_up_klogd_work) = {
@@ -2686,6 +3004,16 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
+/*
+ * printk() may run under the runqueue locks, so the kthread is woken from
+ * irq_work. Called with interrupts disabled.
+ */
+static void wake_up_printk_kthread(void)
+{
+	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+	irq_work_queue(&__get_cpu_var(wake_up_klogd_work));
+}
+
 int printk_deferred(const char *fmt, ...)
 {
 	unsigned long flags;
@@ -2823,6 +3151,8 @@ void kmsg_dump(enum kmsg_dump_reason reason)
 	if ((reason > KMSG_DUMP_OOPS) && !always_kmsg_dump)
 		return;
 
+	log_stage_flush();
+
 	rcu_read_lock();
 	list_for_each_entry_rcu(dumper, &dump_list, list) {
 		if (dumper->max_reason && reason > dumper->max_reason)
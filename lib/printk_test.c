@@ -0,0 +1,163 @@
+/*
+ * printk() cost benchmark
+ *
+ * One thread per online CPU (or "threads" threads) calls printk() "loops"
+ * times at once and times every call. Loading the module reports the
+ * average and the worst call per thread; the load then fails so the
+ * module is unloaded again.
+ *
+ *	modprobe printk_test loops=10000 level=7
+ *
+ * With the default KERN_DEBUG level the messages only reach the log
+ * buffer; a level below the console loglevel also measures the consoles.
+ * Boot with printk.synchronous=1 to compare with printk() storing and
+ * printing each message itself.
+ */
+
+#include <linux/module.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+#include <linux/cpu.h>
+#include <linux/interrupt.h>
+
+static unsigned int threads;
+module_param(threads, uint, S_IRUGO);
+MODULE_PARM_DESC(threads, "Number of printing threads (default: online CPUs)");
+
+static unsigned int loops = 10000;
+module_param(loops, uint, S_IRUGO);
+MODULE_PARM_DESC(loops, "printk() calls per thread");
+
+static unsigned int level = 7;
+module_param(level, uint, S_IRUGO);
+MODULE_PARM_DESC(level, "Log level of the messages (0-7)");
+
+static bool irqsoff;
+module_param(irqsoff, bool, S_IRUGO);
+MODULE_PARM_DESC(irqsoff, "Call printk() with interrupts disabled");
+
+struct printk_test_thread {
+	struct task_struct *task;
+	unsigned int id;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static DECLARE_COMPLETION(printk_test_start);
+static atomic_t printk_test_running;
+static DECLARE_COMPLETION(printk_test_done);
+
+static int printk_test_fn(void *arg)
+{
+	struct printk_test_thread *t = arg;
+	unsigned long flags = 0;
+	unsigned int i;
+
+	wait_for_completion(&printk_test_start);
+
+	for (i = 0; i < loops; i++) {
+		ktime_t start;
+		u64 ns;
+
+		if (irqsoff)
+			local_irq_save(flags);
+		start = ktime_get();
+		printk(KERN_SOH "%cprintk_test: thread %u message %u of %u\n",
+		       '0' + level, t->id, i, loops);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (irqsoff)
+			local_irq_restore(flags);
+
+		t->total_ns += ns;
+		if (ns > t->max_ns)
+			t->max_ns = ns;
+		cond_resched();
+	}
+
+	if (atomic_dec_and_test(&printk_test_running))
+		complete(&printk_test_done);
+
+	/* wait to be stopped so the task can be inspected safely */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static int __init printk_test_init(void)
+{
+	struct printk_test_thread *t;
+	unsigned int i, n = 0;
+	u64 total = 0, worst = 0;
+	int cpu;
+
+	if (!loops || level > 7)
+		return -EINVAL;
+	if (!threads)
+		threads = num_online_cpus();
+
+	t = kcalloc(threads, sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	get_online_cpus();
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < threads; i++) {
+		t[i].id = i;
+		t[i].task = kthread_create(printk_test_fn, &t[i],
+					   "printk_test/%u", i);
+		if (IS_ERR(t[i].task))
+			break;
+		kthread_bind(t[i].task, cpu);
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		n++;
+	}
+	put_online_cpus();
+
+	if (!n) {
+		kfree(t);
+		return -ENOMEM;
+	}
+
+	atomic_set(&printk_test_running, n);
+	for (i = 0; i < n; i++)
+		wake_up_process(t[i].task);
+	complete_all(&printk_test_start);
+	wait_for_completion(&printk_test_done);
+
+	for (i = 0; i < n; i++) {
+		kthread_stop(t[i].task);
+		printk(KERN_ALERT "printk_test: thread %u: avg %llu ns, max %llu ns\n",
+		       i, (unsigned long long)div_u64(t[i].total_ns, loops),
+		       (unsigned long long)t[i].max_ns);
+		total += t[i].total_ns;
+		worst = max(worst, t[i].max_ns);
+	}
+	printk(KERN_ALERT "printk_test: %u threads x %u calls%s: avg %llu ns, max %llu ns\n",
+	       n, loops, irqsoff ? " with irqs off" : "",
+	       (unsigned long long)div64_u64(total, (u64)n * loops),
+	       (unsigned long long)worst);
+
+	kfree(t);
+
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void __exit printk_test_exit(void)
+{
+}
+
+module_init(printk_test_init)
+module_exit(printk_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("printk() cost benchmark");
@@ -20,6 +20,7 @@
 #include <linux/kthread.h>
 #include <linux/freezer.h>
 #include <linux/module.h>
+#include <linux/reclaim_stats.h>
 #include "internal.h"
 
 #ifdef CONFIG_COMPACTION
@@ -839,6 +840,27 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return ISOLATE_SUCCESS;
 }
 
+/*
+ * ION allocates order-8 and order-4 chunks before falling back to order-0,
+ * so those are the orders kcompactd keeps unfragmented by default.
+ */
+int sysctl_kcompactd_orders = (1 << 8) | (1 << 4);
+int sysctl_kcompactd_wakeup_score = 700;
+int sysctl_kcompactd_stop_score = 400;
+unsigned int sysctl_kcompactd_interval_ms = 2000;
+
+/* Worst fragmentation score of @zone over the orders kcompactd tracks */
+static int kcompactd_zone_score(struct zone *zone)
+{
+	int order, score = 0;
+
+	for (order = 1; order < MAX_ORDER; order++)
+		if (sysctl_kcompactd_orders & (1 << order))
+			score = max(score, fragmentation_score(zone, order));
+
+	return score;
+}
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -862,6 +884,11 @@ static int compact_finished(struct zone *zone,
 		return COMPACT_COMPLETE;
 	}
 
+	/* kcompactd is done once the tracked orders are defragmented enough */
+	if (cc->proactive)
+		return kcompactd_zone_score(zone) > sysctl_kcompactd_stop_score ?
+			COMPACT_CONTINUE : COMPACT_PARTIAL;
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -1085,12 +1112,14 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 	struct zone *zone;
 	int rc = COMPACT_SKIPPED;
 	int alloc_flags = 0;
+	u64 start;
 
 	/* Check if the GFP flags allow compaction */
 	if (!order || !may_enter_fs || !may_perform_io)
 		return rc;
 
 	count_compact_event(COMPACTSTALL);
+	start = reclaim_stat_start();
 
 #ifdef CONFIG_CMA
 	if (allocflags_to_migratetype(gfp_mask) == MIGRATE_MOVABLE)
@@ -1110,6 +1139,7 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 				      alloc_flags))
 			break;
 	}
+	reclaim_stat_end(RECLAIM_STAT_COMPACT, start);
 
 	return rc;
 }
@@ -1254,6 +1284,179 @@ static void compact_nodes(void)
 		compact_node(nid);
 }
 
+static struct timer_list kcompactd_timer;
+
+/*
+ * Proactive compaction only has to run while free memory is not so low
+ * that kswapd and direct reclaim are about to take the pages it needs as
+ * migration targets.
+ */
+static bool kcompactd_zone_suitable(struct zone *zone)
+{
+	int order = fls(sysctl_kcompactd_orders) - 1;
+	unsigned long watermark;
+
+	if (order <= 0)
+		return false;
+
+	watermark = high_wmark_pages(zone) + (2UL << order);
+	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+		return false;
+
+	return kcompactd_zone_score(zone) > sysctl_kcompactd_wakeup_score;
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int zoneid;
+	bool woken = false, failed = false;
+
+	if (pgdat->kcompactd_defer) {
+		pgdat->kcompactd_defer--;
+		return;
+	}
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.order = -1,
+			.sync = false,
+			.proactive = true,
+			.zone = zone,
+		};
+
+		if (!populated_zone(zone) || !kcompactd_zone_suitable(zone))
+			continue;
+
+		if (!woken) {
+			count_vm_event(KCOMPACTD_WAKE);
+			woken = true;
+		}
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		compact_zone(zone, &cc);
+
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+
+		if (kcompactd_zone_score(zone) > sysctl_kcompactd_stop_score) {
+			count_vm_event(KCOMPACTD_FAIL);
+			failed = true;
+		} else {
+			count_vm_event(KCOMPACTD_SUCCESS);
+		}
+	}
+
+	/*
+	 * Unmovable pages can keep the score up whatever is migrated, so back
+	 * off exponentially instead of rescanning the zone on every wakeup.
+	 */
+	if (failed) {
+		if (pgdat->kcompactd_defer_shift < COMPACT_MAX_DEFER_SHIFT)
+			pgdat->kcompactd_defer_shift++;
+		pgdat->kcompactd_defer = (1U << pgdat->kcompactd_defer_shift) - 1;
+	} else if (woken) {
+		pgdat->kcompactd_defer_shift = 0;
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pgdat->kcompactd_wait,
+				pgdat->kcompactd_check || kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		pgdat->kcompactd_check = false;
+		kcompactd_do_work(pgdat);
+	}
+
+	return 0;
+}
+
+/*
+ * Called from the allocator slow path: a high-order allocation missed the
+ * low watermark, which is worth a look at the fragmentation score.
+ */
+void wakeup_kcompactd(struct zone *zone, int order)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (order <= 0 || !(sysctl_kcompactd_orders & ((2 << order) - 1)))
+		return;
+	if (!pgdat->kcompactd || !waitqueue_active(&pgdat->kcompactd_wait))
+		return;
+
+	pgdat->kcompactd_check = true;
+	wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * The timer is deferrable, so the score is only polled while the system
+ * is awake anyway and an idle phone is never woken up for it.
+ */
+static void kcompactd_timer_func(unsigned long data)
+{
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+
+		if (!pgdat->kcompactd)
+			continue;
+		pgdat->kcompactd_check = true;
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+	}
+
+	if (sysctl_kcompactd_interval_ms)
+		mod_timer(&kcompactd_timer, jiffies +
+			  msecs_to_jiffies(sysctl_kcompactd_interval_ms));
+}
+
+int sysctl_kcompactd_interval_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	if (sysctl_kcompactd_interval_ms)
+		mod_timer(&kcompactd_timer, jiffies +
+			  msecs_to_jiffies(sysctl_kcompactd_interval_ms));
+	else
+		del_timer_sync(&kcompactd_timer);
+
+	return 0;
+}
+
+static void __init kcompactd_run(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	struct sched_param param = { .sched_priority = 0 };
+	struct task_struct *task;
+
+	task = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(task)) {
+		pr_err("Failed to start kcompactd on node %d\n", nid);
+		return;
+	}
+
+	/* Only compact when nothing else wants the CPU */
+	sched_setscheduler(task, SCHED_IDLE, &param);
+	pgdat->kcompactd = task;
+}
+
 /* The written value is actually unused, all memory is compacted */
 int sysctl_compact_memory;
 
@@ -1307,6 +1510,7 @@ void compaction_unregister_node(struct node *node)
 static int  __init mem_compaction_init(void)
 {
 	struct sched_param param = { .sched_priority = 0 };
+	int nid;
 
 	init_timer_deferrable(&compact_thread.timer);
 	compact_thread.timer.function = compact_thread_timer_func;
@@ -1317,6 +1521,15 @@ static int  __init mem_compaction_init(void)
 		sched_setscheduler(compact_thread.task, SCHED_IDLE, &param);
 
 	fb_register_client(&compact_notifier_block);
+
+	for_each_node_state(nid, N_MEMORY)
+		kcompactd_run(nid);
+
+	init_timer_deferrable(&kcompactd_timer);
+	kcompactd_timer.function = kcompactd_timer_func;
+	if (sysctl_kcompactd_interval_ms)
+		mod_timer(&kcompactd_timer, jiffies +
+			  msecs_to_jiffies(sysctl_kcompactd_interval_ms));
 	return 0;
 }
 late_initcall(mem_compaction_init);
@@ -1083,6 +1083,45 @@ static void shrink_readahead_size_eio(struct file *filp,
 	ra->ra_pages /= 4;
 }
 
+/*
+ * Sequential reads look up the pages they are about to copy in batches,
+ * one radix tree walk per PAGEVEC_SIZE pages instead of one per page.
+ * Pages of the batch not used yet are still referenced.
+ */
+struct read_batch {
+	unsigned int nr;
+	unsigned int idx;
+	struct page *pages[PAGEVEC_SIZE];
+};
+
+static void read_batch_release(struct read_batch *rb)
+{
+	while (rb->idx < rb->nr)
+		page_cache_release(rb->pages[rb->idx++]);
+	rb->nr = rb->idx = 0;
+}
+
+static struct page *read_batch_get(struct read_batch *rb,
+				   struct address_space *mapping,
+				   pgoff_t index, pgoff_t last_index)
+{
+	unsigned int nr;
+
+	if (rb->idx < rb->nr && rb->pages[rb->idx]->index == index)
+		return rb->pages[rb->idx++];
+
+	read_batch_release(rb);
+	nr = min_t(pgoff_t, last_index - index, PAGEVEC_SIZE);
+	if (nr <= 1)
+		return find_get_page(mapping, index);
+
+	rb->nr = find_get_pages_contig(mapping, index, nr, rb->pages);
+	if (!rb->nr)
+		return NULL;
+	rb->idx = 1;
+	return rb->pages[0];
+}
+
 /**
  * do_generic_file_read - generic file read routine
  * @filp:	the file to read
@@ -1107,6 +1146,7 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 	pgoff_t prev_index;
 	unsigned long offset;      /* offset into pagecache page */
 	unsigned int prev_offset;
+	struct read_batch batch = { .nr = 0, .idx = 0 };
 	int error;
 
 	index = *ppos >> PAGE_CACHE_SHIFT;
@@ -1123,12 +1163,14 @@ static void do_generic_file_read(struct file *filp, loff_t *ppos,
 
 		cond_resched();
 find_page:
-		page = find_get_page(mapping, index);
+		page = read_batch_get(&batch, mapping, index, last_index);
+		ra_record_access(mapping, index, page != NULL);
 		if (!page) {
 			page_cache_sync_readahead(mapping,
 					ra, filp,
 					index, last_index - index);
-			page = find_get_page(mapping, index);
+			page = read_batch_get(&batch, mapping, index,
+					      last_index);
 			if (unlikely(page == NULL))
 				goto no_cached_page;
 		}
@@ -1305,6 +1347,7 @@ no_cached_page:
 	}
 
 out:
+	read_batch_release(&batch);
 	ra->prev_pos = prev_index;
 	ra->prev_pos <<= PAGE_CACHE_SHIFT;
 	ra->prev_pos |= prev_offset;
@@ -1625,6 +1668,7 @@ int filemap_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 	 * Do we have something in the page cache already?
 	 */
 	page = find_get_page(mapping, offset);
+	ra_record_access(mapping, offset, page != NULL);
 	if (likely(page) && !(vmf->flags & FAULT_FLAG_TRIED)) {
 		/*
 		 * We found the page, so try async readahead before
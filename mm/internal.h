@@ -130,6 +130,9 @@ struct compact_control {
 					 * no longer being updated
 					 */
 	bool finished_update_migrate;
+	bool proactive;			/* kcompactd lowering the zone's
+					 * fragmentation score
+					 */
 
 	int order;			/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
@@ -2352,8 +2352,10 @@ void wake_all_kswapd(unsigned int order, struct zonelist *zonelist,
 	struct zoneref *z;
 	struct zone *zone;
 
-	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx)
+	for_each_zone_zonelist(zone, z, zonelist, high_zoneidx) {
 		wakeup_kswapd(zone, order, classzone_idx);
+		wakeup_kcompactd(zone, order);
+	}
 }
 
 static inline int
@@ -4642,6 +4644,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 #endif
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	init_waitqueue_head(&pgdat->pfmemalloc_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -4765,7 +4770,7 @@ void __paginginit free_area_init_node(int nid, unsigned long *zones_size,
 	pg_data_t *pgdat = NODE_DATA(nid);
 
 	/* pg_data_t should be reset to zero when it's allocated */
-	WARN_ON(pgdat->nr_zones || pgdat->classzone_idx);
+	WARN_ON(pgdat->nr_zones || pgdat->classzone_idx[0]);
 
 	pgdat->node_id = nid;
 	pgdat->node_start_pfn = node_start_pfn;
@@ -5924,8 +5929,6 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 	unsigned int tries = 0;
 	int ret = 0;
 
-	migrate_prep();
-
 	while (pfn < end || !list_empty(&cc->migratepages)) {
 		if (fatal_signal_pending(current)) {
 			ret = -EINTR;
@@ -5960,6 +5963,80 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 	return 0;
 }
 
+/*
+ * Ranges of at least two chunks are migrated by up to one worker per
+ * online CPU, so that copying out a camera sized CMA range is not bound
+ * by a single core.
+ */
+#define CONTIG_MIGRATE_CHUNK		pageblock_nr_pages
+#define CONTIG_MIGRATE_MAX_WORKERS	8
+
+struct contig_migrate_work {
+	struct work_struct work;
+	struct zone *zone;
+	unsigned long start;
+	unsigned long end;
+	int ret;
+};
+
+static void contig_migrate_work_fn(struct work_struct *work)
+{
+	struct contig_migrate_work *cmw =
+		container_of(work, struct contig_migrate_work, work);
+	struct compact_control cc = {
+		.nr_migratepages = 0,
+		.order = -1,
+		.zone = cmw->zone,
+		.sync = true,
+		.ignore_skip_hint = true,
+	};
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	cmw->ret = __alloc_contig_migrate_range(&cc, cmw->start, cmw->end);
+}
+
+static int alloc_contig_migrate_range(struct compact_control *cc,
+				      unsigned long start, unsigned long end)
+{
+	struct contig_migrate_work works[CONTIG_MIGRATE_MAX_WORKERS];
+	unsigned long chunk, pfn = start;
+	int i, nr, ret = 0;
+
+	migrate_prep();
+
+	nr = min_t(unsigned long, (end - start) / CONTIG_MIGRATE_CHUNK,
+		   min_t(unsigned int, num_online_cpus(),
+			 CONTIG_MIGRATE_MAX_WORKERS));
+	if (nr <= 1)
+		return __alloc_contig_migrate_range(cc, start, end);
+
+	chunk = ALIGN(DIV_ROUND_UP(end - start, nr), pageblock_nr_pages);
+	for (i = 0; i < nr && pfn < end; i++) {
+		struct contig_migrate_work *cmw = &works[i];
+
+		INIT_WORK_ONSTACK(&cmw->work, contig_migrate_work_fn);
+		cmw->zone = cc->zone;
+		cmw->start = pfn;
+		cmw->end = min(pfn + chunk, end);
+		queue_work(system_unbound_wq, &cmw->work);
+		pfn = cmw->end;
+	}
+	nr = i;
+
+	for (i = 0; i < nr; i++) {
+		flush_work(&works[i].work);
+		destroy_work_on_stack(&works[i].work);
+		if (!ret)
+			ret = works[i].ret;
+	}
+
+	/* The workers cannot see our signals */
+	if (!ret && fatal_signal_pending(current))
+		ret = -EINTR;
+
+	return ret;
+}
+
 /**
  * alloc_contig_range() -- tries to allocate given range of pages
  * @start:	start PFN to allocate
@@ -6025,7 +6102,7 @@ int alloc_contig_range(unsigned long start, unsigned long end,
 	if (ret)
 		return ret;
 
-	ret = __alloc_contig_migrate_range(&cc, start, end);
+	ret = alloc_contig_migrate_range(&cc, start, end);
 	if (ret)
 		goto done;
 
@@ -0,0 +1,529 @@
+/*
+ * mm/ra_record.c - learn which pages of a file are read, and read them
+ * all ahead the next time the file is opened.
+ *
+ * While recording is switched on, every page read or faulted from a
+ * regular file sets a bit in a per-inode bitmap.  The bitmaps can be
+ * saved from debugfs and written back after a reboot.  The first open of
+ * a file with a record then queues readahead of every recorded page, so
+ * that the scattered faults of an application's first launch find their
+ * pages in the page cache.
+ *
+ * Released under the terms of the GNU GPL v2.0.
+ */
+
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/hashtable.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/init.h>
+
+#include <trace/events/filemap.h>
+
+/* Pages past this offset are not recorded */
+#define RA_RECORD_MAX_PAGES	32768
+#define RA_RECORD_MAX_FILES	1024
+#define RA_RECORD_HASH_BITS	8
+/* Largest "records" file accepted in one open */
+#define RA_RECORD_MAX_WRITE	(8 << 20)
+
+#define RA_RECORD_REPLAYED	0
+
+struct ra_record {
+	struct hlist_node hash;
+	struct rcu_head rcu;
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;
+	unsigned int nr_pages;
+	unsigned long flags;
+	/* Pages read ahead at replay that have not been used yet */
+	unsigned long *pending;
+	unsigned long bits[0];
+};
+
+/*
+ * Layout of each record in the debugfs "records" file.  The header is
+ * followed by BITS_TO_LONGS(nr_pages) native unsigned longs of bitmap.
+ */
+struct ra_record_hdr {
+	__u64 ino;
+	__u64 size;
+	__u32 dev;
+	__u32 nr_pages;
+};
+
+struct ra_replay {
+	struct work_struct work;
+	struct file *file;
+	unsigned int nr_pages;
+	unsigned long bits[0];
+};
+
+static DEFINE_HASHTABLE(ra_records, RA_RECORD_HASH_BITS);
+static DEFINE_SPINLOCK(ra_record_lock);
+static unsigned int ra_record_nr;
+static unsigned int ra_record_on;
+unsigned int ra_record_active __read_mostly;
+
+static atomic_long_t ra_replay_files;
+static atomic_long_t ra_replay_pages;
+static atomic_long_t ra_replay_hits;
+static atomic_long_t ra_replay_misses;
+
+static inline unsigned long ra_record_key(dev_t dev, unsigned long ino)
+{
+	return ino ^ ((unsigned long)dev << 8);
+}
+
+static inline size_t ra_record_words(unsigned int nr_pages)
+{
+	return BITS_TO_LONGS(nr_pages);
+}
+
+/* Called with ra_record_lock held */
+static void ra_record_update_active(void)
+{
+	ra_record_active = ra_record_on || ra_record_nr;
+}
+
+static struct ra_record *ra_record_find(dev_t dev, unsigned long ino)
+{
+	struct ra_record *r;
+
+	hash_for_each_possible_rcu(ra_records, r, hash,
+				   ra_record_key(dev, ino))
+		if (r->dev == dev && r->ino == ino)
+			return r;
+
+	return NULL;
+}
+
+static struct ra_record *ra_record_alloc(dev_t dev, unsigned long ino,
+					 loff_t size, unsigned int nr_pages,
+					 gfp_t gfp)
+{
+	size_t words = ra_record_words(nr_pages);
+	struct ra_record *r;
+
+	r = kzalloc(sizeof(*r) + 2 * words * sizeof(long), gfp);
+	if (!r)
+		return NULL;
+
+	r->dev = dev;
+	r->ino = ino;
+	r->size = size;
+	r->nr_pages = nr_pages;
+	r->pending = r->bits + words;
+
+	return r;
+}
+
+/*
+ * Add @new, replacing any record for the same inode.  Fails once
+ * RA_RECORD_MAX_FILES records exist.  Called with ra_record_lock held.
+ */
+static int ra_record_insert(struct ra_record *new)
+{
+	struct ra_record *old = ra_record_find(new->dev, new->ino);
+
+	if (old) {
+		hash_del_rcu(&old->hash);
+		kfree_rcu(old, rcu);
+		ra_record_nr--;
+	}
+
+	if (ra_record_nr >= RA_RECORD_MAX_FILES)
+		return -ENOSPC;
+
+	hash_add_rcu(ra_records, &new->hash, ra_record_key(new->dev, new->ino));
+	ra_record_nr++;
+	ra_record_update_active();
+
+	return 0;
+}
+
+static void ra_record_clear(void)
+{
+	struct ra_record *r;
+	struct hlist_node *tmp;
+	int bkt;
+
+	spin_lock(&ra_record_lock);
+	hash_for_each_safe(ra_records, bkt, tmp, r, hash) {
+		hash_del_rcu(&r->hash);
+		kfree_rcu(r, rcu);
+	}
+	ra_record_nr = 0;
+	ra_record_update_active();
+	spin_unlock(&ra_record_lock);
+}
+
+/*
+ * Records are created on the first access, so this runs in the read and
+ * fault paths and must not sleep.
+ */
+static struct ra_record *ra_record_new(struct inode *inode)
+{
+	loff_t size = i_size_read(inode);
+	unsigned long nr_pages;
+	struct ra_record *r;
+
+	nr_pages = (size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+	if (!nr_pages)
+		return NULL;
+	nr_pages = min_t(unsigned long, nr_pages, RA_RECORD_MAX_PAGES);
+
+	r = ra_record_alloc(inode->i_sb->s_dev, inode->i_ino, size, nr_pages,
+			    GFP_NOWAIT | __GFP_NOWARN);
+	if (!r)
+		return NULL;
+
+	spin_lock(&ra_record_lock);
+	if (ra_record_find(r->dev, r->ino) || ra_record_insert(r)) {
+		spin_unlock(&ra_record_lock);
+		kfree(r);
+		return ra_record_find(inode->i_sb->s_dev, inode->i_ino);
+	}
+	spin_unlock(&ra_record_lock);
+
+	return r;
+}
+
+void __ra_record_access(struct address_space *mapping, pgoff_t index,
+			bool cached)
+{
+	struct inode *inode = mapping->host;
+	struct ra_record *r;
+
+	if (!S_ISREG(inode->i_mode) || index >= RA_RECORD_MAX_PAGES)
+		return;
+
+	rcu_read_lock();
+	r = ra_record_find(inode->i_sb->s_dev, inode->i_ino);
+	if (!r && ra_record_on)
+		r = ra_record_new(inode);
+	if (!r || index >= r->nr_pages)
+		goto out;
+
+	if (ra_record_on && !test_bit(index, r->bits))
+		set_bit(index, r->bits);
+
+	if (test_bit(RA_RECORD_REPLAYED, &r->flags) &&
+	    test_and_clear_bit(index, r->pending)) {
+		atomic_long_inc(cached ? &ra_replay_hits : &ra_replay_misses);
+		trace_mm_filemap_replay_access(inode, index, cached);
+	}
+out:
+	rcu_read_unlock();
+}
+
+static void ra_replay_workfn(struct work_struct *work)
+{
+	struct ra_replay *rp = container_of(work, struct ra_replay, work);
+	struct file *file = rp->file;
+	unsigned long start, end, nr = 0;
+
+	for (start = find_first_bit(rp->bits, rp->nr_pages);
+	     start < rp->nr_pages;
+	     start = find_next_bit(rp->bits, rp->nr_pages, end)) {
+		end = find_next_zero_bit(rp->bits, rp->nr_pages, start);
+		force_page_cache_readahead(file->f_mapping, file, start,
+					   end - start);
+		nr += end - start;
+	}
+
+	atomic_long_inc(&ra_replay_files);
+	atomic_long_add(nr, &ra_replay_pages);
+	trace_mm_filemap_replay(file_inode(file), nr);
+
+	fput(file);
+	kfree(rp);
+}
+
+/*
+ * Queue readahead of every recorded page on the first open of a file
+ * whose size still matches its record.
+ */
+void __ra_record_open(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	struct ra_record *r;
+	struct ra_replay *rp;
+	size_t words;
+
+	if (!S_ISREG(inode->i_mode))
+		return;
+
+	rcu_read_lock();
+	r = ra_record_find(inode->i_sb->s_dev, inode->i_ino);
+	if (!r || r->size != i_size_read(inode) ||
+	    test_bit(RA_RECORD_REPLAYED, &r->flags))
+		goto out;
+
+	words = ra_record_words(r->nr_pages);
+	rp = kmalloc(sizeof(*rp) + words * sizeof(long),
+		     GFP_NOWAIT | __GFP_NOWARN);
+	if (!rp)
+		goto out;
+
+	if (test_and_set_bit(RA_RECORD_REPLAYED, &r->flags)) {
+		kfree(rp);
+		goto out;
+	}
+
+	bitmap_copy(rp->bits, r->bits, r->nr_pages);
+	bitmap_copy(r->pending, r->bits, r->nr_pages);
+	rp->nr_pages = r->nr_pages;
+	rp->file = get_file(file);
+	INIT_WORK(&rp->work, ra_replay_workfn);
+	queue_work(system_unbound_wq, &rp->work);
+out:
+	rcu_read_unlock();
+}
+
+static int ra_record_on_get(void *data, u64 *val)
+{
+	*val = ra_record_on;
+	return 0;
+}
+
+static int ra_record_on_set(void *data, u64 val)
+{
+	spin_lock(&ra_record_lock);
+	ra_record_on = !!val;
+	ra_record_update_active();
+	spin_unlock(&ra_record_lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(ra_record_on_fops, ra_record_on_get,
+			ra_record_on_set, "%llu\n");
+
+struct ra_records_buf {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static size_t ra_record_dump_size(void)
+{
+	struct ra_record *r;
+	size_t size = 0;
+	int bkt;
+
+	hash_for_each(ra_records, bkt, r, hash)
+		size += sizeof(struct ra_record_hdr) +
+			ra_record_words(r->nr_pages) * sizeof(long);
+
+	return size;
+}
+
+static void ra_record_dump(struct ra_records_buf *rb)
+{
+	struct ra_record_hdr hdr;
+	struct ra_record *r;
+	size_t bytes;
+	int bkt;
+
+	hash_for_each(ra_records, bkt, r, hash) {
+		bytes = ra_record_words(r->nr_pages) * sizeof(long);
+		if (rb->len + sizeof(hdr) + bytes > rb->size)
+			break;
+
+		hdr.ino = r->ino;
+		hdr.size = r->size;
+		hdr.dev = new_encode_dev(r->dev);
+		hdr.nr_pages = r->nr_pages;
+		memcpy(rb->buf + rb->len, &hdr, sizeof(hdr));
+		memcpy(rb->buf + rb->len + sizeof(hdr), r->bits, bytes);
+		rb->len += sizeof(hdr) + bytes;
+	}
+}
+
+static int ra_records_open(struct inode *inode, struct file *file)
+{
+	struct ra_records_buf *rb;
+	size_t size;
+
+	rb = kzalloc(sizeof(*rb), GFP_KERNEL);
+	if (!rb)
+		return -ENOMEM;
+
+	if (file->f_mode & FMODE_WRITE) {
+		if (file->f_flags & O_TRUNC)
+			ra_record_clear();
+	} else {
+		spin_lock(&ra_record_lock);
+		size = ra_record_dump_size();
+		spin_unlock(&ra_record_lock);
+
+		rb->buf = vmalloc(size ? size : 1);
+		if (!rb->buf) {
+			kfree(rb);
+			return -ENOMEM;
+		}
+		rb->size = size;
+
+		spin_lock(&ra_record_lock);
+		ra_record_dump(rb);
+		spin_unlock(&ra_record_lock);
+	}
+
+	file->private_data = rb;
+	return 0;
+}
+
+static ssize_t ra_records_read(struct file *file, char __user *buf,
+			       size_t count, loff_t *ppos)
+{
+	struct ra_records_buf *rb = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, rb->buf, rb->len);
+}
+
+/* Records may be split across writes, so they are parsed on release */
+static ssize_t ra_records_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct ra_records_buf *rb = file->private_data;
+	char *new;
+
+	if (rb->len + count > RA_RECORD_MAX_WRITE)
+		return -EFBIG;
+
+	if (rb->len + count > rb->size) {
+		size_t size = max(rb->len + count, 2 * rb->size);
+
+		new = vmalloc(size);
+		if (!new)
+			return -ENOMEM;
+		if (rb->buf) {
+			memcpy(new, rb->buf, rb->len);
+			vfree(rb->buf);
+		}
+		rb->buf = new;
+		rb->size = size;
+	}
+
+	if (copy_from_user(rb->buf + rb->len, buf, count))
+		return -EFAULT;
+	rb->len += count;
+	*ppos += count;
+
+	return count;
+}
+
+static void ra_records_load(struct ra_records_buf *rb)
+{
+	struct ra_record_hdr hdr;
+	struct ra_record *r;
+	size_t pos = 0, bytes;
+	unsigned long nr_pages;
+
+	while (pos + sizeof(hdr) <= rb->len) {
+		memcpy(&hdr, rb->buf + pos, sizeof(hdr));
+		pos += sizeof(hdr);
+
+		nr_pages = (hdr.size + PAGE_CACHE_SIZE - 1) >> PAGE_CACHE_SHIFT;
+		if (!hdr.nr_pages || hdr.nr_pages > RA_RECORD_MAX_PAGES ||
+		    hdr.nr_pages > nr_pages)
+			break;
+
+		bytes = ra_record_words(hdr.nr_pages) * sizeof(long);
+		if (pos + bytes > rb->len)
+			break;
+
+		r = ra_record_alloc(new_decode_dev(hdr.dev), hdr.ino, hdr.size,
+				    hdr.nr_pages, GFP_KERNEL);
+		if (!r)
+			break;
+		memcpy(r->bits, rb->buf + pos, bytes);
+		pos += bytes;
+
+		spin_lock(&ra_record_lock);
+		if (ra_record_insert(r)) {
+			spin_unlock(&ra_record_lock);
+			kfree(r);
+			break;
+		}
+		spin_unlock(&ra_record_lock);
+	}
+
+	if (pos != rb->len)
+		pr_warn("ra_record: dropped %zu bytes of malformed records\n",
+			rb->len - pos);
+}
+
+static int ra_records_release(struct inode *inode, struct file *file)
+{
+	struct ra_records_buf *rb = file->private_data;
+
+	if (file->f_mode & FMODE_WRITE)
+		ra_records_load(rb);
+
+	vfree(rb->buf);
+	kfree(rb);
+	return 0;
+}
+
+static const struct file_operations ra_records_fops = {
+	.open		= ra_records_open,
+	.read		= ra_records_read,
+	.write		= ra_records_write,
+	.llseek		= default_llseek,
+	.release	= ra_records_release,
+};
+
+static int ra_record_stats_show(struct seq_file *m, void *v)
+{
+	long hits = atomic_long_read(&ra_replay_hits);
+	long misses = atomic_long_read(&ra_replay_misses);
+
+	seq_printf(m, "records: %u\n", ra_record_nr);
+	seq_printf(m, "replayed_files: %ld\n",
+		   atomic_long_read(&ra_replay_files));
+	seq_printf(m, "replayed_pages: %ld\n",
+		   atomic_long_read(&ra_replay_pages));
+	seq_printf(m, "hits: %ld\n", hits);
+	seq_printf(m, "misses: %ld\n", misses);
+	seq_printf(m, "hit_rate: %ld%%\n",
+		   hits + misses ? hits * 100 / (hits + misses) : 0);
+	return 0;
+}
+
+static int ra_record_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ra_record_stats_show, NULL);
+}
+
+static const struct file_operations ra_record_stats_fops = {
+	.open		= ra_record_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ra_record_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("ra_record", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("record", 0600, dir, NULL, &ra_record_on_fops);
+	debugfs_create_file("records", 0600, dir, NULL, &ra_records_fops);
+	debugfs_create_file("stats", 0444, dir, NULL, &ra_record_stats_fops);
+
+	return 0;
+}
+late_initcall(ra_record_debugfs_init);
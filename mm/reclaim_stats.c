@@ -0,0 +1,134 @@
+/*
+ * mm/reclaim_stats.c - direct reclaim and compaction stall accounting
+ *
+ * Every timed section run by a task other than kswapd adds to the task's
+ * reclaim_stats, shown in /proc/<pid>/reclaim_stats, and to a global
+ * latency histogram per item and per shrinker, shown in
+ * /sys/kernel/debug/reclaim_latency.
+ *
+ * Released under the terms of the GNU GPL v2.0.
+ */
+
+#include <linux/sched.h>
+#include <linux/swap.h>
+#include <linux/shrinker.h>
+#include <linux/reclaim_stats.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/init.h>
+
+static const char * const reclaim_stat_names[NR_RECLAIM_STAT_ITEMS] = {
+	[RECLAIM_STAT_DIRECT]		= "direct_reclaim",
+	[RECLAIM_STAT_COMPACT]		= "compaction",
+	[RECLAIM_STAT_INACTIVE_ANON]	= "inactive_anon",
+	[RECLAIM_STAT_INACTIVE_FILE]	= "inactive_file",
+	[RECLAIM_STAT_SLAB]		= "slab",
+	[RECLAIM_STAT_PAGEOUT_SWAP]	= "pageout_swap",
+	[RECLAIM_STAT_PAGEOUT_FILE]	= "pageout_file",
+};
+
+static struct reclaim_hist reclaim_hists[NR_RECLAIM_STAT_ITEMS];
+
+/* Returns 0 in kswapd, whose time nobody waits for */
+u64 reclaim_stat_start(void)
+{
+	if (current_is_kswapd())
+		return 0;
+
+	return local_clock();
+}
+
+static u64 reclaim_hist_add(struct reclaim_hist *hist, u64 start)
+{
+	u64 ns = local_clock() - start;
+	int bucket = fls64(div_u64(ns, NSEC_PER_USEC));
+
+	if (bucket >= RECLAIM_HIST_BUCKETS)
+		bucket = RECLAIM_HIST_BUCKETS - 1;
+
+	atomic_long_inc(&hist->count[bucket]);
+	atomic64_add(ns, &hist->total_ns);
+
+	return ns;
+}
+
+void reclaim_stat_end(enum reclaim_stat_item item, u64 start)
+{
+	if (!start)
+		return;
+
+	current->reclaim_stats.ns[item] +=
+		reclaim_hist_add(&reclaim_hists[item], start);
+	current->reclaim_stats.count[item]++;
+}
+
+void reclaim_stat_shrinker_end(struct shrinker *shrinker, u64 start)
+{
+	if (!start)
+		return;
+
+	reclaim_stat_end(RECLAIM_STAT_SLAB, start);
+	reclaim_hist_add(&shrinker->latency, start);
+}
+
+int reclaim_stats_sprint(char *buffer, struct task_reclaim_stats *stats)
+{
+	int i, len;
+
+	len = sprintf(buffer, "%-16s %10s %14s\n", "item", "count", "time_us");
+	for (i = 0; i < NR_RECLAIM_STAT_ITEMS; i++)
+		len += sprintf(buffer + len, "%-16s %10lu %14llu\n",
+			       reclaim_stat_names[i], stats->count[i],
+			       div_u64(stats->ns[i], NSEC_PER_USEC));
+
+	return len;
+}
+
+void reclaim_hist_show(struct seq_file *m, const char *name,
+		       struct reclaim_hist *hist)
+{
+	int i;
+
+	seq_printf(m, "%-24s %14llu", name,
+		   div_u64(atomic64_read(&hist->total_ns), NSEC_PER_USEC));
+	for (i = 0; i < RECLAIM_HIST_BUCKETS; i++)
+		seq_printf(m, " %lu", atomic_long_read(&hist->count[i]));
+	seq_putc(m, '\n');
+}
+
+static int reclaim_latency_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	seq_printf(m, "%-24s %14s", "item", "time_us");
+	seq_printf(m, " <1us");
+	for (i = 1; i < RECLAIM_HIST_BUCKETS; i++)
+		seq_printf(m, " %luus", 1UL << (i - 1));
+	seq_putc(m, '\n');
+
+	for (i = 0; i < NR_RECLAIM_STAT_ITEMS; i++)
+		reclaim_hist_show(m, reclaim_stat_names[i], &reclaim_hists[i]);
+
+	shrinker_latency_show(m);
+	return 0;
+}
+
+static int reclaim_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, reclaim_latency_show, NULL);
+}
+
+static const struct file_operations reclaim_latency_fops = {
+	.open		= reclaim_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init reclaim_stats_debugfs_init(void)
+{
+	debugfs_create_file("reclaim_latency", 0444, NULL, NULL,
+			    &reclaim_latency_fops);
+	return 0;
+}
+late_initcall(reclaim_stats_debugfs_init);
@@ -69,6 +69,8 @@
 #include <linux/gcd.h>
 #include <linux/freezer.h>
 #include <linux/sradix-tree.h>
+#include <linux/tick.h>
+#include <linux/cpufreq.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -511,6 +513,9 @@ static unsigned long uksm_pages_unshared;
  */
 static unsigned int uksm_sleep_jiffies;
 
+/* uksm_sleep_jiffies as scaled by the scan governor for the next batch */
+static unsigned int uksm_governed_sleep_jiffies;
+
 /* Base CPU limit that ratios are scaled against */
 static unsigned int uksm_max_cpu_percentage;
 
@@ -1352,6 +1357,46 @@ static inline u32 page_hash(struct page *page, unsigned long hash_strength,
 	return val;
 }
 
+/*
+ * Whole page compare and zero check.  An architecture may offer faster
+ * versions, which are only used if they win a timing run at boot.
+ */
+struct uksm_page_ops {
+	const char *name;
+	int (*memcmp_page)(const void *s1, const void *s2);
+	int (*is_zero_page)(const void *s);
+};
+
+static int generic_memcmp_page(const void *s1, const void *s2)
+{
+	return memcmp((void *)s1, (void *)s2, PAGE_SIZE);
+}
+
+static int generic_is_zero_page(const void *s)
+{
+	return is_full_zero(s, PAGE_SIZE);
+}
+
+static const struct uksm_page_ops uksm_generic_page_ops = {
+	.name		= "generic",
+	.memcmp_page	= generic_memcmp_page,
+	.is_zero_page	= generic_is_zero_page,
+};
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+#include "uksm_arm64.h"
+#endif
+
+#ifndef uksm_arch_page_ops
+static inline const struct uksm_page_ops *uksm_arch_page_ops(void)
+{
+	return NULL;
+}
+#endif
+
+static const struct uksm_page_ops *uksm_page_ops __read_mostly =
+	&uksm_generic_page_ops;
+
 static int memcmp_pages(struct page *page1, struct page *page2,
 			int cost_accounting)
 {
@@ -1360,7 +1405,7 @@ static int memcmp_pages(struct page *page1, struct page *page2,
 
 	addr1 = kmap_atomic(page1);
 	addr2 = kmap_atomic(page2);
-	ret = memcmp(addr1, addr2, PAGE_SIZE);
+	ret = uksm_page_ops->memcmp_page(addr1, addr2);
 	kunmap_atomic(addr2);
 	kunmap_atomic(addr1);
 
@@ -1381,7 +1426,7 @@ static inline int is_page_full_zero(struct page *page)
 	int ret;
 
 	addr = kmap_atomic(page);
-	ret = is_full_zero(addr, PAGE_SIZE);
+	ret = uksm_page_ops->is_zero_page(addr);
 	kunmap_atomic(addr);
 
 	return ret;
@@ -4205,7 +4250,7 @@ static void uksm_calc_scan_pages(void)
 		backoff = 4096;
 
 	for (i = SCAN_LADDER_SIZE - 1; i >= 0; i--) {
-		cpulim = jiffies_to_usecs(uksm_sleep_jiffies);
+		cpulim = jiffies_to_usecs(uksm_governed_sleep_jiffies);
 		cpulim = cpulim * uksm_ema_task_pages / backoff;
 		cpulim = cpulim * RATIO_SCALE /
 			rung_cpu_divisor(ladder[i].cpu_ratio);
@@ -4215,7 +4260,7 @@ static void uksm_calc_scan_pages(void)
 			cpulim = 100;
 
 		pagecnt = rung_get_pages(&ladder[i]) *
-			jiffies_to_msecs(uksm_sleep_jiffies) /
+			jiffies_to_msecs(uksm_governed_sleep_jiffies) /
 			ladder[i].cover_msecs;
 
 		// Don't reduce scan rate as scanning progresses...
@@ -4589,9 +4634,166 @@ static int ksmd_should_run(void)
 	return uksm_run & UKSM_RUN_MERGE;
 }
 
+/*
+ * Scan batches are run by a single uksmd thread confined to
+ * uksm_worker_mask, by default the little cores 0-3.  The rungs and trees
+ * are not locked, so more threads would only take turns on
+ * uksm_thread_mutex.  When a batch is due, uksmd moves to whichever CPU of
+ * the mask has been idle the most since the last batch, and skips the
+ * batch if none of them was idle enough.
+ */
+struct uksm_cpu_stat {
+	unsigned int cpu;
+	u64 last_idle_us;
+	u64 last_wall_us;
+	unsigned int idle_pct;
+	unsigned long batches;
+	u64 pages;
+	u64 runtime_ns;
+};
+
+static DEFINE_PER_CPU(struct uksm_cpu_stat, uksm_cpu_stats);
+static struct cpumask uksm_worker_mask;
+static bool uksm_worker_mask_set __initdata;
+
+static int __init uksm_worker_cpus_setup(char *str)
+{
+	if (!cpulist_parse(str, &uksm_worker_mask))
+		uksm_worker_mask_set = true;
+	return 1;
+}
+__setup("uksm_worker_cpus=", uksm_worker_cpus_setup);
+
+/* A batch is skipped while no CPU was idle at least this percentage */
+static unsigned int uksm_worker_idle_threshold = 50;
+static unsigned long uksm_busy_skips;
+
+/*
+ * The governor scales uksm_sleep_jiffies between batches by at most this
+ * factor either way.  A batch that has been skipped on busy CPUs for
+ * that many base periods is run anyway.
+ */
+#define UKSM_GOV_MAX_SCALE	8
+
+static unsigned long uksm_next_scan;
+
+/* Merged pages per 1000 pages scanned by the last batch */
+static unsigned int uksm_gov_yield;
+static int uksm_gov_throttled;
+static unsigned long uksm_gov_last_merged;
+static u64 uksm_gov_last_scanned;
+
+static unsigned int uksm_cpu_idle_pct(struct uksm_cpu_stat *st)
+{
+	u64 idle, wall, idle_delta, wall_delta;
+
+	idle = get_cpu_idle_time_us(st->cpu, &wall);
+	if (idle == -1ULL)
+		return 100;
+
+	idle_delta = idle - st->last_idle_us;
+	wall_delta = wall - st->last_wall_us;
+	st->last_idle_us = idle;
+	st->last_wall_us = wall;
+
+	if (!wall_delta || idle_delta >= wall_delta)
+		return 100;
+
+	return div64_u64(100 * idle_delta, wall_delta);
+}
+
+/* The online CPU of uksm_worker_mask that was idle the most */
+static struct uksm_cpu_stat *uksm_pick_cpu(void)
+{
+	struct uksm_cpu_stat *st, *best = NULL;
+	int cpu;
+
+	for_each_cpu_and(cpu, &uksm_worker_mask, cpu_online_mask) {
+		st = &per_cpu(uksm_cpu_stats, cpu);
+		st->idle_pct = uksm_cpu_idle_pct(st);
+		if (!best || st->idle_pct > best->idle_pct)
+			best = st;
+	}
+
+	/* The whole mask is offline: stay wherever the scheduler put us */
+	if (!best) {
+		best = &per_cpu(uksm_cpu_stats, raw_smp_processor_id());
+		best->cpu = raw_smp_processor_id();
+		best->idle_pct = uksm_cpu_idle_pct(best);
+	}
+
+	return best;
+}
+
+/* A thermal limit shows up as a policy max below the hardware max */
+static int uksm_cpu_throttled(unsigned int cpu)
+{
+#ifdef CONFIG_CPU_FREQ
+	struct cpufreq_policy *policy = cpufreq_cpu_get(cpu);
+	int throttled;
+
+	if (!policy)
+		return 0;
+
+	throttled = policy->max < policy->cpuinfo.max_freq;
+	cpufreq_cpu_put(policy);
+
+	return throttled;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Pick the time to the next batch from the last batch's merge yield, how
+ * idle the CPU that ran it was, and whether it is thermally capped.
+ * Called with uksm_thread_mutex held.
+ */
+static void uksm_govern(struct uksm_cpu_stat *st)
+{
+	unsigned long merged = uksm_pages_shared + uksm_pages_sharing;
+	unsigned long base = max(uksm_sleep_jiffies, 1U);
+	unsigned long sleep = base;
+	u64 scanned = 0;
+
+	if (uksm_pages_scanned > uksm_gov_last_scanned)
+		scanned = uksm_pages_scanned - uksm_gov_last_scanned;
+
+	uksm_gov_yield = 0;
+	if (scanned && merged > uksm_gov_last_merged)
+		uksm_gov_yield = div64_u64((u64)(merged - uksm_gov_last_merged) *
+					   1000, scanned);
+
+	uksm_gov_last_scanned = uksm_pages_scanned;
+	uksm_gov_last_merged = merged;
+	uksm_gov_throttled = uksm_cpu_throttled(st->cpu);
+
+	if (uksm_gov_yield >= uksm_abundant_threshold * 10)
+		sleep /= 4;
+	else if (uksm_gov_yield)
+		sleep /= 2;
+	else
+		sleep *= 2;
+
+	if (st->idle_pct >= 90)
+		sleep /= 2;
+
+	if (uksm_gov_throttled)
+		sleep *= 4;
+
+	uksm_governed_sleep_jiffies = clamp(sleep, base / UKSM_GOV_MAX_SCALE,
+					    base * UKSM_GOV_MAX_SCALE);
+	if (!uksm_governed_sleep_jiffies)
+		uksm_governed_sleep_jiffies = 1;
+}
+
 static int uksm_scan_thread(void *nothing)
 {
+	struct uksm_cpu_stat *st;
 	long timeout = 60 * HZ;
+	unsigned long long start;
+	u64 pages;
+
 	set_freezable();
 	set_user_nice(current, 15);
 
@@ -4604,26 +4806,61 @@ static int uksm_scan_thread(void *nothing)
 		if (unlikely(timeout))
 			continue;
 
-		if (unlikely(mutex_lock_interruptible(&uksm_thread_mutex))) {
-			timeout = uksm_sleep_jiffies;
+		timeout = max_t(long, uksm_governed_sleep_jiffies, 1);
+
+		if (unlikely(!ksmd_should_run())) {
+			wait_event_freezable(uksm_thread_wait,
+				ksmd_should_run() || kthread_should_stop());
+			continue;
+		}
+
+		st = uksm_pick_cpu();
+		if (st->idle_pct < uksm_worker_idle_threshold &&
+		    time_before(jiffies, uksm_next_scan +
+				uksm_sleep_jiffies * UKSM_GOV_MAX_SCALE)) {
+			uksm_busy_skips++;
 			continue;
 		}
 
+		if (st->cpu != raw_smp_processor_id())
+			set_cpus_allowed_ptr(current, cpumask_of(st->cpu));
+
+		if (unlikely(mutex_lock_interruptible(&uksm_thread_mutex)))
+			continue;
+
 		if (likely(ksmd_should_run())) {
+			pages = uksm_pages_scanned;
+			start = task_sched_runtime(current);
 			uksm_do_scan();
-			mutex_unlock(&uksm_thread_mutex);
-			timeout = uksm_sleep_jiffies - jiffies % uksm_sleep_jiffies;
+			st->runtime_ns += task_sched_runtime(current) - start;
+			if (uksm_pages_scanned > pages)
+				st->pages += uksm_pages_scanned - pages;
+			st->batches++;
+
+			uksm_govern(st);
+			uksm_next_scan = jiffies + uksm_governed_sleep_jiffies;
 			uksm_sleep_times++;
-		} else {
-			mutex_unlock(&uksm_thread_mutex);
-			wait_event_freezable(uksm_thread_wait,
-				ksmd_should_run() || kthread_should_stop());
-			timeout = uksm_sleep_jiffies;
 		}
+		timeout = max_t(long, uksm_governed_sleep_jiffies, 1);
+		mutex_unlock(&uksm_thread_mutex);
 	}
 	return 0;
 }
 
+static void __init uksm_init_worker_mask(void)
+{
+	int cpu;
+
+	if (!uksm_worker_mask_set)
+		cpulist_parse("0-3", &uksm_worker_mask);
+	cpumask_and(&uksm_worker_mask, &uksm_worker_mask, cpu_possible_mask);
+	if (cpumask_empty(&uksm_worker_mask))
+		cpumask_set_cpu(cpumask_first(cpu_online_mask), &uksm_worker_mask);
+
+	for_each_possible_cpu(cpu)
+		per_cpu(uksm_cpu_stats, cpu).cpu = cpu;
+}
+
 int page_referenced_ksm(struct page *page, struct mem_cgroup *memcg,
 			unsigned long *vm_flags)
 {
@@ -4942,6 +5179,60 @@ static ssize_t sleep_millisecs_store(struct kobject *kobj,
 }
 UKSM_ATTR(sleep_millisecs);
 
+static ssize_t worker_idle_threshold_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%u\n", uksm_worker_idle_threshold);
+}
+
+static ssize_t worker_idle_threshold_store(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   const char *buf, size_t count)
+{
+	unsigned long value;
+	int err;
+
+	err = strict_strtoul(buf, 10, &value);
+	if (err || value > 100)
+		return -EINVAL;
+
+	uksm_worker_idle_threshold = value;
+
+	return count;
+}
+UKSM_ATTR(worker_idle_threshold);
+
+static ssize_t scan_governor_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "sleep_millisecs %u\nyield_permille %u\n"
+		       "throttled %d\nbusy_skips %lu\n",
+		       jiffies_to_msecs(uksm_governed_sleep_jiffies),
+		       uksm_gov_yield, uksm_gov_throttled, uksm_busy_skips);
+}
+UKSM_ATTR_RO(scan_governor);
+
+static ssize_t workers_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	int cpu;
+
+	for_each_cpu(cpu, &uksm_worker_mask) {
+		struct uksm_cpu_stat *st = &per_cpu(uksm_cpu_stats, cpu);
+
+		len += sprintf(buf + len, "cpu%u: batches %lu pages %llu "
+			       "runtime_ms %llu idle %u%%\n",
+			       st->cpu, st->batches, st->pages,
+			       div64_u64(st->runtime_ns, NSEC_PER_MSEC),
+			       st->idle_pct);
+	}
+
+	return len;
+}
+UKSM_ATTR_RO(workers);
+
 
 static ssize_t cpu_governor_show(struct kobject *kobj,
 				  struct kobj_attribute *attr, char *buf)
@@ -5377,6 +5668,83 @@ static ssize_t sleep_times_show(struct kobject *kobj,
 }
 UKSM_ATTR_RO(sleep_times);
 
+/* Run @op for about 10ms and return how many runs it made per second */
+#define BENCH_RATE(op)							\
+({									\
+	u64 __start = local_clock(), __elapsed;				\
+	unsigned long __n = 0;						\
+									\
+	do {								\
+		op;							\
+		__n++;							\
+		__elapsed = local_clock() - __start;			\
+	} while (__elapsed < 10 * NSEC_PER_MSEC);			\
+	div64_u64((u64)__n * NSEC_PER_SEC, __elapsed);			\
+})
+
+/*
+ * Pages per second hashed at each power of two hash strength up to
+ * HASH_STRENGTH_FULL and at HASH_STRENGTH_MAX, and compared or checked
+ * for zero by the generic and the selected page ops.
+ */
+static ssize_t benchmark_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	const struct uksm_page_ops *ops[] = {
+		&uksm_generic_page_ops, uksm_page_ops,
+	};
+	volatile u32 hash;
+	volatile int ret;
+	struct page *p1, *p2;
+	char *addr1, *addr2;
+	unsigned long strength;
+	ssize_t len = 0;
+	int i;
+
+	p1 = alloc_page(GFP_KERNEL);
+	if (!p1)
+		return -ENOMEM;
+	p2 = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	if (!p2) {
+		__free_page(p1);
+		return -ENOMEM;
+	}
+
+	addr1 = kmap(p1);
+	addr2 = kmap(p2);
+	prandom_bytes(addr1, PAGE_SIZE);
+
+	for (strength = 1; ; strength <<= 1) {
+		if (strength > HASH_STRENGTH_FULL)
+			strength = HASH_STRENGTH_MAX;
+		len += sprintf(buf + len, "hash strength %lu: %llu pages/s\n",
+			       strength,
+			       BENCH_RATE(hash = random_sample_hash(addr1,
+								    strength)));
+		if (strength == HASH_STRENGTH_MAX)
+			break;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(ops); i++) {
+		if (i && ops[i] == ops[0])
+			break;
+		len += sprintf(buf + len, "memcmp %s: %llu pages/s\n",
+			       ops[i]->name,
+			       BENCH_RATE(ret = ops[i]->memcmp_page(addr1, addr1)));
+		len += sprintf(buf + len, "zero check %s: %llu pages/s\n",
+			       ops[i]->name,
+			       BENCH_RATE(ret = ops[i]->is_zero_page(addr2)));
+	}
+
+	kunmap(p2);
+	kunmap(p1);
+	__free_page(p1);
+	__free_page(p2);
+
+	return len;
+}
+UKSM_ATTR_RO(benchmark);
+
 
 static struct attribute *uksm_attrs[] = {
 	&max_cpu_percentage_attr.attr,
@@ -5391,6 +5759,10 @@ static struct attribute *uksm_attrs[] = {
 	&pages_scanned_attr.attr,
 	&hash_strength_attr.attr,
 	&sleep_times_attr.attr,
+	&benchmark_attr.attr,
+	&worker_idle_threshold_attr.attr,
+	&scan_governor_attr.attr,
+	&workers_attr.attr,
 	&thrash_threshold_attr.attr,
 	&abundant_threshold_attr.attr,
 	&cpu_ratios_attr.attr,
@@ -5481,6 +5853,65 @@ static inline void init_scan_ladder(void)
 	uksm_calc_scan_pages();
 }
 
+static u64 __init time_page_ops(const struct uksm_page_ops *ops,
+				void *addr1, void *addr2)
+{
+	u64 start = local_clock();
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		ops->memcmp_page(addr1, addr2);
+		ops->is_zero_page(addr2);
+	}
+
+	return local_clock() - start;
+}
+
+/*
+ * Time the architecture's page compare and zero check against the
+ * generic ones, on pages that only differ in (and are only non-zero at)
+ * the last byte, and keep the faster.
+ */
+static int __init select_page_ops(void)
+{
+	const struct uksm_page_ops *arch_ops = uksm_arch_page_ops();
+	struct page *p1, *p2;
+	char *addr1, *addr2;
+	u64 t_generic, t_arch;
+
+	if (!arch_ops)
+		return 0;
+
+	p1 = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	if (!p1)
+		return -ENOMEM;
+
+	p2 = alloc_page(GFP_KERNEL | __GFP_ZERO);
+	if (!p2) {
+		__free_page(p1);
+		return -ENOMEM;
+	}
+
+	addr1 = kmap(p1);
+	addr2 = kmap(p2);
+	addr2[PAGE_SIZE - 1] = 1;
+
+	t_generic = time_page_ops(&uksm_generic_page_ops, addr1, addr2);
+	t_arch = time_page_ops(arch_ops, addr1, addr2);
+	if (t_arch < t_generic)
+		uksm_page_ops = arch_ops;
+
+	kunmap(p2);
+	kunmap(p1);
+	__free_page(p1);
+	__free_page(p2);
+
+	printk(KERN_INFO "UKSM: %s page ops %lluns, %s %lluns, using %s.\n",
+	       uksm_generic_page_ops.name, t_generic, arch_ops->name, t_arch,
+	       uksm_page_ops->name);
+	return 0;
+}
+
 static inline int cal_positive_negative_costs(void)
 {
 	struct page *p1, *p2;
@@ -5583,6 +6014,9 @@ static inline int init_random_sampling(void)
 	rshash_state.below_count = 0;
 	rshash_state.lookup_window_index = 0;
 
+	if (select_page_ops())
+		return -ENOMEM;
+
 	return cal_positive_negative_costs();
 }
 
@@ -5696,6 +6130,8 @@ static int __init uksm_init(void)
 	int err;
 
 	uksm_sleep_jiffies = msecs_to_jiffies(500);
+	uksm_governed_sleep_jiffies = uksm_sleep_jiffies;
+	uksm_next_scan = jiffies;
 
 	slot_tree_init();
 	init_scan_ladder();
@@ -5713,12 +6149,16 @@ static int __init uksm_init(void)
 	if (err)
 		goto out_free0;
 
-	uksm_thread = kthread_run(uksm_scan_thread, NULL, "uksmd");
+	uksm_init_worker_mask();
+	uksm_thread = kthread_create(uksm_scan_thread, NULL, "uksmd");
 	if (IS_ERR(uksm_thread)) {
 		printk(KERN_ERR "uksm: creating kthread failed\n");
 		err = PTR_ERR(uksm_thread);
 		goto out_free;
 	}
+	if (cpumask_intersects(&uksm_worker_mask, cpu_online_mask))
+		set_cpus_allowed_ptr(uksm_thread, &uksm_worker_mask);
+	wake_up_process(uksm_thread);
 
 #ifdef CONFIG_SYSFS
 	err = sysfs_create_group(mm_kobj, &uksm_attr_group);
@@ -0,0 +1,52 @@
+#ifndef _UKSM_ARM64_H
+#define _UKSM_ARM64_H
+
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+extern size_t uksm_neon_cmp_blocks(const void *s1, const void *s2, size_t n);
+extern int uksm_neon_is_zero(const void *s, size_t n);
+
+/*
+ * Only the first differing 64-byte block is looked at byte by byte, so
+ * that the result orders pages exactly like memcmp() does.
+ */
+static int uksm_neon_memcmp_page(const void *s1, const void *s2)
+{
+	size_t off;
+
+	kernel_neon_begin_partial(8);
+	off = uksm_neon_cmp_blocks(s1, s2, PAGE_SIZE);
+	kernel_neon_end();
+
+	if (off == PAGE_SIZE)
+		return 0;
+
+	return memcmp(s1 + off, s2 + off, 64);
+}
+
+static int uksm_neon_is_zero_page(const void *s)
+{
+	int ret;
+
+	kernel_neon_begin_partial(8);
+	ret = uksm_neon_is_zero(s, PAGE_SIZE);
+	kernel_neon_end();
+
+	return ret;
+}
+
+static const struct uksm_page_ops uksm_neon_page_ops = {
+	.name		= "neon",
+	.memcmp_page	= uksm_neon_memcmp_page,
+	.is_zero_page	= uksm_neon_is_zero_page,
+};
+
+#define uksm_arch_page_ops uksm_arch_page_ops
+static inline const struct uksm_page_ops *uksm_arch_page_ops(void)
+{
+	return (elf_hwcap & HWCAP_ASIMD) ? &uksm_neon_page_ops : NULL;
+}
+
+#endif
@@ -50,6 +50,9 @@
 
 #include <linux/swapops.h>
 #include <linux/balloon_compaction.h>
+#include <linux/memory_hotplug.h>
+#include <linux/reclaim_stats.h>
+#include <linux/kallsyms.h>
 
 #include "internal.h"
 
@@ -133,6 +136,42 @@ struct scan_control {
 int vm_swappiness = 10;
 unsigned long vm_total_pages;	/* The total number of pages which the VM controls */
 
+/*
+ * Number of kswapd threads per node.  They all run the same balancing loop
+ * and split the LRU scanning between them by isolating their own batches,
+ * so reclaim and the swap writeout it does (zram compression included)
+ * run in parallel.
+ */
+int kswapd_threads = 1;
+
+#ifdef CONFIG_SCHED_HMP
+extern struct cpumask hmp_slow_cpu_mask;
+#endif
+
+/* kswapd runs on its node's CPUs, and on HMP systems on the slow ones */
+static const struct cpumask *kswapd_cpumask(pg_data_t *pgdat)
+{
+	const struct cpumask *mask = cpumask_of_node(pgdat->node_id);
+
+#ifdef CONFIG_SCHED_HMP
+	if (cpumask_intersects(mask, &hmp_slow_cpu_mask))
+		return &hmp_slow_cpu_mask;
+#endif
+	return mask;
+}
+
+/* Which of its node's kswapd threads the current task is */
+static int kswapd_thread_id(pg_data_t *pgdat)
+{
+	int i;
+
+	for (i = 1; i < MAX_KSWAPD_THREADS; i++)
+		if (pgdat->kswapd[i] == current)
+			return i;
+
+	return 0;
+}
+
 static LIST_HEAD(shrinker_list);
 static DECLARE_RWSEM(shrinker_rwsem);
 
@@ -267,6 +306,7 @@ unsigned long shrink_slab(struct shrink_control *shrink,
 
 	list_for_each_entry(shrinker, &shrinker_list, list) {
 		unsigned long long delta;
+		u64 start;
 		long total_scan;
 		long max_pass;
 		int shrink_ret = 0;
@@ -329,6 +369,7 @@ unsigned long shrink_slab(struct shrink_control *shrink,
 					nr_pages_scanned, lru_pages,
 					max_pass, delta, total_scan);
 
+		start = reclaim_stat_start();
 		while (total_scan > min_cache_size) {
 			int nr_before;
 
@@ -347,6 +388,7 @@ unsigned long shrink_slab(struct shrink_control *shrink,
 
 			cond_resched();
 		}
+		reclaim_stat_shrinker_end(shrinker, start);
 
 		/*
 		 * move the unused scan count back into the shrinker in a
@@ -497,6 +539,22 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
 	return PAGE_CLEAN;
 }
 
+/* pageout() with the time spent accounted to swap or file writeout */
+static pageout_t timed_pageout(struct page *page,
+			       struct address_space *mapping,
+			       struct scan_control *sc)
+{
+	enum reclaim_stat_item item = PageSwapCache(page) ?
+		RECLAIM_STAT_PAGEOUT_SWAP : RECLAIM_STAT_PAGEOUT_FILE;
+	u64 start = reclaim_stat_start();
+	pageout_t ret;
+
+	ret = pageout(page, mapping, sc);
+	reclaim_stat_end(item, start);
+
+	return ret;
+}
+
 /*
  * Same as remove_mapping, but if the page is removed from the mapping, it
  * gets returned with a refcount of 0.
@@ -887,7 +945,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 				goto keep_locked;
 
 			/* Page is dirty, try to write it out here */
-			switch (pageout(page, mapping, sc)) {
+			switch (timed_pageout(page, mapping, sc)) {
 			case PAGE_KEEP:
 				nr_congested++;
 				goto keep_locked;
@@ -1394,9 +1452,12 @@ shrink_inactive_list(unsigned long nr_to_scan, struct lruvec *lruvec,
 
 	if (global_reclaim(sc)) {
 		zone->pages_scanned += nr_scanned;
-		if (current_is_kswapd())
+		if (current_is_kswapd()) {
 			__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scanned);
-		else
+			__count_vm_events(KSWAPD_PGSCAN_0 +
+					  kswapd_thread_id(zone->zone_pgdat),
+					  nr_scanned);
+		} else
 			__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scanned);
 	}
 	spin_unlock_irq(&zone->lru_lock);
@@ -1412,10 +1473,13 @@ shrink_inactive_list(unsigned long nr_to_scan, struct lruvec *lruvec,
 	reclaim_stat->recent_scanned[file] += nr_taken;
 
 	if (global_reclaim(sc)) {
-		if (current_is_kswapd())
+		if (current_is_kswapd()) {
 			__count_zone_vm_events(PGSTEAL_KSWAPD, zone,
 					       nr_reclaimed);
-		else
+			__count_vm_events(KSWAPD_PGSTEAL_0 +
+					  kswapd_thread_id(zone->zone_pgdat),
+					  nr_reclaimed);
+		} else
 			__count_zone_vm_events(PGSTEAL_DIRECT, zone,
 					       nr_reclaimed);
 	}
@@ -1698,13 +1762,21 @@ static int inactive_list_is_low(struct lruvec *lruvec, enum lru_list lru)
 static unsigned long shrink_list(enum lru_list lru, unsigned long nr_to_scan,
 				 struct lruvec *lruvec, struct scan_control *sc)
 {
+	unsigned long nr_reclaimed;
+	u64 start;
+
 	if (is_active_lru(lru)) {
 		if (inactive_list_is_low(lruvec, lru))
 			shrink_active_list(nr_to_scan, lruvec, sc, lru);
 		return 0;
 	}
 
-	return shrink_inactive_list(nr_to_scan, lruvec, sc, lru);
+	start = reclaim_stat_start();
+	nr_reclaimed = shrink_inactive_list(nr_to_scan, lruvec, sc, lru);
+	reclaim_stat_end(is_file_lru(lru) ? RECLAIM_STAT_INACTIVE_FILE :
+			 RECLAIM_STAT_INACTIVE_ANON, start);
+
+	return nr_reclaimed;
 }
 
 static int vmscan_swappiness(struct scan_control *sc)
@@ -2381,7 +2453,8 @@ static bool pfmemalloc_watermark_ok(pg_data_t *pgdat)
 
 	/* kswapd must be awake if processes are being throttled */
 	if (!wmark_ok && waitqueue_active(&pgdat->kswapd_wait)) {
-		pgdat->classzone_idx = min(pgdat->classzone_idx,
+		for (i = 0; i < MAX_KSWAPD_THREADS; i++)
+			pgdat->classzone_idx[i] = min(pgdat->classzone_idx[i],
 						(enum zone_type)ZONE_NORMAL);
 		wake_up_interruptible(&pgdat->kswapd_wait);
 	}
@@ -2486,6 +2559,7 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				gfp_t gfp_mask, nodemask_t *nodemask)
 {
 	unsigned long nr_reclaimed;
+	u64 start;
 	struct scan_control sc = {
 		.gfp_mask = (gfp_mask = memalloc_noio_flags(gfp_mask)),
 		.may_writepage = !laptop_mode,
@@ -2513,7 +2587,9 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				sc.may_writepage,
 				gfp_mask);
 
+	start = reclaim_stat_start();
 	nr_reclaimed = do_try_to_free_pages(zonelist, &sc, &shrink);
+	reclaim_stat_end(RECLAIM_STAT_DIRECT, start);
 
 	trace_mm_vmscan_direct_reclaim_end(nr_reclaimed);
 
@@ -3093,11 +3169,12 @@ static int kswapd(void *p)
 	int balanced_classzone_idx;
 	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
+	int id = kswapd_thread_id(pgdat);
 
 	struct reclaim_state reclaim_state = {
 		.reclaimed_slab = 0,
 	};
-	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	const struct cpumask *cpumask = kswapd_cpumask(pgdat);
 
 	lockdep_set_current_reclaim_state(GFP_KERNEL);
 
@@ -3120,6 +3197,10 @@ static int kswapd(void *p)
 	tsk->flags |= PF_MEMALLOC | PF_SWAPWRITE | PF_KSWAPD;
 	set_freezable();
 
+	/* Drop what was requested while this thread wasn't running */
+	pgdat->kswapd_max_order[id] = 0;
+	pgdat->classzone_idx[id] = pgdat->nr_zones - 1;
+
 	order = new_order = 0;
 	balanced_order = 0;
 	classzone_idx = new_classzone_idx = pgdat->nr_zones - 1;
@@ -3134,10 +3215,10 @@ static int kswapd(void *p)
 		 */
 		if (balanced_classzone_idx >= new_classzone_idx &&
 					balanced_order == new_order) {
-			new_order = pgdat->kswapd_max_order;
-			new_classzone_idx = pgdat->classzone_idx;
-			pgdat->kswapd_max_order =  0;
-			pgdat->classzone_idx = pgdat->nr_zones - 1;
+			new_order = pgdat->kswapd_max_order[id];
+			new_classzone_idx = pgdat->classzone_idx[id];
+			pgdat->kswapd_max_order[id] =  0;
+			pgdat->classzone_idx[id] = pgdat->nr_zones - 1;
 		}
 
 		if (order < new_order || classzone_idx > new_classzone_idx) {
@@ -3150,12 +3231,12 @@ static int kswapd(void *p)
 		} else {
 			kswapd_try_to_sleep(pgdat, balanced_order,
 						balanced_classzone_idx);
-			order = pgdat->kswapd_max_order;
-			classzone_idx = pgdat->classzone_idx;
+			order = pgdat->kswapd_max_order[id];
+			classzone_idx = pgdat->classzone_idx[id];
 			new_order = order;
 			new_classzone_idx = classzone_idx;
-			pgdat->kswapd_max_order = 0;
-			pgdat->classzone_idx = pgdat->nr_zones - 1;
+			pgdat->kswapd_max_order[id] = 0;
+			pgdat->classzone_idx[id] = pgdat->nr_zones - 1;
 		}
 
 		ret = try_to_freeze();
@@ -3187,6 +3268,7 @@ static int kswapd(void *p)
 void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 {
 	pg_data_t *pgdat;
+	int i;
 
 	if (!populated_zone(zone))
 		return;
@@ -3194,9 +3276,13 @@ void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 	if (!cpuset_zone_allowed_hardwall(zone, GFP_KERNEL))
 		return;
 	pgdat = zone->zone_pgdat;
-	if (pgdat->kswapd_max_order < order) {
-		pgdat->kswapd_max_order = order;
-		pgdat->classzone_idx = min(pgdat->classzone_idx, classzone_idx);
+	/* Each thread takes the request from its own slot */
+	for (i = 0; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd_max_order[i] < order) {
+			pgdat->kswapd_max_order[i] = order;
+			pgdat->classzone_idx[i] = min(pgdat->classzone_idx[i],
+						      classzone_idx);
+		}
 	}
 	if (!waitqueue_active(&pgdat->kswapd_wait))
 		return;
@@ -3207,6 +3293,21 @@ void wakeup_kswapd(struct zone *zone, int order, enum zone_type classzone_idx)
 	wake_up_interruptible(&pgdat->kswapd_wait);
 }
 
+#ifdef CONFIG_RECLAIM_STATS
+void shrinker_latency_show(struct seq_file *m)
+{
+	struct shrinker *shrinker;
+	char name[KSYM_SYMBOL_LEN];
+
+	down_read(&shrinker_rwsem);
+	list_for_each_entry(shrinker, &shrinker_list, list) {
+		snprintf(name, sizeof(name), "%pf", shrinker->shrink);
+		reclaim_hist_show(m, name, &shrinker->latency);
+	}
+	up_read(&shrinker_rwsem);
+}
+#endif
+
 #ifdef CONFIG_HIBERNATION
 /*
  * Try to free `nr_to_reclaim' of memory, system-wide, and return the number of
@@ -3264,12 +3365,18 @@ static int cpu_callback(struct notifier_block *nfb, unsigned long action,
 		for_each_node_state(nid, N_MEMORY) {
 			pg_data_t *pgdat = NODE_DATA(nid);
 			const struct cpumask *mask;
+			int i;
 
-			mask = cpumask_of_node(pgdat->node_id);
+			mask = kswapd_cpumask(pgdat);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
-				/* One of our CPUs online: restore mask */
-				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+			if (cpumask_any_and(cpu_online_mask, mask) >= nr_cpu_ids)
+				continue;
+
+			/* One of our CPUs online: restore mask */
+			for (i = 0; i < MAX_KSWAPD_THREADS; i++)
+				if (pgdat->kswapd[i])
+					set_cpus_allowed_ptr(pgdat->kswapd[i],
+							     mask);
 		}
 	}
 	return NOTIFY_OK;
@@ -3278,22 +3385,40 @@ static int cpu_callback(struct notifier_block *nfb, unsigned long action,
 /*
  * This kswapd start function will be called by init and node-hot-add.
  * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
+ * Starts any of the node's kswapd_threads threads that are not running
+ * yet, and stops those beyond kswapd_threads.
  */
 int kswapd_run(int nid)
 {
 	pg_data_t *pgdat = NODE_DATA(nid);
-	int ret = 0;
+	struct task_struct *tsk;
+	int i, ret = 0;
 
-	if (pgdat->kswapd)
-		return 0;
+	for (i = MAX_KSWAPD_THREADS - 1; i >= kswapd_threads; i--) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
+		}
+	}
+
+	for (i = 0; i < kswapd_threads; i++) {
+		if (pgdat->kswapd[i])
+			continue;
 
-	pgdat->kswapd = kthread_run(kswapd, pgdat, "kswapd%d", nid);
-	if (IS_ERR(pgdat->kswapd)) {
-		/* failure at boot is fatal */
-		BUG_ON(system_state == SYSTEM_BOOTING);
-		pr_err("Failed to start kswapd on node %d\n", nid);
-		ret = PTR_ERR(pgdat->kswapd);
-		pgdat->kswapd = NULL;
+		if (i)
+			tsk = kthread_create(kswapd, pgdat, "kswapd%d:%d", nid, i);
+		else
+			tsk = kthread_create(kswapd, pgdat, "kswapd%d", nid);
+		if (IS_ERR(tsk)) {
+			/* failure at boot is fatal */
+			BUG_ON(system_state == SYSTEM_BOOTING);
+			pr_err("Failed to start kswapd %d on node %d\n", i, nid);
+			ret = PTR_ERR(tsk);
+			break;
+		}
+		/* kswapd() finds its request slot by looking itself up */
+		pgdat->kswapd[i] = tsk;
+		wake_up_process(tsk);
 	}
 	return ret;
 }
@@ -3304,14 +3429,33 @@ int kswapd_run(int nid)
  */
 void kswapd_stop(int nid)
 {
-	struct task_struct *kswapd = NODE_DATA(nid)->kswapd;
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int i;
 
-	if (kswapd) {
-		kthread_stop(kswapd);
-		NODE_DATA(nid)->kswapd = NULL;
+	for (i = 0; i < MAX_KSWAPD_THREADS; i++) {
+		if (pgdat->kswapd[i]) {
+			kthread_stop(pgdat->kswapd[i]);
+			pgdat->kswapd[i] = NULL;
+		}
 	}
 }
 
+int kswapd_threads_sysctl_handler(struct ctl_table *table, int write,
+				  void __user *buffer, size_t *length,
+				  loff_t *ppos)
+{
+	int nid, ret;
+
+	lock_memory_hotplug();
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!ret && write)
+		for_each_node_state(nid, N_MEMORY)
+			kswapd_run(nid);
+	unlock_memory_hotplug();
+
+	return ret;
+}
+
 static int __init kswapd_init(void)
 {
 	int nid;
@@ -616,6 +616,28 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * Like fragmentation_index() but also scored while a request of the
+ * target size would still succeed, so that kcompactd can tell how much of
+ * the free memory is in blocks too small for @order before the last
+ * suitable block is gone. Returns a value between 0 and 1000.
+ */
+int fragmentation_score(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+	unsigned long requested = 1UL << order;
+	int index;
+
+	fill_contig_page_info(zone, order, &info);
+	if (!info.free_blocks_total)
+		return 0;
+
+	index = 1000 - div_u64(1000 + div_u64(info.free_pages * 1000ULL,
+					      requested),
+			       info.free_blocks_total);
+	return max(index, 0);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_COMPACTION)
@@ -766,6 +788,14 @@ const char * const vmstat_text[] = {
 	TEXTS_FOR_ZONES("pgscan_kswapd")
 	TEXTS_FOR_ZONES("pgscan_direct")
 	"pgscan_direct_throttle",
+	"pgscan_kswapd_thread0",
+	"pgscan_kswapd_thread1",
+	"pgscan_kswapd_thread2",
+	"pgscan_kswapd_thread3",
+	"pgsteal_kswapd_thread0",
+	"pgsteal_kswapd_thread1",
+	"pgsteal_kswapd_thread2",
+	"pgsteal_kswapd_thread3",
 
 #ifdef CONFIG_NUMA
 	"zone_reclaim_failed",
@@ -798,6 +828,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_wake",
+	"compact_daemon_fail",
+	"compact_daemon_success",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
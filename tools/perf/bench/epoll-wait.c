@@ -0,0 +1,263 @@
+/*
+ *
+ * epoll-wait.c
+ *
+ * wait: Benchmark for epoll_wait() wakeups at scale
+ *
+ * Writer threads signal eventfds watched by a single epoll instance while
+ * waiter threads harvest them with epoll_wait(). Reports the wakeups per
+ * second, the delay from write() to epoll_wait() returning the event and
+ * the time spent in each epoll_wait() call.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+static int nfds = 1024;
+static int nwaiters = 1;
+static int nwriters = 1;
+static int runtime = 5;
+static int maxevents = 64;
+static bool edge;
+
+static const struct option options[] = {
+	OPT_INTEGER('f', "fds", &nfds,
+		    "Specify the number of watched eventfds"),
+	OPT_INTEGER('t', "waiters", &nwaiters,
+		    "Specify the number of epoll_wait() threads"),
+	OPT_INTEGER('w', "writers", &nwriters,
+		    "Specify the number of writer threads"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify the runtime in seconds"),
+	OPT_INTEGER('m', "maxevents", &maxevents,
+		    "Specify the maxevents of each epoll_wait() call"),
+	OPT_BOOLEAN('E', "edge", &edge,
+		    "Watch the eventfds with EPOLLET"),
+	OPT_END()
+};
+
+static const char * const bench_epoll_wait_usage[] = {
+	"perf bench epoll wait <options>",
+	NULL
+};
+
+struct fd_state {
+	int fd;
+	volatile int busy;		/* written, not yet harvested */
+	u64 stamp;			/* when it was written */
+} __attribute__((aligned(64)));
+
+struct waiter {
+	pthread_t thread;
+	u64 events;
+	u64 calls;
+	u64 lat_sum;
+	u64 lat_max;
+	u64 wait_sum;
+} __attribute__((aligned(64)));
+
+struct writer {
+	pthread_t thread;
+	int first, last;
+};
+
+static struct fd_state *fds;
+static int epfd;
+static volatile int done;
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void *waiter_fn(void *arg)
+{
+	struct waiter *w = arg;
+	struct epoll_event *ev;
+	u64 start, end, val;
+	int i, n;
+
+	ev = calloc(maxevents, sizeof(*ev));
+	BUG_ON(!ev);
+
+	while (!done) {
+		start = now_ns();
+		n = epoll_wait(epfd, ev, maxevents, 100);
+		end = now_ns();
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		w->calls++;
+		w->wait_sum += end - start;
+
+		for (i = 0; i < n; i++) {
+			struct fd_state *s = &fds[ev[i].data.u32];
+			u64 lat;
+
+			/* another waiter may have got it first */
+			if (read(s->fd, &val, sizeof(val)) != sizeof(val))
+				continue;
+			lat = end - s->stamp;
+			__sync_synchronize();
+			s->busy = 0;
+
+			w->events++;
+			w->lat_sum += lat;
+			if (lat > w->lat_max)
+				w->lat_max = lat;
+		}
+	}
+
+	free(ev);
+	return NULL;
+}
+
+static void *writer_fn(void *arg)
+{
+	struct writer *w = arg;
+	u64 one = 1;
+	int i = w->first;
+
+	while (!done) {
+		struct fd_state *s = &fds[i];
+
+		if (!s->busy && __sync_bool_compare_and_swap(&s->busy, 0, 1)) {
+			s->stamp = now_ns();
+			if (write(s->fd, &one, sizeof(one)) != sizeof(one))
+				break;
+		}
+		if (++i == w->last)
+			i = w->first;
+	}
+
+	return NULL;
+}
+
+int bench_epoll_wait(int argc, const char **argv,
+		     const char *prefix __maybe_unused)
+{
+	struct epoll_event ev;
+	struct waiter *waiters;
+	struct writer *writers;
+	u64 events = 0, calls = 0, lat_sum = 0, lat_max = 0, wait_sum = 0;
+	u64 start, elapsed;
+	int i;
+
+	argc = parse_options(argc, argv, options, bench_epoll_wait_usage, 0);
+
+	if (nfds <= 0 || nwaiters <= 0 || nwriters <= 0 || runtime <= 0 ||
+	    maxevents <= 0 || nwriters > nfds)
+		usage_with_options(bench_epoll_wait_usage, options);
+
+	fds = calloc(nfds, sizeof(*fds));
+	waiters = calloc(nwaiters, sizeof(*waiters));
+	writers = calloc(nwriters, sizeof(*writers));
+	BUG_ON(!fds || !waiters || !writers);
+
+	epfd = epoll_create(nfds);
+	BUG_ON(epfd < 0);
+
+	for (i = 0; i < nfds; i++) {
+		fds[i].fd = eventfd(0, EFD_NONBLOCK);
+		if (fds[i].fd < 0) {
+			fprintf(stderr, "eventfd: %s\n", strerror(errno));
+			exit(1);
+		}
+		ev.events = EPOLLIN | (edge ? EPOLLET : 0);
+		ev.data.u64 = i;
+		BUG_ON(epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i].fd, &ev));
+	}
+
+	for (i = 0; i < nwaiters; i++)
+		BUG_ON(pthread_create(&waiters[i].thread, NULL, waiter_fn,
+				      &waiters[i]));
+
+	start = now_ns();
+	/* each writer walks its own slice of the eventfds */
+	for (i = 0; i < nwriters; i++) {
+		writers[i].first = i * nfds / nwriters;
+		writers[i].last = (i + 1) * nfds / nwriters;
+		BUG_ON(pthread_create(&writers[i].thread, NULL, writer_fn,
+				      &writers[i]));
+	}
+
+	sleep(runtime);
+	done = 1;
+
+	for (i = 0; i < nwriters; i++)
+		pthread_join(writers[i].thread, NULL);
+	for (i = 0; i < nwaiters; i++) {
+		pthread_join(waiters[i].thread, NULL);
+		events += waiters[i].events;
+		calls += waiters[i].calls;
+		lat_sum += waiters[i].lat_sum;
+		wait_sum += waiters[i].wait_sum;
+		if (waiters[i].lat_max > lat_max)
+			lat_max = waiters[i].lat_max;
+	}
+	elapsed = now_ns() - start;
+
+	if (!events)
+		events = 1;
+	if (!calls)
+		calls = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d %s-triggered eventfds, %d waiter(s), %d writer(s)\n\n",
+		       nfds, edge ? "edge" : "level", nwaiters, nwriters);
+
+		printf(" %14s: %.3f [sec]\n\n", "Total time",
+		       (double)elapsed / 1e9);
+
+		printf(" %14.0lf wakeups/sec\n",
+		       (double)events * 1e9 / (double)elapsed);
+		printf(" %14.3lf usecs write to epoll_wait() return (avg)\n",
+		       (double)lat_sum / events / 1e3);
+		printf(" %14.3lf usecs write to epoll_wait() return (max)\n",
+		       (double)lat_max / 1e3);
+		printf(" %14.3lf usecs per epoll_wait() call\n",
+		       (double)wait_sum / calls / 1e3);
+		printf(" %14.2lf events per epoll_wait() call\n",
+		       (double)events / calls);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)events * 1e9 / (double)elapsed);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	for (i = 0; i < nfds; i++)
+		close(fds[i].fd);
+	close(epfd);
+	free(writers);
+	free(waiters);
+	free(fds);
+
+	return 0;
+}
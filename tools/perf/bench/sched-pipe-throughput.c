@@ -0,0 +1,224 @@
+/*
+ *
+ * sched-pipe-throughput.c
+ *
+ * pipe-throughput: Benchmark for bulk data through a pipe()
+ *
+ * One task pushes data into a pipe with write(), vmsplice() or
+ * vmsplice(SPLICE_F_GIFT) while another reads it out with read() or
+ * splices it to /dev/null.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+#ifndef F_SETPIPE_SZ
+#define F_SETPIPE_SZ	1031
+#define F_GETPIPE_SZ	1032
+#endif
+
+static int total_mb = 1024;
+static int block_kb = 64;
+static int pipe_kb;
+static const char *write_mode = "write";
+static const char *read_mode = "read";
+
+static const struct option options[] = {
+	OPT_INTEGER('s', "size", &total_mb,
+		    "Specify MiB to move through the pipe"),
+	OPT_INTEGER('b', "block", &block_kb,
+		    "Specify KiB per write() or vmsplice() call"),
+	OPT_INTEGER('p', "pipe-size", &pipe_kb,
+		    "Set the pipe size in KiB with F_SETPIPE_SZ (0: leave it)"),
+	OPT_STRING('w', "write", &write_mode, "mode",
+		   "Write with: write, vmsplice or gift"),
+	OPT_STRING('r', "read", &read_mode, "mode",
+		   "Read with: read or splice (to /dev/null)"),
+	OPT_END()
+};
+
+static const char * const bench_sched_pipe_throughput_usage[] = {
+	"perf bench sched pipe-throughput <options>",
+	NULL
+};
+
+static int reader(int fd, size_t block, unsigned long long total)
+{
+	unsigned long long done = 0;
+	int null_fd = -1;
+	char *buf = NULL;
+	ssize_t ret;
+
+	if (!strcmp(read_mode, "splice")) {
+		null_fd = open("/dev/null", O_WRONLY);
+		if (null_fd < 0)
+			return -1;
+	} else {
+		buf = malloc(block);
+		if (!buf)
+			return -1;
+	}
+
+	while (done < total) {
+		if (null_fd >= 0)
+			ret = splice(fd, NULL, null_fd, NULL, block,
+				     SPLICE_F_MOVE | SPLICE_F_MORE);
+		else
+			ret = read(fd, buf, block);
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+
+	free(buf);
+	return 0;
+}
+
+static int writer(int fd, char *buf, size_t block, unsigned long long total)
+{
+	unsigned int flags = 0;
+	unsigned long long done = 0;
+	int splice_it = 0;
+	ssize_t ret;
+
+	if (!strcmp(write_mode, "gift")) {
+		/* the buffer is never written again, so it may be gifted */
+		flags = SPLICE_F_GIFT;
+		splice_it = 1;
+	} else if (!strcmp(write_mode, "vmsplice")) {
+		splice_it = 1;
+	}
+
+	while (done < total) {
+		size_t off = done % block;
+		size_t len = block - off;
+
+		if (len > total - done)
+			len = total - done;
+		if (splice_it) {
+			struct iovec iov = {
+				.iov_base = buf + off,
+				.iov_len = len,
+			};
+
+			ret = vmsplice(fd, &iov, 1, flags);
+		} else {
+			ret = write(fd, buf + off, len);
+		}
+		if (ret <= 0)
+			return -1;
+		done += ret;
+	}
+
+	return 0;
+}
+
+int bench_sched_pipe_throughput(int argc, const char **argv,
+				const char *prefix __maybe_unused)
+{
+	struct timeval start, stop, diff;
+	unsigned long long total, usec;
+	int fds[2], wait_stat, pipe_size;
+	size_t block;
+	char *buf;
+	pid_t pid, retpid __maybe_unused;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_pipe_throughput_usage, 0);
+
+	if (total_mb <= 0 || block_kb <= 0 || pipe_kb < 0 ||
+	    (strcmp(write_mode, "write") && strcmp(write_mode, "vmsplice") &&
+	     strcmp(write_mode, "gift")) ||
+	    (strcmp(read_mode, "read") && strcmp(read_mode, "splice")))
+		usage_with_options(bench_sched_pipe_throughput_usage, options);
+
+	total = (unsigned long long)total_mb << 20;
+	block = (size_t)block_kb << 10;
+
+	/* page aligned, so that gifted pages can be whole pages */
+	buf = mmap(NULL, block, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	BUG_ON(buf == MAP_FAILED);
+	memset(buf, 'p', block);
+
+	BUG_ON(pipe(fds));
+	if (pipe_kb && fcntl(fds[1], F_SETPIPE_SZ, pipe_kb << 10) < 0) {
+		fprintf(stderr, "F_SETPIPE_SZ: %s\n", strerror(errno));
+		exit(1);
+	}
+
+	gettimeofday(&start, NULL);
+
+	pid = fork();
+	assert(pid >= 0);
+
+	if (!pid) {
+		close(fds[1]);
+		exit(reader(fds[0], block, total) ? 1 : 0);
+	}
+
+	close(fds[0]);
+	if (writer(fds[1], buf, block, total)) {
+		fprintf(stderr, "%s: %s\n", write_mode, strerror(errno));
+		kill(pid, SIGTERM);
+	}
+	pipe_size = fcntl(fds[1], F_GETPIPE_SZ);
+	close(fds[1]);
+
+	retpid = waitpid(pid, &wait_stat, 0);
+	assert((retpid == pid) && WIFEXITED(wait_stat));
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	if (!usec)
+		usec = 1;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Moved %d MiB through a pipe in %d KiB blocks"
+		       " (%s -> %s)\n", total_mb, block_kb, write_mode,
+		       read_mode);
+		printf("# Pipe size at the end: %d KiB\n\n", pipe_size >> 10);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf MB/sec\n", (double)total / (double)usec);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)total / (double)usec);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	munmap(buf, block);
+
+	return WEXITSTATUS(wait_stat);
+}
@@ -13,6 +13,7 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  epoll ... epoll wakeup scalability
  *
  */
 
@@ -54,6 +55,9 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "pipe-throughput",
+	  "Bulk data through pipe() with write() or vmsplice()",
+	  bench_sched_pipe_throughput },
 	suite_all,
 	{ NULL,
 	  NULL,
@@ -73,6 +77,16 @@ static struct bench_suite mem_suites[] = {
 	  NULL             }
 };
 
+static struct bench_suite epoll_suites[] = {
+	{ "wait",
+	  "Wakeups through epoll_wait() on many eventfds",
+	  bench_epoll_wait },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL             }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -91,6 +105,9 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "epoll",
+	  "epoll wakeup scalability",
+	  epoll_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "all benchmark subsystem",
 	  NULL },
@@ -0,0 +1,253 @@
+/*
+ * Sync framework tests, using a sw_sync timeline (CONFIG_SW_SYNC_USER)
+ *
+ * Checks that a timeline signals exactly the fences whose points it has
+ * passed, whatever order they were created in, and exercises the any-of
+ * and all-of modes of SYNC_IOC_WAIT_MULTI, both for fences that have
+ * already signaled and for a wait that is woken up by another thread.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "sync.h"
+#include "sw_sync.h"
+
+static int failures;
+
+#define check(cond, ...) do {					\
+	if (!(cond)) {						\
+		printf("FAIL %s:%d: ", __func__, __LINE__);	\
+		printf(__VA_ARGS__);				\
+		printf("\n");					\
+		failures++;					\
+	}							\
+} while (0)
+
+static int create_fence(int timeline, unsigned value)
+{
+	struct sw_sync_create_fence_data data;
+
+	memset(&data, 0, sizeof(data));
+	data.value = value;
+	snprintf(data.name, sizeof(data.name), "test-%u", value);
+	if (ioctl(timeline, SW_SYNC_IOC_CREATE_FENCE, &data))
+		return -errno;
+
+	return data.fence;
+}
+
+static void inc_timeline(int timeline, unsigned inc)
+{
+	if (ioctl(timeline, SW_SYNC_IOC_INC, &inc))
+		perror("SW_SYNC_IOC_INC");
+}
+
+static int fence_signaled(int fence)
+{
+	int timeout = 0;
+
+	return !ioctl(fence, SYNC_IOC_WAIT, &timeout);
+}
+
+static int wait_multi(int *fences, unsigned count, unsigned flags,
+		      int timeout, int *index)
+{
+	struct sync_wait_multi_data data;
+	int ret;
+
+	memset(&data, 0, sizeof(data));
+	data.fences = (uintptr_t)fences;
+	data.count = count;
+	data.flags = flags;
+	data.timeout = timeout;
+
+	ret = ioctl(fences[0], SYNC_IOC_WAIT_MULTI, &data) ? -errno : 0;
+	if (index)
+		*index = data.index;
+
+	return ret;
+}
+
+/* Points are signaled in value order, not in creation order */
+static void test_signal_order(void)
+{
+	static const unsigned values[] = { 3, 1, 4, 2 };
+	int timeline, fences[4], i;
+	unsigned step;
+
+	timeline = open("/dev/sw_sync", O_RDWR);
+	for (i = 0; i < 4; i++)
+		fences[i] = create_fence(timeline, values[i]);
+
+	for (step = 1; step <= 4; step++) {
+		inc_timeline(timeline, 1);
+		for (i = 0; i < 4; i++)
+			check(fence_signaled(fences[i]) == (values[i] <= step),
+			      "fence %u at step %d", values[i], step);
+	}
+
+	for (i = 0; i < 4; i++)
+		close(fences[i]);
+	close(timeline);
+}
+
+/* A merged fence signals with its last point */
+static void test_merge(void)
+{
+	struct sync_merge_data data;
+	int timeline, a, b;
+
+	timeline = open("/dev/sw_sync", O_RDWR);
+	a = create_fence(timeline, 1);
+	b = create_fence(timeline, 2);
+
+	memset(&data, 0, sizeof(data));
+	data.fd2 = b;
+	strcpy(data.name, "merged");
+	check(!ioctl(a, SYNC_IOC_MERGE, &data), "merge: %s", strerror(errno));
+
+	inc_timeline(timeline, 1);
+	check(!fence_signaled(data.fence), "merged fence signaled early");
+	inc_timeline(timeline, 1);
+	check(fence_signaled(data.fence), "merged fence not signaled");
+
+	close(data.fence);
+	close(b);
+	close(a);
+	close(timeline);
+}
+
+static void test_wait_multi(void)
+{
+	int timeline, fences[3], index, ret;
+
+	timeline = open("/dev/sw_sync", O_RDWR);
+	fences[0] = create_fence(timeline, 5);
+	fences[1] = create_fence(timeline, 2);
+	fences[2] = create_fence(timeline, 8);
+
+	ret = wait_multi(fences, 3, SYNC_WAIT_ANY, 0, &index);
+	check(ret == -ETIME, "any before signal: %d", ret);
+
+	inc_timeline(timeline, 2);
+	ret = wait_multi(fences, 3, SYNC_WAIT_ANY, 100, &index);
+	check(!ret && index == 1, "any: ret %d index %d", ret, index);
+
+	ret = wait_multi(fences, 3, 0, 10, &index);
+	check(ret == -ETIME, "all with pending fences: %d", ret);
+
+	inc_timeline(timeline, 6);
+	ret = wait_multi(fences, 3, 0, 100, &index);
+	check(!ret && index == -1, "all: ret %d index %d", ret, index);
+
+	ret = wait_multi(fences, 0, 0, 100, NULL);
+	check(ret == -EINVAL, "empty array: %d", ret);
+
+	close(fences[0]);
+	close(fences[1]);
+	close(fences[2]);
+	close(timeline);
+}
+
+struct signaler {
+	int timeline;
+	unsigned steps;
+};
+
+static void *signal_thread(void *arg)
+{
+	struct signaler *s = arg;
+	unsigned i;
+
+	for (i = 0; i < s->steps; i++) {
+		usleep(10000);
+		inc_timeline(s->timeline, 1);
+	}
+
+	return NULL;
+}
+
+/* The waits block and are woken up by the signaling thread */
+static void test_wait_multi_blocking(void)
+{
+	struct signaler s;
+	pthread_t thread;
+	int fences[2], index, ret;
+
+	s.timeline = open("/dev/sw_sync", O_RDWR);
+	s.steps = 4;
+	fences[0] = create_fence(s.timeline, 4);
+	fences[1] = create_fence(s.timeline, 2);
+
+	pthread_create(&thread, NULL, signal_thread, &s);
+
+	ret = wait_multi(fences, 2, SYNC_WAIT_ANY, 1000, &index);
+	check(!ret && index == 1, "blocking any: ret %d index %d", ret, index);
+	check(!fence_signaled(fences[0]), "fence 4 signaled with fence 2");
+
+	ret = wait_multi(fences, 2, 0, -1, &index);
+	check(!ret && index == -1, "blocking all: ret %d index %d", ret,
+	      index);
+
+	pthread_join(thread, NULL);
+
+	close(fences[0]);
+	close(fences[1]);
+	close(s.timeline);
+}
+
+/* Destroying the timeline errors out its fences */
+static void test_wait_multi_error(void)
+{
+	int timeline, fences[2], index, ret;
+
+	timeline = open("/dev/sw_sync", O_RDWR);
+	fences[0] = create_fence(timeline, 1);
+	fences[1] = create_fence(timeline, 2);
+
+	inc_timeline(timeline, 1);
+	close(timeline);
+
+	ret = wait_multi(fences, 2, 0, 100, &index);
+	check(ret < 0 && ret != -ETIME && index == 1,
+	      "error: ret %d index %d", ret, index);
+
+	close(fences[0]);
+	close(fences[1]);
+}
+
+int main(void)
+{
+	int fd;
+
+	fd = open("/dev/sw_sync", O_RDWR);
+	if (fd < 0) {
+		printf("sync_test: /dev/sw_sync not available, skipping\n");
+		return 0;
+	}
+	close(fd);
+
+	test_signal_order();
+	test_merge();
+	test_wait_multi();
+	test_wait_multi_blocking();
+	test_wait_multi_error();
+
+	if (failures) {
+		printf("sync_test: %d failures [FAIL]\n", failures);
+		return 1;
+	}
+	printf("sync_test: [PASS]\n");
+	return 0;
+}
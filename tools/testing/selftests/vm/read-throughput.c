@@ -0,0 +1,120 @@
+/*
+ * read-throughput:
+ *
+ * Measure buffered read() throughput from the page cache.  A file is
+ * written and read once to make it cached, then read sequentially with
+ * several buffer sizes, and the data is checked on the way.  Large reads
+ * are where the batched page cache lookups in do_generic_file_read()
+ * should show.
+ *
+ * Usage: read-throughput [file [size-in-MB]]
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define FILE_NAME "read-throughput.tmp"
+#define SIZE_MB 64
+#define PASSES 4
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned char pattern(size_t off)
+{
+	return (off >> 12) ^ off;
+}
+
+static int read_file(int fd, char *buf, size_t bufsize, size_t size,
+		     int check)
+{
+	size_t off = 0, i;
+	ssize_t ret;
+
+	if (lseek(fd, 0, SEEK_SET)) {
+		perror("lseek");
+		return -1;
+	}
+
+	while (off < size) {
+		ret = read(fd, buf, bufsize);
+		if (ret <= 0) {
+			perror("read");
+			return -1;
+		}
+		if (check) {
+			for (i = 0; i < ret; i++) {
+				if ((unsigned char)buf[i] != pattern(off + i)) {
+					fprintf(stderr, "bad data at %zu\n",
+						off + i);
+					return -1;
+				}
+			}
+		}
+		off += ret;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t bufsizes[] = { 4096, 65536, 1 << 20 };
+	const char *name = argc > 1 ? argv[1] : FILE_NAME;
+	size_t size = (argc > 2 ? atoi(argv[2]) : SIZE_MB) << 20;
+	size_t off, i;
+	char *buf;
+	double t;
+	int fd, pass, ret = 1;
+
+	buf = malloc(1 << 20);
+	if (!buf) {
+		perror("malloc");
+		return 1;
+	}
+
+	fd = open(name, O_CREAT | O_TRUNC | O_RDWR, 0600);
+	if (fd < 0) {
+		perror("open");
+		return 1;
+	}
+
+	for (off = 0; off < size; off += 1 << 20) {
+		for (i = 0; i < 1 << 20; i++)
+			buf[i] = pattern(off + i);
+		if (write(fd, buf, 1 << 20) != 1 << 20) {
+			perror("write");
+			goto out;
+		}
+	}
+
+	/* Warm the cache and check what comes back */
+	if (read_file(fd, buf, 1 << 20, size, 1))
+		goto out;
+
+	for (i = 0; i < sizeof(bufsizes) / sizeof(bufsizes[0]); i++) {
+		t = now();
+		for (pass = 0; pass < PASSES; pass++)
+			if (read_file(fd, buf, bufsizes[i], size, 0))
+				goto out;
+		t = now() - t;
+
+		printf("read %7zu byte buffers: %8.1f MB/s\n", bufsizes[i],
+		       (double)size * PASSES / (1 << 20) / t);
+	}
+	ret = 0;
+out:
+	close(fd);
+	unlink(name);
+	free(buf);
+	return ret;
+}
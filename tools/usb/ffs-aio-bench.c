@@ -0,0 +1,414 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o ffs-aio-bench ffs-aio-bench.c */
+
+/*
+ * FunctionFS bulk throughput benchmark using asynchronous I/O
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Both ends of the transfer run on the same machine: g_ffs is bound to
+ * dummy_hcd's gadget side and the host side talks to the resulting USB
+ * device through usbfs.
+ *
+ *	modprobe dummy_hcd
+ *	modprobe g_ffs
+ *	mount -t functionfs bench /dev/ffs
+ *	./ffs-aio-bench -g /dev/ffs -q 16 &
+ *	./ffs-aio-bench -D /dev/bus/usb/<bus>/<dev> -q 16
+ *
+ * The gadget side writes its descriptors to ep0 and then keeps -q iocbs
+ * of -l bytes submitted on ep1 (bulk in, like an adb pull) or, with -r,
+ * on ep2 (bulk out, like an adb push) through io_submit().  The host side
+ * keeps the same number of URBs queued on the other end.  Both report
+ * MB/s, which should grow with the queue depth until the UDC is saturated.
+ */
+
+#define _BSD_SOURCE /* for endian.h */
+
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+
+#include <linux/aio_abi.h>
+#include <linux/usb/ch9.h>
+#include <linux/usbdevice_fs.h>
+
+#include "../../include/uapi/linux/usb/functionfs.h"
+
+#define MAX_QUEUE	64
+
+static const char *ffs_dir;
+static const char *usb_dev;
+static size_t size_mb = 256;
+static unsigned queue = 16;
+static size_t req_len = 16384;
+static int receive;
+
+static const struct {
+	struct usb_functionfs_descs_head header;
+	struct {
+		struct usb_interface_descriptor intf;
+		struct usb_endpoint_descriptor_no_audio in;
+		struct usb_endpoint_descriptor_no_audio out;
+	} __attribute__((packed)) fs_descs, hs_descs;
+} __attribute__((packed)) descriptors = {
+	.header = {
+		.magic = htole32(FUNCTIONFS_DESCRIPTORS_MAGIC),
+		.length = htole32(sizeof(descriptors)),
+		.fs_count = htole32(3),
+		.hs_count = htole32(3),
+	},
+	.fs_descs = {
+		.intf = {
+			.bLength = sizeof(descriptors.fs_descs.intf),
+			.bDescriptorType = USB_DT_INTERFACE,
+			.bNumEndpoints = 2,
+			.bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+			.iInterface = 1,
+		},
+		.in = {
+			.bLength = sizeof(descriptors.fs_descs.in),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 1 | USB_DIR_IN,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+		},
+		.out = {
+			.bLength = sizeof(descriptors.fs_descs.out),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 2 | USB_DIR_OUT,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+		},
+	},
+	.hs_descs = {
+		.intf = {
+			.bLength = sizeof(descriptors.hs_descs.intf),
+			.bDescriptorType = USB_DT_INTERFACE,
+			.bNumEndpoints = 2,
+			.bInterfaceClass = USB_CLASS_VENDOR_SPEC,
+			.iInterface = 1,
+		},
+		.in = {
+			.bLength = sizeof(descriptors.hs_descs.in),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 1 | USB_DIR_IN,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = htole16(512),
+		},
+		.out = {
+			.bLength = sizeof(descriptors.hs_descs.out),
+			.bDescriptorType = USB_DT_ENDPOINT,
+			.bEndpointAddress = 2 | USB_DIR_OUT,
+			.bmAttributes = USB_ENDPOINT_XFER_BULK,
+			.wMaxPacketSize = htole16(512),
+		},
+	},
+};
+
+#define STR_INTERFACE "AIO bench"
+
+static const struct {
+	struct usb_functionfs_strings_head header;
+	struct {
+		__le16 code;
+		const char str1[sizeof(STR_INTERFACE)];
+	} __attribute__((packed)) lang0;
+} __attribute__((packed)) strings = {
+	.header = {
+		.magic = htole32(FUNCTIONFS_STRINGS_MAGIC),
+		.length = htole32(sizeof(strings)),
+		.str_count = htole32(1),
+		.lang_count = htole32(1),
+	},
+	.lang0 = {
+		htole16(0x0409), /* en-us */
+		STR_INTERFACE,
+	},
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *who, double bytes, double secs)
+{
+	printf("%-6s %s %.0f MiB, %u x %zu bytes in flight, %.3f s: %.1f MB/s\n",
+	       who, receive ? "receive" : "send", bytes / (1 << 20), queue,
+	       req_len, secs, bytes / secs / 1e6);
+}
+
+/* Find the bulk endpoints of the vendor specific benchmark interface */
+static int find_interface(int fd, int *intf, int *ep_in, int *ep_out)
+{
+	unsigned char buf[4096];
+	ssize_t len, off;
+	int in_bench = 0;
+
+	len = read(fd, buf, sizeof(buf));
+	if (len < 0)
+		return -errno;
+
+	*intf = *ep_in = *ep_out = -1;
+	for (off = 0; off + 2 <= len && buf[off]; off += buf[off]) {
+		struct usb_interface_descriptor *id = (void *)&buf[off];
+		struct usb_endpoint_descriptor *ed = (void *)&buf[off];
+
+		if (buf[off + 1] == USB_DT_INTERFACE) {
+			in_bench = id->bInterfaceClass == USB_CLASS_VENDOR_SPEC &&
+				   id->bNumEndpoints == 2;
+			if (in_bench)
+				*intf = id->bInterfaceNumber;
+		} else if (buf[off + 1] == USB_DT_ENDPOINT && in_bench &&
+			   (ed->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK) ==
+			   USB_ENDPOINT_XFER_BULK) {
+			if (ed->bEndpointAddress & USB_DIR_IN)
+				*ep_in = ed->bEndpointAddress;
+			else
+				*ep_out = ed->bEndpointAddress;
+		}
+	}
+
+	return *intf >= 0 && *ep_in >= 0 && *ep_out >= 0 ? 0 : -ENODEV;
+}
+
+/* Host side: keep the URBs queued on the matching bulk endpoint */
+static int host_side(void)
+{
+	static struct usbdevfs_urb urbs[MAX_QUEUE];
+	unsigned long long total, queued = 0, done = 0;
+	int fd, intf, ep_in, ep_out, ep, ret;
+	unsigned i;
+	double start;
+
+	fd = open(usb_dev, O_RDWR);
+	if (fd < 0) {
+		perror(usb_dev);
+		return 1;
+	}
+
+	ret = find_interface(fd, &intf, &ep_in, &ep_out);
+	if (ret) {
+		fprintf(stderr, "%s: no benchmark interface: %s\n", usb_dev,
+			strerror(-ret));
+		return 1;
+	}
+	if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf)) {
+		perror("USBDEVFS_CLAIMINTERFACE");
+		return 1;
+	}
+
+	ep = receive ? ep_out : ep_in;
+	total = (unsigned long long)size_mb << 20;
+
+	start = now();
+	for (i = 0; i < queue && queued < total; i++) {
+		urbs[i].type = USBDEVFS_URB_TYPE_BULK;
+		urbs[i].endpoint = ep;
+		urbs[i].buffer = calloc(1, req_len);
+		urbs[i].buffer_length = req_len;
+		if (!urbs[i].buffer ||
+		    ioctl(fd, USBDEVFS_SUBMITURB, &urbs[i])) {
+			perror("USBDEVFS_SUBMITURB");
+			return 1;
+		}
+		queued += req_len;
+	}
+
+	while (done < total) {
+		struct usbdevfs_urb *urb;
+
+		if (ioctl(fd, USBDEVFS_REAPURB, &urb)) {
+			perror("USBDEVFS_REAPURB");
+			return 1;
+		}
+		if (urb->status) {
+			fprintf(stderr, "urb failed: %s\n",
+				strerror(-urb->status));
+			return 1;
+		}
+
+		done += urb->actual_length;
+		if (queued < total) {
+			if (ioctl(fd, USBDEVFS_SUBMITURB, urb)) {
+				perror("USBDEVFS_SUBMITURB");
+				return 1;
+			}
+			queued += req_len;
+		}
+	}
+	report("host", done, now() - start);
+
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &intf);
+	close(fd);
+
+	return 0;
+}
+
+static int ffs_open(const char *name)
+{
+	char path[256];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", ffs_dir, name);
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		perror(path);
+
+	return fd;
+}
+
+/* Gadget side: one iocb per request, resubmitted as soon as it completes */
+static int gadget_side(void)
+{
+	static struct iocb iocbs[MAX_QUEUE];
+	struct iocb *list[MAX_QUEUE];
+	struct io_event events[MAX_QUEUE];
+	unsigned long long total, queued = 0, done = 0;
+	aio_context_t ctx = 0;
+	int ep0, ep, n, i;
+	double start = 0;
+
+	ep0 = ffs_open("ep0");
+	if (ep0 < 0)
+		return 1;
+	if (write(ep0, &descriptors, sizeof(descriptors)) < 0 ||
+	    write(ep0, &strings, sizeof(strings)) < 0) {
+		perror("ep0");
+		return 1;
+	}
+
+	ep = ffs_open(receive ? "ep2" : "ep1");
+	if (ep < 0)
+		return 1;
+
+	if (syscall(__NR_io_setup, queue, &ctx)) {
+		perror("io_setup");
+		return 1;
+	}
+
+	total = (unsigned long long)size_mb << 20;
+
+	/* the first submission waits for the host to enable the endpoint */
+	for (i = 0; i < (int)queue && queued < total; i++) {
+		iocbs[i].aio_fildes = ep;
+		iocbs[i].aio_lio_opcode = receive ? IOCB_CMD_PREAD :
+						    IOCB_CMD_PWRITE;
+		iocbs[i].aio_buf = (unsigned long)calloc(1, req_len);
+		iocbs[i].aio_nbytes = req_len;
+		if (!iocbs[i].aio_buf) {
+			perror("calloc");
+			return 1;
+		}
+		list[i] = &iocbs[i];
+		queued += req_len;
+	}
+	n = i;
+
+	for (i = 0; i < n; i++) {
+		if (syscall(__NR_io_submit, ctx, 1, &list[i]) != 1) {
+			perror("io_submit");
+			return 1;
+		}
+		if (!i)
+			start = now();
+	}
+
+	while (done < total) {
+		n = syscall(__NR_io_getevents, ctx, 1, MAX_QUEUE, events, NULL);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("io_getevents");
+			return 1;
+		}
+
+		for (i = 0; i < n; i++) {
+			struct iocb *iocb = (struct iocb *)(unsigned long)
+					    events[i].obj;
+
+			if ((long long)events[i].res < 0) {
+				fprintf(stderr, "transfer failed: %s\n",
+					strerror(-(long long)events[i].res));
+				return 1;
+			}
+			done += events[i].res;
+			if (queued < total) {
+				if (syscall(__NR_io_submit, ctx, 1, &iocb) != 1) {
+					perror("io_submit");
+					return 1;
+				}
+				queued += req_len;
+			}
+		}
+	}
+	report("gadget", done, now() - start);
+
+	syscall(__NR_io_destroy, ctx);
+	close(ep);
+	close(ep0);
+
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -g /dev/ffs | -D /dev/bus/usb/BBB/DDD\n"
+		"       [-r] [-s MiB] [-q queue depth] [-l request bytes]\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "g:D:rs:q:l:")) != -1) {
+		switch (c) {
+		case 'g':
+			ffs_dir = optarg;
+			break;
+		case 'D':
+			usb_dev = optarg;
+			break;
+		case 'r':
+			receive = 1;
+			break;
+		case 's':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			queue = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			req_len = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!ffs_dir == !usb_dev || !size_mb || !queue || queue > MAX_QUEUE ||
+	    req_len < 512 || req_len > (1 << 20) || req_len % 512)
+		usage(argv[0]);
+
+	return ffs_dir ? gadget_side() : host_side();
+}
@@ -0,0 +1,298 @@
+/* $(CROSS_COMPILE)cc -Wall -Wextra -g -o mtp-bench mtp-bench.c */
+
+/*
+ * MTP gadget bulk throughput benchmark
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ */
+
+/*
+ * Both ends of the transfer run on the same machine: the MTP function
+ * is bound to dummy_hcd's gadget side (g_android with "mtp" enabled)
+ * and the host side talks to the resulting USB device through usbfs.
+ *
+ *	modprobe dummy_hcd
+ *	echo mtp > /sys/class/android_usb/android0/functions
+ *	echo 1 > /sys/class/android_usb/android0/enable
+ *	./mtp-bench -D /dev/bus/usb/<bus>/<dev> -f /data/bench -s 256
+ *
+ * The gadget side issues MTP_SEND_FILE (or MTP_RECEIVE_FILE with -r) on
+ * /dev/mtp_usb while a child process keeps -q URBs of -u bytes queued on
+ * the matching bulk endpoint, and both report MB/s.  The queue depth and
+ * request size of the gadget are the mtp_tx_reqs, mtp_tx_req_len,
+ * mtp_rx_reqs and mtp_rx_req_len parameters; mtp_zero_copy selects the
+ * page cache path for sends on UDCs that support sg.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+#include <linux/usb/ch9.h>
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/f_mtp.h>
+
+#define MAX_URBS	64
+
+static const char *mtp_dev = "/dev/mtp_usb";
+static const char *usb_dev;
+static const char *file = "mtp-bench.dat";
+static size_t size_mb = 64;
+static unsigned iterations = 4;
+static unsigned nr_urbs = 16;
+static size_t urb_len = 16384;
+static int receive;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *who, double bytes, double secs)
+{
+	printf("%-6s %s %.0f MiB in %.3f s: %.1f MB/s\n", who,
+	       receive ? "receive" : "send", bytes / (1 << 20), secs,
+	       bytes / secs / 1e6);
+}
+
+/* Find the bulk endpoints of the vendor specific MTP interface */
+static int find_mtp_interface(int fd, int *intf, int *ep_in, int *ep_out)
+{
+	unsigned char buf[4096];
+	ssize_t len, off;
+	int in_mtp = 0;
+
+	len = read(fd, buf, sizeof(buf));
+	if (len < 0)
+		return -errno;
+
+	*intf = *ep_in = *ep_out = -1;
+	for (off = 0; off + 2 <= len && buf[off]; off += buf[off]) {
+		struct usb_interface_descriptor *id = (void *)&buf[off];
+		struct usb_endpoint_descriptor *ed = (void *)&buf[off];
+
+		if (buf[off + 1] == USB_DT_INTERFACE) {
+			in_mtp = id->bInterfaceClass == USB_CLASS_VENDOR_SPEC &&
+				 id->bInterfaceSubClass == 0xff &&
+				 id->bInterfaceProtocol == 0 &&
+				 id->bNumEndpoints == 3;
+			if (in_mtp)
+				*intf = id->bInterfaceNumber;
+		} else if (buf[off + 1] == USB_DT_ENDPOINT && in_mtp &&
+			   (ed->bmAttributes & USB_ENDPOINT_XFERTYPE_MASK) ==
+			   USB_ENDPOINT_XFER_BULK) {
+			if (ed->bEndpointAddress & USB_DIR_IN)
+				*ep_in = ed->bEndpointAddress;
+			else
+				*ep_out = ed->bEndpointAddress;
+		}
+	}
+
+	return *intf >= 0 && *ep_in >= 0 && *ep_out >= 0 ? 0 : -ENODEV;
+}
+
+/* Host side: stream the transfers through usbfs */
+static int host_side(void)
+{
+	static struct usbdevfs_urb urbs[MAX_URBS];
+	unsigned long long total, queued = 0, done = 0;
+	int fd, intf, ep_in, ep_out, ep, i, ret;
+	double start;
+
+	fd = open(usb_dev, O_RDWR);
+	if (fd < 0) {
+		perror(usb_dev);
+		return 1;
+	}
+
+	ret = find_mtp_interface(fd, &intf, &ep_in, &ep_out);
+	if (ret) {
+		fprintf(stderr, "%s: no MTP interface: %s\n", usb_dev,
+			strerror(-ret));
+		return 1;
+	}
+	if (ioctl(fd, USBDEVFS_CLAIMINTERFACE, &intf)) {
+		perror("USBDEVFS_CLAIMINTERFACE");
+		return 1;
+	}
+
+	ep = receive ? ep_out : ep_in;
+	total = (unsigned long long)size_mb * iterations << 20;
+
+	start = now();
+	for (i = 0; i < (int)nr_urbs && queued < total; i++) {
+		urbs[i].type = USBDEVFS_URB_TYPE_BULK;
+		urbs[i].endpoint = ep;
+		urbs[i].buffer = malloc(urb_len);
+		urbs[i].buffer_length = urb_len;
+		if (!urbs[i].buffer ||
+		    ioctl(fd, USBDEVFS_SUBMITURB, &urbs[i])) {
+			perror("USBDEVFS_SUBMITURB");
+			return 1;
+		}
+		queued += urb_len;
+	}
+
+	while (done < total) {
+		struct usbdevfs_urb *urb;
+
+		if (ioctl(fd, USBDEVFS_REAPURB, &urb)) {
+			perror("USBDEVFS_REAPURB");
+			return 1;
+		}
+		if (urb->status) {
+			fprintf(stderr, "urb failed: %s\n",
+				strerror(-urb->status));
+			return 1;
+		}
+
+		/* zero length packets end each send that fills its packets */
+		done += urb->actual_length;
+		if (queued < total) {
+			if (ioctl(fd, USBDEVFS_SUBMITURB, urb)) {
+				perror("USBDEVFS_SUBMITURB");
+				return 1;
+			}
+			queued += urb_len;
+		}
+	}
+	report("host", done, now() - start);
+
+	for (i = 0; i < (int)nr_urbs; i++)
+		ioctl(fd, USBDEVFS_DISCARDURB, &urbs[i]);
+	ioctl(fd, USBDEVFS_RELEASEINTERFACE, &intf);
+	close(fd);
+
+	return 0;
+}
+
+/* Gadget side: one MTP_SEND_FILE or MTP_RECEIVE_FILE per iteration */
+static int gadget_side(void)
+{
+	struct mtp_file_range mfr;
+	int mtp, fd, ret = 0;
+	unsigned i;
+	double start;
+
+	fd = open(file, receive ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR | O_CREAT,
+		  0644);
+	if (fd < 0) {
+		perror(file);
+		return 1;
+	}
+	if (!receive && ftruncate(fd, size_mb << 20)) {
+		perror("ftruncate");
+		return 1;
+	}
+
+	mtp = open(mtp_dev, O_RDWR);
+	if (mtp < 0) {
+		perror(mtp_dev);
+		return 1;
+	}
+
+	memset(&mfr, 0, sizeof(mfr));
+	mfr.fd = fd;
+	mfr.length = size_mb << 20;
+
+	start = now();
+	for (i = 0; i < iterations; i++) {
+		if (ioctl(mtp, receive ? MTP_RECEIVE_FILE : MTP_SEND_FILE,
+			  &mfr)) {
+			perror(receive ? "MTP_RECEIVE_FILE" : "MTP_SEND_FILE");
+			ret = 1;
+			break;
+		}
+	}
+	if (!ret)
+		report("gadget", (double)iterations * (size_mb << 20),
+		       now() - start);
+
+	close(mtp);
+	close(fd);
+
+	return ret;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -D /dev/bus/usb/BBB/DDD [-r] [-f file] [-s MiB]\n"
+		"       [-n iterations] [-q urbs] [-u urb bytes]\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	int c, status, ret;
+	pid_t pid;
+
+	while ((c = getopt(argc, argv, "D:rf:s:n:q:u:")) != -1) {
+		switch (c) {
+		case 'D':
+			usb_dev = optarg;
+			break;
+		case 'r':
+			receive = 1;
+			break;
+		case 'f':
+			file = optarg;
+			break;
+		case 's':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			iterations = strtoul(optarg, NULL, 0);
+			break;
+		case 'q':
+			nr_urbs = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			urb_len = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (!usb_dev || !size_mb || !iterations || !nr_urbs ||
+	    nr_urbs > MAX_URBS || urb_len < 1024 || urb_len > (1 << 20) ||
+	    (urb_len & (urb_len - 1)))
+		usage(argv[0]);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!pid)
+		return host_side();
+
+	ret = gadget_side();
+	if (ret)
+		kill(pid, SIGTERM);
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		ret = 1;
+
+	return ret;
+}